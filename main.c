@@ -1,16 +1,49 @@
+#ifdef __linux__
+#define _GNU_SOURCE            // pthread_setaffinity_np y CPU_SET (red de clínicas)
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdarg.h>
 #include <pthread.h>
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <strings.h>
 #include <signal.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <math.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
 
 // Configuración del sistema
-#define MAX_PACIENTES 1000
-#define MAX_MEDICOS 10
-#define MAX_ADMIN 4
-#define MAX_ESPECIALISTAS 4
+// Dotación máxima de --personal: cada clínica reserva su personal según la
+// dotación pedida, así que los topes solo acotan el campo de 16 bits de la
+// traza y los mapas de ocupados del bloque de métricas (2,5 KB)
+#define MAX_MEDICOS 16384
+#define MAX_ADMIN 4096
+#define TAM_BLOQUE_ARENA 4096      // Pacientes por bloque de la arena
+#define MAX_BLOQUES_ARENA 4096     // Hasta ~16M pacientes vivos simultáneos
+#define TAM_SEGMENTO_COLA 256      // Handles por segmento de cola
+#define TAM_ANILLO_RECEPCION 65536 // Celdas del anillo de recepción por omisión (--anillo)
+#define MAX_SHARDS_ESTADISTICAS 64 // Hilos con contadores propios (el resto comparte uno)
+#define TAM_LINEA_CACHE 64
+#define NUM_CUBETAS_ESPERA 480     // Histograma de espera: cubetas de 1 minuto (la última acumula el resto)
+#define BITS_SUBCUBETA 4           // Histogramas de latencia: 16 subcubetas por potencia de 2 (~6% de error)
+#define NUM_CUBETAS_LATENCIA 208   // 32 cubetas de 1 s + 11 potencias de 2 x 16: hasta 65535 s
+#define NUM_CUBETAS_NANOSEGUNDOS 512 // Banco de pruebas: 32 + 30 potencias de 2 x 16: hasta ~34 s en ns
+#define BITS_RUEDA 6               // Rueda de temporizadores: 64 ranuras de 1 segundo por nivel
+#define NIVELES_RUEDA 4            // Alcance: 64^4 segundos
+#define NUM_COLAS_CLINICA 7        // Recepción, general, enfermería y 4 especialidades
+#define TAM_LOTE_COLA 32           // Pacientes por lote en las operaciones por lotes de las colas
 
 // Factor de velocidad de simulación (1=normal, 2=2x, 4=4x, 10=10x)
 int SPEED_FACTOR = 1;
@@ -29,30 +62,49 @@ typedef enum {
     DERMATOLOGIA
 } Especialidad;
 
-// Estructura del paciente
+// Etapa del recorrido del paciente por la clínica
+typedef enum {
+    PACIENTE_LIBRE,            // Slot de la arena sin usar
+    PACIENTE_EN_RECEPCION,
+    PACIENTE_EN_CLASIFICACION,
+    PACIENTE_EN_ESPERA,        // Clasificado, esperando médico
+    PACIENTE_EN_ATENCION,
+    PACIENTE_ATENDIDO,
+    PACIENTE_ABANDONO
+} EstadoPaciente;
+
+// Estructura del paciente (56 bytes). La etapa vive en una columna aparte de
+// la arena y los datos de la espera en curso se copian a las columnas del
+// segmento de cola que lo guarda, donde los censos los recorren sin traer
+// los registros
 typedef struct {
-    int id;
-    TipoAtencion tipo_atencion;
-    Especialidad especialidad;
     time_t tiempo_llegada;
     time_t tiempo_clasificacion;
     time_t tiempo_atencion;
-    int prioridad; // 1-5, siendo 1 la más alta
-    int atendido;
-    int abandono;
-    int clasificado;
+    struct Cola* cola_espera;  // Cola de atención en la que está (NULL fuera de ellas)
+    int32_t* ranura_espera;    // Su entrada en SegmentoCola.espera_desde mientras espera en ella
+    int id;
+    int32_t plazo_abandono;    // Segundo en que abandona la espera (PLAZO_NINGUNO si no)
+    uint8_t tipo_atencion;     // TipoAtencion
+    uint8_t especialidad;      // Especialidad
+    uint8_t prioridad;         // 1-5, siendo 1 la más alta
+    uint8_t atendido;
+    uint8_t abandono;
+    uint8_t clasificado;
 } Paciente;
 
-// Estructura del médico
+// Estructura del médico (una línea de caché por médico: cada hilo escribe
+// sus propios contadores sin invalidar los de sus vecinos)
 typedef struct {
     int id;
     TipoAtencion tipo;
     Especialidad especialidad;
     int ocupado;
     int pacientes_atendidos;
+    int pacientes_ajenos;      // Tomados de otra cola compatible (robo de trabajo)
     pthread_t thread;
     int activo;
-} Medico;
+} __attribute__((aligned(TAM_LINEA_CACHE))) Medico;
 
 // Estructura del personal administrativo
 typedef struct {
@@ -61,55 +113,596 @@ typedef struct {
     int pacientes_clasificados;
     pthread_t thread;
     int activo;
-} PersonalAdmin;
+} __attribute__((aligned(TAM_LINEA_CACHE))) PersonalAdmin;
+
+// Tramos del recorrido del paciente con histograma de latencia propio
+typedef enum {
+    TRAMO_RECEPCION,           // Llegada -> inicio de la clasificación
+    TRAMO_ESPERA_MEDICO,       // Fin de la clasificación -> inicio de la consulta
+    TRAMO_CONSULTA,            // Duración de la consulta
+    NUM_TRAMOS
+} TramoLatencia;
+
+// Histograma log-lineal al estilo HDR: los valores menores que 2^(BITS_SUBCUBETA+1)
+// tienen cubeta propia y cada potencia de 2 siguiente se parte en 2^BITS_SUBCUBETA
+// cubetas iguales. Se combinan sumando cubeta a cubeta.
+typedef struct {
+    long cubetas[NUM_CUBETAS_LATENCIA];
+} HistogramaLatencia;
+
+// El mismo esquema con rango de nanosegundos para el banco de pruebas: las
+// operaciones duran decenas de ns, pero una expropiación del hilo a mitad
+// de una operación puede durar milisegundos
+typedef struct {
+    long cubetas[NUM_CUBETAS_NANOSEGUNDOS];
+} HistogramaNanosegundos;
+
+// Medición de los mutex más disputados (colas, print_mutex y el shard
+// compartido de estadísticas): adquisiciones, cuántas encontraron el mutex
+// tomado, histogramas en nanosegundos de la espera y de la retención, y
+// despertares de sus variables de condición. Todo se anota con el mutex
+// tomado, así que no hace falta ninguna operación atómica. Las esperas se
+// cronometran siempre (ya se está perdiendo tiempo); la retención, en una de
+// cada MUESTREO_RETENCION_MUTEX adquisiciones, como las latencias del banco
+// de pruebas. Los tiempos son de reloj real y varían entre corridas con la
+// misma semilla: van a reporte_mutex.txt, no al reporte diario. Con
+// -DINSTRUMENTAR_MUTEX=0 los envoltorios son las llamadas de pthread y los
+// campos de medición desaparecen de las estructuras.
+#ifndef INSTRUMENTAR_MUTEX
+#define INSTRUMENTAR_MUTEX 1
+#endif
+
+#if INSTRUMENTAR_MUTEX
+#define MUESTREO_RETENCION_MUTEX 16
+
+typedef struct {
+    long adquisiciones;
+    long contendidas;          // El mutex estaba tomado: hubo que esperar
+    long espera_total;         // Nanosegundos, solo de las contendidas
+    long espera_maxima;
+    long retencion_total;      // Nanosegundos de los tramos cronometrados
+    long retencion_maxima;
+    long despertares;          // Retornos de pthread_cond_wait
+    long espurios;             // ...tras los que no había nada (espurios o robados)
+    long tomado_en;            // Inicio del tramo cronometrado en curso (0 = sin cronometrar)
+    HistogramaNanosegundos espera;
+    HistogramaNanosegundos retencion;
+} MedicionMutex;
+
+static inline void anotar_nanosegundos(HistogramaNanosegundos* histograma, long nanosegundos);
+static long nanosegundos_monotonos(void);
+
+static inline void tomar_mutex_medido(pthread_mutex_t* mutex, MedicionMutex* m) {
+    if (__builtin_expect(pthread_mutex_trylock(mutex) != 0, 0)) {
+        long inicio = nanosegundos_monotonos();
+        pthread_mutex_lock(mutex);
+        long espera = nanosegundos_monotonos() - inicio;
+        m->contendidas++;
+        m->espera_total += espera;
+        if (espera > m->espera_maxima) m->espera_maxima = espera;
+        anotar_nanosegundos(&m->espera, espera);
+    }
+    if (m->adquisiciones++ % MUESTREO_RETENCION_MUTEX == 0) m->tomado_en = nanosegundos_monotonos();
+}
+
+// Cerrar el tramo de retención cronometrado que empezó al tomar el mutex (o al despertar)
+static inline void anotar_retencion(MedicionMutex* m) {
+    long retencion = nanosegundos_monotonos() - m->tomado_en;
+    m->retencion_total += retencion;
+    if (retencion > m->retencion_maxima) m->retencion_maxima = retencion;
+    anotar_nanosegundos(&m->retencion, retencion);
+}
+
+static inline void soltar_mutex_medido(pthread_mutex_t* mutex, MedicionMutex* m) {
+    if (m->tomado_en) {
+        anotar_retencion(m);
+        m->tomado_en = 0;
+    }
+    pthread_mutex_unlock(mutex);
+}
+
+// Mientras se espera el mutex está libre: la retención se corta en dos
+// tramos. El primero se cierra antes de esperar; si no, quien tome el mutex
+// mientras tanto cerraría al soltarlo un tramo que empezó antes que el suyo
+static inline void esperar_condicion_medida(pthread_cond_t* cond, pthread_mutex_t* mutex, MedicionMutex* m) {
+    int cronometrado = (m->tomado_en != 0);
+    if (cronometrado) {
+        anotar_retencion(m);
+        m->tomado_en = 0;
+    }
+    pthread_cond_wait(cond, mutex);
+    m->despertares++;
+    m->tomado_en = cronometrado ? nanosegundos_monotonos() : 0;
+}
+
+#define tomar_mutex(mutex, medicion) tomar_mutex_medido((mutex), (medicion))
+#define soltar_mutex(mutex, medicion) soltar_mutex_medido((mutex), (medicion))
+
+// Esperar en 'cond' mientras 'condicion' siga cierta; cada vuelta extra
+// del bucle es un despertar que no encontró lo que esperaba
+#define ESPERAR_MIENTRAS(condicion, cond, mutex, medicion) do { \
+    int despertado_ = 0; \
+    while (condicion) { \
+        if (despertado_) (medicion)->espurios++; \
+        esperar_condicion_medida((cond), (mutex), (medicion)); \
+        despertado_ = 1; \
+    } \
+} while (0)
+#else
+#define tomar_mutex(mutex, medicion) pthread_mutex_lock(mutex)
+#define soltar_mutex(mutex, medicion) pthread_mutex_unlock(mutex)
+#define ESPERAR_MIENTRAS(condicion, cond, mutex, medicion) do { \
+    while (condicion) pthread_cond_wait((cond), (mutex)); \
+} while (0)
+#endif
+
+// Estadísticas de pacientes repartidas en shards por hilo: cada hilo suma en
+// su propia línea de caché y los reportes agregan bajo demanda. Cada shard
+// tiene un único escritor y un seqlock para que los lectores obtengan una
+// copia consistente sin bloquearlo.
+// Todos los campos son long: se leen y agregan como un arreglo
+typedef struct {
+    long generados;
+    long clasificados;
+    long atendidos;
+    long abandonaron;
+    long inicios_clasificacion;
+    long espera_recepcion;     // Segundos acumulados entre llegada y clasificación
+    long inicios_atencion;
+    long espera_atencion;      // Segundos acumulados entre clasificación y consulta
+} ContadoresPacientes;
+
+#define NUM_CONTADORES (sizeof(ContadoresPacientes) / sizeof(long))
+
+// Histogramas de cada shard (~64 KB): quedan fuera del seqlock para que los
+// monitores y las métricas copien solo los contadores. Cada cubeta se
+// escribe y se lee con operaciones atómicas relajadas; se combinan para el
+// reporte final y los resúmenes de cada jornada, sin necesitar una copia
+// consistente entre cubetas.
+typedef struct {
+    long espera_total[NUM_CUBETAS_ESPERA]; // Minutos desde la llegada hasta salir de la cola de espera
+    // Segundos de cada tramo, desglosados por tipo de atención, especialidad y prioridad
+    HistogramaLatencia latencia_tipo[NUM_TRAMOS][3];
+    HistogramaLatencia latencia_especialidad[NUM_TRAMOS][4];
+    HistogramaLatencia latencia_prioridad[NUM_TRAMOS][5];
+} HistogramasPacientes;
+
+#define NUM_CUBETAS_HISTOGRAMAS (sizeof(HistogramasPacientes) / sizeof(long))
+
+typedef struct {
+    uint32_t secuencia;        // Impar mientras el dueño está actualizando
+    ContadoresPacientes contadores;
+    HistogramasPacientes histogramas __attribute__((aligned(TAM_LINEA_CACHE)));
+} __attribute__((aligned(TAM_LINEA_CACHE))) ShardEstadisticas;
+
+typedef struct {
+    ShardEstadisticas shards[MAX_SHARDS_ESTADISTICAS];
+    int num_shards;
+    ShardEstadisticas compartido;  // Para hilos sin shard propio (bajo mutex_compartido)
+    pthread_mutex_t mutex_compartido;
+#if INSTRUMENTAR_MUTEX
+    MedicionMutex medicion_compartido;
+#endif
+} Estadisticas;
+
+// Arena de pacientes: los pacientes viven en bloques reservados una sola vez
+// (la arena crece de a un bloque cuando se llena, sin mover los existentes) y
+// las colas solo transportan handles de 32 bits hacia sus slots. Los slots
+// liberados se reciclan a través de una lista libre.
+typedef uint32_t HandlePaciente;
+#define HANDLE_NULO UINT32_MAX
+
+#define PLAZO_NINGUNO INT32_MAX    // Espera sin límite de paciencia
+
+typedef struct {
+    Paciente* bloques[MAX_BLOQUES_ARENA];
+    uint8_t* estados[MAX_BLOQUES_ARENA];   // EstadoPaciente por slot: las lápidas se reconocen sin traer el registro
+    uint32_t* enlaces[MAX_BLOQUES_ARENA];  // Siguiente slot libre, por slot
+    uint32_t num_bloques;
+    uint32_t libre;             // Primer slot libre (HANDLE_NULO si no hay)
+    uint32_t en_uso;
+    pthread_mutex_t mutex;
+} ArenaPacientes;
 
 // Colas del sistema
+// Cada cola mantiene una sub-cola FIFO por nivel de prioridad (1-5): insertar y
+// extraer cuesta O(1) y se conserva el orden de llegada dentro de cada nivel.
+// Cada nivel es una lista de segmentos tomados de un pool compartido, por lo que
+// las colas crecen sin límite salvo que se configure una capacidad máxima.
+#define NUM_PRIORIDADES 5
+
+// Junto a los handles, en columnas paralelas, los datos de la espera de cada
+// paciente: los censos recorren los segmentos de un nivel con bucles sin
+// saltos que el compilador vectoriza, sin tocar la arena
+#define ESPERA_LAPIDA INT32_MAX    // En espera_desde: el paciente abandonó
+
+typedef struct SegmentoCola {
+    HandlePaciente handles[TAM_SEGMENTO_COLA];
+    int32_t espera_desde[TAM_SEGMENTO_COLA];  // Llegada (recepción) o fin de la clasificación
+    int32_t plazo[TAM_SEGMENTO_COLA];         // Copia de Paciente.plazo_abandono
+    struct SegmentoCola* siguiente;
+} SegmentoCola;
+
+// Pool de segmentos reutilizables compartido por todas las colas
+typedef struct {
+    SegmentoCola* libres;
+    int segmentos_creados;
+    pthread_mutex_t mutex;
+} PoolSegmentos;
+
 typedef struct {
-    Paciente pacientes[MAX_PACIENTES];
-    int frente;
-    int final;
+    SegmentoCola* primero;     // Segmento del que se extrae
+    SegmentoCola* ultimo;      // Segmento en el que se inserta
+    int frente;                // Posición de extracción dentro de 'primero'
+    int final;                 // Posición de inserción dentro de 'ultimo'
     int count;
+} NivelPrioridad;
+
+// Qué hacer cuando una cola con capacidad máxima está llena
+typedef enum {
+    POLITICA_BLOQUEAR,         // El productor espera a que haya espacio
+    POLITICA_RECHAZAR,         // El paciente se rechaza y se contabiliza
+    POLITICA_DESVIAR           // El paciente se envía a la cola de desvío
+} PoliticaDesborde;
+
+// Resultado de insertar en una cola
+typedef enum {
+    ENCOLADO,
+    DESVIADO,
+    RECHAZADO,
+    COLA_LLENA                 // Llena con política bloquear en modo eventos discretos
+} ResultadoEncolado;
+
+// Contador de eventos: los consumidores duermen sobre un futex (o una
+// variable de condición fuera de Linux) solo cuando no hay nada que hacer,
+// y los productores únicamente hacen la llamada al sistema si hay alguien esperando
+typedef struct {
+    uint32_t epoca;
+    uint32_t esperando;
+#ifndef __linux__
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+#endif
+} ContadorEventos;
+
+// Anillo acotado multi-productor/multi-consumidor sin bloqueo: cada celda
+// lleva un número de secuencia que indica si está libre o publicada
+typedef struct {
+    uint64_t secuencia;
+    HandlePaciente handle;
+} CeldaAnillo;
+
+typedef struct {
+    CeldaAnillo* celdas;
+    uint64_t mascara;
+    char relleno0[64 - sizeof(CeldaAnillo*) - sizeof(uint64_t)];
+    uint64_t pos_insercion;    // Línea de caché propia: la comparten solo productores
+    char relleno1[64 - sizeof(uint64_t)];
+    uint64_t pos_extraccion;   // Ídem para consumidores
+    char relleno2[64 - sizeof(uint64_t)];
+} AnilloMPMC;
+
+typedef struct Cola {
+    NivelPrioridad niveles[NUM_PRIORIDADES];
+    PoolSegmentos* pool;       // De donde salen los segmentos de los niveles
+    int count;                 // Total de pacientes en todos los niveles
+    int max_count;             // Máximo observado durante la jornada
+    
+    // Modo acotado (capacidad 0 = sin límite)
+    int capacidad;
+    PoliticaDesborde politica;
+    struct Cola* desvio;       // Destino con POLITICA_DESVIAR (NULL = rechazar)
+    int esperando_espacio;     // Productores bloqueados esperando espacio
+    long rechazados;
+    long bloqueos;
+    long desviados;
+    long insertados;           // Total histórico, para pronosticar la demanda
+    
     pthread_mutex_t mutex;
     pthread_cond_t cond;
+    pthread_cond_t cond_espacio;
+    
+    // Modo FIFO sin bloqueo (solo colas sin prioridad): si 'anillo' no es NULL
+    // las operaciones usan el anillo y los contadores de eventos, no el mutex
+    AnilloMPMC* anillo;
+    ContadorEventos hay_pacientes;
+    ContadorEventos hay_espacio;
+    
+    // Si no es NULL, se avisa a todos sus esperadores en cada inserción (lo
+    // usan los médicos que pueden tomar pacientes de varias colas)
+    ContadorEventos* aviso;
+    
+    ArenaPacientes* arena;     // De donde salen los pacientes de los handles
+    
+    // Colas de atención: con 'con_abandonos' cada paciente sabe en qué cola
+    // está y puede retirarse antes de llegar al frente. El retiro es O(1):
+    // deja una lápida (el handle sigue en su segmento, marcado como abandono)
+    // que la extracción descarta. 'count' cuenta solo a los que siguen
+    // esperando; el count de cada nivel incluye las lápidas.
+    int con_abandonos;
+    
+    int indice;                // Posición en la clínica (0 = recepción), para la traza
+#if INSTRUMENTAR_MUTEX
+    MedicionMutex medicion;    // De 'mutex' y sus dos variables de condición
+#endif
 } Cola;
 
-// Variables globales del sistema
-Cola cola_recepcion;
-Cola cola_medico_general;
-Cola cola_enfermeria;
-Cola cola_especialista[4];
+// Rueda jerárquica de temporizadores para los plazos de abandono: cada nivel
+// tiene 64 ranuras y cubre 64 veces el alcance del anterior; insertar es O(1)
+// y al avanzar un segundo solo se revisa una ranura (más una cascada cada 64 s).
+// Los temporizadores no se cancelan: al vencer se comprueba si el paciente
+// sigue esperando en la misma cola.
+#define RANURAS_RUEDA (1 << BITS_RUEDA)
+
+typedef struct {
+    HandlePaciente handle;
+    int id_paciente;           // Detecta slots reciclados para otro paciente
+    long vencimiento;          // Segundo de simulación del abandono
+} TemporizadorAbandono;
+
+typedef struct {
+    TemporizadorAbandono* entradas;
+    int count;
+    int capacidad;
+} RanuraRueda;
+
+typedef struct {
+    RanuraRueda ranuras[NIVELES_RUEDA][RANURAS_RUEDA];
+    long ahora;                // Último segundo procesado
+    int pendientes;
+    pthread_mutex_t mutex;
+} RuedaTemporizadores;
+
+// Dotación de personal de una clínica
+typedef struct {
+    int num_admin;
+    int num_medicos_general;
+    int num_enfermeras;
+    int num_especialistas;
+} ConfiguracionPersonal;
+
+// Tipos del motor de eventos discretos
+typedef enum {
+    EVENTO_LLEGADA,            // Llega un paciente a recepción
+    EVENTO_FIN_CLASIFICACION,  // Un admin termina de clasificar
+    EVENTO_FIN_ATENCION,       // Un médico termina una consulta
+    EVENTO_FIN_PAUSA,          // Un médico termina su pausa entre pacientes
+    EVENTO_GESTOR_PERSONAL,    // Revisión periódica de personal (cada 3 min)
+    EVENTO_MONITOR,            // Instantánea periódica del sistema (cada 5 min)
+    EVENTO_FIN_JORNADA,        // Fin de la jornada simulada
+    EVENTO_DESPERTAR_AGENTE,   // Planificador M:N: vence la espera de un agente
+    EVENTO_GUARDAR_ESTADO,     // Instantánea del estado completo (--guardar-estado)
+    EVENTO_LLEGADA_DERIVADA    // Red de clínicas: llega un paciente derivado por otra sede
+} TipoEvento;
+
+typedef struct {
+    long tiempo;               // Segundos de simulación
+    unsigned long secuencia;   // Desempate FIFO entre eventos simultáneos
+    TipoEvento tipo;           // Dice cuál de los campos de la unión vale
+    union {
+        int agente;            // Índice de admin o médico (o del agente del planificador M:N)
+        HandlePaciente paciente;  // EVENTO_LLEGADA_DERIVADA: el paciente que llega de otra sede
+    };
+} Evento;
+
+// Lista de eventos futuros (montículo binario por tiempo)
+typedef struct {
+    Evento* eventos;
+    int count;
+    int capacidad;
+    unsigned long siguiente_secuencia;
+} ListaEventos;
+
+// Llegada leída de un registro real (--llegadas ARCHIVO)
+typedef struct {
+    long tiempo;               // Segundos desde la primera llegada del registro
+    TipoAtencion tipo;
+    Especialidad especialidad;
+    int prioridad;
+} LlegadaRegistrada;
+
+// Posición de una clínica en el registro de llegadas (el archivo mapeado se comparte)
+typedef struct {
+    size_t posicion;           // Próximo byte a leer
+    size_t liberado;           // Páginas anteriores a este byte ya devueltas
+    long reloj;                // Hora de la última llegada entregada (modos con hilos y M:N)
+    long leidas;
+    long descartadas;          // Líneas que no se pudieron interpretar
+    int agotado;
+    LlegadaRegistrada proxima;
+} CursorLlegadas;
+
+// Pronóstico de demanda de un servicio (recepción o una cola de atención)
+// para dimensionar el personal activo
+typedef struct {
+    double tasa_llegadas;      // Promedio móvil exponencial, pacientes por segundo
+    long insertados_previos;   // Cola.insertados en la medición anterior
+    time_t ultima_medicion;
+    time_t ultimo_cambio;      // Último cambio de personal del servicio
+    int inicializado;
+} PronosticoServicio;
+
+// Estado de una clínica durante una jornada: pacientes, colas, personal,
+// contadores y reloj. Cada réplica de Monte Carlo simula su propia clínica
+// sin compartir nada con las demás; el modo normal usa clinica_principal.
+typedef struct {
+    ArenaPacientes arena_pacientes;
+    PoolSegmentos pool_segmentos;
+    
+    Cola cola_recepcion;
+    Cola cola_medico_general;
+    Cola cola_enfermeria;
+    Cola cola_especialista[4];
+    
+    ConfiguracionPersonal personal;
+    PersonalAdmin* personal_admin;  // personal.num_admin, reservados con la clínica
+    Medico* medicos;                // Generales, enfermeras y especialistas, en ese orden
+    int especialidad_cubierta[4];  // 0 = sin especialista: sus pacientes van a medicina general
+    ContadorEventos hay_trabajo;   // Alguna cola de atención recibió un paciente
+    ContadorEventos hay_recepcion; // Recepción recibió un paciente (admins esperando)
+    ContadorEventos cambio_personal; // El gestor activó o desactivó personal
+    RuedaTemporizadores rueda_abandonos;
+    
+    // Cambio dinámico de personal: los admins activos son los primeros
+    // 'admin_activos'; cada médico tiene su marca 'activo'
+    int admin_activos;
+    PronosticoServicio pronostico[NUM_COLAS_CLINICA];  // Por Cola.indice
+    
+    Estadisticas estadisticas;
+    int siguiente_id_paciente;
+    int total_no_contabilizados;
+    
+    // Motor de eventos discretos
+    long reloj_virtual;        // Segundos de simulación transcurridos
+    int jornada_activa;
+    ListaEventos lista_eventos;
+    HandlePaciente* paciente_en_clasificacion;  // Por admin
+    HandlePaciente* paciente_en_atencion;       // Por médico
+    int* medico_en_pausa;
+    int* libres_lote;          // Auxiliares de las extracciones por lotes
+    HandlePaciente* lote;
+    long eventos_procesados;
+    HistogramaNanosegundos* latencia_eventos;  // Solo --benchmark: nanosegundos por evento
+    
+    // Productores detenidos por una cola llena con política bloquear: el admin
+    // conserva al paciente clasificado y el generador retiene la próxima llegada
+    int* admin_bloqueado;
+    HandlePaciente llegada_bloqueada;
+    
+    CursorLlegadas llegadas;   // Solo con --llegadas
+} Clinica;
 
-PersonalAdmin personal_admin[MAX_ADMIN];
-Medico medicos[MAX_MEDICOS];
+// Configuración del sistema (compartida por todas las clínicas)
+// Dotación por defecto (--personal A,G,E,S); el optimizador prueba otras
+ConfiguracionPersonal personal_configurado = {
+    .num_admin = 4, // Cambiado de 2 a 4
+    .num_medicos_general = 4,
+    .num_enfermeras = 2,
+    .num_especialistas = 2
+};
 
-int num_admin = 4; // Cambiado de 2 a 4
-int num_medicos_general = 4;
-int num_enfermeras = 2;
-int num_especialistas = 2;
+// Recepción usa el anillo sin bloqueo salvo con --recepcion-mutex
+int recepcion_sin_bloqueo = 1;
+uint64_t celdas_anillo_recepcion = TAM_ANILLO_RECEPCION;  // --anillo N (se redondea a potencia de 2)
 
-// Variables para cambio dinámico de personal
-int admin_activos = 2;
-time_t ultimo_cambio_personal = 0;
+// Modo acotado de las colas (--capacidad N --politica bloquear|rechazar|desviar)
+int capacidad_colas = 0;
+PoliticaDesborde politica_desborde = POLITICA_RECHAZAR;
 
-// Estadísticas
-int total_pacientes_generados = 0;
-int total_pacientes_clasificados = 0;
-int total_pacientes_atendidos = 0;
-int total_pacientes_abandonaron = 0;
-int total_no_contabilizados = 0;
+// Personal administrativo activo al comenzar la jornada
+int admin_activos_inicial = 2;
+
+// Réplicas de Monte Carlo (--replicas N): 0 = una sola jornada con reporte diario
+int num_replicas = 0;
+int hilos_replicas = 0;                 // 0 = un hilo por núcleo (también para --mn)
+
+// Modo con hilos: agentes como máquinas de estado sobre un pool de hilos (--mn)
+int modo_agentes_mn = 0;
 
-pthread_mutex_t stats_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_mutex_t print_mutex = PTHREAD_MUTEX_INITIALIZER;
+#if INSTRUMENTAR_MUTEX
+MedicionMutex medicion_print;
+#endif
 
 volatile int simulacion_activa = 1;
 time_t tiempo_inicio_simulacion;
 
+// Modo de eventos discretos: el tiempo avanza con un reloj virtual en lugar de sleep()
+int modo_eventos_discretos = 0;
+int duracion_jornada = 8 * 3600;        // Duración de la jornada en modo eventos discretos
+
+// Clínica sobre la que opera cada hilo: los agentes del modo con hilos
+// comparten la principal, cada trabajador de réplicas apunta a la suya
+Clinica clinica_principal;
+static __thread Clinica* clinica = &clinica_principal;
+
+// Generador aleatorio por hilo (xoshiro256**): rand() comparte estado (y un
+// candado) entre todos los hilos. Cada hilo o réplica usa su propio flujo,
+// derivado de la única semilla de la corrida (--semilla), así que la misma
+// semilla reproduce la misma secuencia de eventos en modo eventos discretos.
+uint64_t semilla_global = 0;
+
+// Flujos: uno por agente del modo con hilos y uno por réplica. Los del
+// personal van en su propio rango para que subir MAX_ADMIN o MAX_MEDICOS
+// no corra los de las réplicas (y con ellos los resultados de una semilla)
+#define FLUJO_PRINCIPAL 0
+#define FLUJO_GENERADOR 1
+#define FLUJO_PRIMERA_REPLICA 16
+#define FLUJO_ADMIN(i) ((1ull << 32) + (uint64_t)(i))
+#define FLUJO_MEDICO(i) ((2ull << 32) + (uint64_t)(i))
+#define FLUJO_REPLICA(k) (FLUJO_PRIMERA_REPLICA + (uint64_t)(k))
+
+static __thread uint64_t estado_aleatorio[4] = {1, 2, 3, 4};
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Sembrar el generador del hilo con el flujo dado de la semilla global: la
+// multiplicación por una constante impar da un punto de partida distinto por flujo
+void sembrar_aleatorio(uint64_t flujo) {
+    uint64_t x = semilla_global;
+    x = splitmix64(&x) ^ (flujo * 0xD1B54A32D192ED03ull);
+    for (int i = 0; i < 4; i++) {
+        estado_aleatorio[i] = splitmix64(&x);
+    }
+}
+
+static inline uint64_t rotar_izquierda(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+uint64_t siguiente_aleatorio(void) {
+    uint64_t* s = estado_aleatorio;
+    uint64_t resultado = rotar_izquierda(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotar_izquierda(s[3], 45);
+    
+    return resultado;
+}
+
+// Entero no negativo de 31 bits (reemplazo directo de rand())
+int aleatorio(void) {
+    return (int)(siguiente_aleatorio() >> 33);
+}
+
+// Uniforme en [0, 1)
+double aleatorio_uniforme(void) {
+    return (siguiente_aleatorio() >> 11) * 0x1.0p-53;
+}
+
+double aleatorio_exponencial(double media) {
+    return -media * log(1.0 - aleatorio_uniforme());
+}
+
+// Lognormal con la media dada; 'sigma' es el desvío del logaritmo
+double aleatorio_lognormal(double media, double sigma) {
+    double normal = sqrt(-2.0 * log(1.0 - aleatorio_uniforme())) *
+                    cos(2.0 * M_PI * aleatorio_uniforme());
+    return exp(log(media) - sigma * sigma / 2 + sigma * normal);
+}
+
 // Manejador de señal para terminar la simulación
 void manejador_senal(int sig) {
     (void)sig;
     simulacion_activa = 0;
 }
 
+// Tiempo de simulación transcurrido (en segundos simulados) según el modo activo
+time_t tiempo_simulado(void) {
+    if (modo_eventos_discretos) return clinica->reloj_virtual;
+    return (time(NULL) - tiempo_inicio_simulacion) * SPEED_FACTOR;
+}
+
 // Función para dormir ajustada por factor de velocidad
 void dormir_simulacion(int segundos) {
     if (segundos <= 0) return;
@@ -121,613 +714,7219 @@ void dormir_simulacion(int segundos) {
     }
 }
 
-// Funciones de cola
-void init_cola(Cola *cola) {
-    cola->frente = 0;
-    cola->final = 0;
-    cola->count = 0;
-    pthread_mutex_init(&cola->mutex, NULL);
-    pthread_cond_init(&cola->cond, NULL);
+// ============================================================
+// Registro de eventos asíncrono
+// ------------------------------------------------------------
+// Cada hilo escribe sus mensajes en un anillo propio (un productor, un
+// consumidor) y un hilo escritor los vuelca a stdout. Los agentes ya no
+// compiten por print_mutex: solo lo toma el escritor. El nivel se filtra
+// antes de formatear, así que en modo silencioso un mensaje cuesta una
+// comparación; con -DNIVEL_LOG_COMPILADO=N los niveles superiores a N ni
+// siquiera se compilan.
+// ============================================================
+
+typedef enum {
+    NIVEL_SILENCIO,
+    NIVEL_ERROR,
+    NIVEL_AVISO,               // Instantáneas del sistema y alertas de personal
+    NIVEL_INFO,                // Eventos de cada paciente
+    NIVEL_DEBUG                // Detalle interno de las colas
+} NivelLog;
+
+#ifndef NIVEL_LOG_COMPILADO
+#define NIVEL_LOG_COMPILADO NIVEL_DEBUG
+#endif
+
+#define TAM_BUFFER_LOG 65536       // Bytes por anillo de hilo (potencia de 2)
+#define TAM_MENSAJE_LOG 2048       // Máximo por mensaje
+#define MARCA_RELLENO_LOG UINT32_MAX
+
+typedef struct BufferLog {
+    char datos[TAM_BUFFER_LOG];
+    uint64_t escritura;        // Solo la avanza el hilo dueño
+    char relleno[64 - sizeof(uint64_t)];
+    uint64_t lectura;          // Solo la avanza el hilo escritor
+    int abandonado;            // El hilo dueño terminó: se puede reutilizar
+    struct BufferLog* siguiente;
+} BufferLog;
+
+int nivel_log = NIVEL_INFO;
+
+static BufferLog* buffers_log = NULL;
+static pthread_mutex_t registro_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t clave_buffer_log;
+static pthread_t hilo_escritor_log;
+static volatile int log_activo = 0;
+static volatile int log_detener = 0;
+static __thread BufferLog* buffer_log_hilo = NULL;
+
+#define log_habilitado(nivel) ((nivel) <= NIVEL_LOG_COMPILADO && (nivel) <= nivel_log)
+
+#define LOG(nivel, ...) do { \
+    if (log_habilitado(nivel)) registrar_log(__VA_ARGS__); \
+} while (0)
+
+static void soltar_buffer_log(void* buffer) {
+    __atomic_store_n(&((BufferLog*)buffer)->abandonado, 1, __ATOMIC_RELEASE);
 }
 
-void enqueue(Cola *cola, Paciente paciente) {
-    pthread_mutex_lock(&cola->mutex);
+// Anillo del hilo actual; reutiliza el de un hilo terminado si ya se vació
+static BufferLog* obtener_buffer_log(void) {
+    if (buffer_log_hilo) return buffer_log_hilo;
     
-    if (cola->count < MAX_PACIENTES) {
-        cola->pacientes[cola->final] = paciente;
-        cola->final = (cola->final + 1) % MAX_PACIENTES;
-        cola->count++;
-        pthread_cond_signal(&cola->cond);
+    pthread_mutex_lock(&registro_log_mutex);
+    BufferLog* buffer = NULL;
+    for (BufferLog* b = buffers_log; b; b = b->siguiente) {
+        if (__atomic_load_n(&b->abandonado, __ATOMIC_ACQUIRE) &&
+            __atomic_load_n(&b->lectura, __ATOMIC_ACQUIRE) == b->escritura) {
+            b->abandonado = 0;
+            buffer = b;
+            break;
+        }
+    }
+    if (!buffer) {
+        buffer = calloc(1, sizeof(BufferLog));
+        if (!buffer) {
+            pthread_mutex_unlock(&registro_log_mutex);
+            return NULL;
+        }
+        buffer->siguiente = buffers_log;
+        __atomic_store_n(&buffers_log, buffer, __ATOMIC_RELEASE);
     }
+    pthread_mutex_unlock(&registro_log_mutex);
     
-    pthread_mutex_unlock(&cola->mutex);
+    pthread_setspecific(clave_buffer_log, buffer);
+    buffer_log_hilo = buffer;
+    return buffer;
+}
+
+static void escribir_directo(const char* mensaje, int len) {
+    tomar_mutex(&print_mutex, &medicion_print);
+    fwrite(mensaje, 1, len, stdout);
+    soltar_mutex(&print_mutex, &medicion_print);
 }
 
-Paciente dequeue(Cola *cola) {
-    pthread_mutex_lock(&cola->mutex);
+// Formatear y encolar un mensaje; usar a través de LOG() para filtrar por nivel
+__attribute__((format(printf, 1, 2)))
+void registrar_log(const char* formato, ...) {
+    char mensaje[TAM_MENSAJE_LOG];
+    va_list args;
+    va_start(args, formato);
+    int len = vsnprintf(mensaje, sizeof(mensaje), formato, args);
+    va_end(args);
+    if (len < 0) return;
+    if (len >= TAM_MENSAJE_LOG) len = TAM_MENSAJE_LOG - 1;
     
-    while (cola->count == 0 && simulacion_activa) {
-        pthread_cond_wait(&cola->cond, &cola->mutex);
+    BufferLog* buffer = log_activo ? obtener_buffer_log() : NULL;
+    if (!buffer) {
+        // Sin escritor (antes de iniciarlo o durante el cierre): salida directa
+        escribir_directo(mensaje, len);
+        return;
     }
     
-    Paciente paciente = {0};
-    if (cola->count > 0) {
-        paciente = cola->pacientes[cola->frente];
-        cola->frente = (cola->frente + 1) % MAX_PACIENTES;
-        cola->count--;
+    uint32_t total = (sizeof(uint32_t) + len + 7) & ~7u;
+    uint64_t escritura = buffer->escritura;
+    uint64_t pos, hasta_fin;
+    while (1) {
+        uint64_t lectura = __atomic_load_n(&buffer->lectura, __ATOMIC_ACQUIRE);
+        pos = escritura & (TAM_BUFFER_LOG - 1);
+        hasta_fin = TAM_BUFFER_LOG - pos;
+        uint64_t necesario = total + ((hasta_fin < total) ? hasta_fin : 0);
+        if (TAM_BUFFER_LOG - (escritura - lectura) >= necesario) break;
+        
+        // Anillo lleno: esperar al escritor en lugar de perder el mensaje
+        if (!log_activo) {
+            escribir_directo(mensaje, len);
+            return;
+        }
+        sched_yield();
     }
     
-    pthread_mutex_unlock(&cola->mutex);
-    return paciente;
+    if (hasta_fin < total) {
+        // No cabe antes del final: marcar el resto como relleno y volver al inicio
+        uint32_t marca = MARCA_RELLENO_LOG;
+        memcpy(buffer->datos + pos, &marca, sizeof(marca));
+        escritura += hasta_fin;
+        pos = 0;
+    }
+    uint32_t largo = (uint32_t)len;
+    memcpy(buffer->datos + pos, &largo, sizeof(largo));
+    memcpy(buffer->datos + pos + sizeof(largo), mensaje, len);
+    __atomic_store_n(&buffer->escritura, escritura + total, __ATOMIC_RELEASE);
 }
 
-// Insertar con prioridad (prioridad más baja = número menor)
-void enqueue_prioridad(Cola *cola, Paciente paciente) {
-    pthread_mutex_lock(&cola->mutex);
-    
-    if (cola->count < MAX_PACIENTES) {
-        // Si la cola está vacía, insertar directamente
-        if (cola->count == 0) {
-            cola->pacientes[cola->final] = paciente;
-            cola->final = (cola->final + 1) % MAX_PACIENTES;
-            cola->count++;
-        } else {
-            // Encontrar posición correcta basada en prioridad
-            int pos_insercion = cola->final;
-            int elementos_movidos = 0;
-            
-            // Buscar desde el final hacia el frente
-            for (int i = 0; i < cola->count; i++) {
-                int idx_actual = (cola->final - 1 - i + MAX_PACIENTES) % MAX_PACIENTES;
-                if (cola->pacientes[idx_actual].prioridad <= paciente.prioridad) {
-                    break;
-                }
-                // Mover elemento una posición hacia adelante
-                int idx_siguiente = (idx_actual + 1) % MAX_PACIENTES;
-                cola->pacientes[idx_siguiente] = cola->pacientes[idx_actual];
-                pos_insercion = idx_actual;
-                elementos_movidos++;
-            }
-            
-            cola->pacientes[pos_insercion] = paciente;
-            cola->final = (cola->final + 1) % MAX_PACIENTES;
-            cola->count++;
-            
-            if (elementos_movidos > 0) {
-                pthread_mutex_lock(&print_mutex);
-                printf("🔄 Paciente %d insertado con prioridad %d, %d pacientes reordenados\n", 
-                       paciente.id, paciente.prioridad, elementos_movidos);
-                pthread_mutex_unlock(&print_mutex);
+// Volcar todo lo pendiente; devuelve cuántos mensajes se escribieron
+static int drenar_buffers_log(void) {
+    int escritos = 0;
+    
+    tomar_mutex(&print_mutex, &medicion_print);
+    for (BufferLog* b = __atomic_load_n(&buffers_log, __ATOMIC_ACQUIRE); b; b = b->siguiente) {
+        uint64_t lectura = b->lectura;
+        uint64_t escritura = __atomic_load_n(&b->escritura, __ATOMIC_ACQUIRE);
+        
+        while (lectura < escritura) {
+            uint64_t pos = lectura & (TAM_BUFFER_LOG - 1);
+            uint32_t largo;
+            memcpy(&largo, b->datos + pos, sizeof(largo));
+            if (largo == MARCA_RELLENO_LOG) {
+                lectura += TAM_BUFFER_LOG - pos;
+                continue;
             }
+            fwrite(b->datos + pos + sizeof(largo), 1, largo, stdout);
+            lectura += (sizeof(uint32_t) + largo + 7) & ~7u;
+            escritos++;
         }
-        
-        pthread_cond_signal(&cola->cond);
+        __atomic_store_n(&b->lectura, lectura, __ATOMIC_RELEASE);
     }
+    if (escritos > 0) fflush(stdout);
+    soltar_mutex(&print_mutex, &medicion_print);
     
-    pthread_mutex_unlock(&cola->mutex);
+    return escritos;
 }
 
-// Función para verificar abandono basada en tiempo real de espera
-int verificar_abandono(time_t tiempo_inicio_espera) {
-    time_t tiempo_actual = time(NULL);
-    int tiempo_espera_real = tiempo_actual - tiempo_inicio_espera;
-    
-    // Convertir a tiempo de simulación
-    int tiempo_espera_sim = tiempo_espera_real * SPEED_FACTOR;
+static void* escritor_log(void* arg) {
+    (void)arg;
+    struct timespec espera = { 0, 1000000 }; // 1 ms sin mensajes
     
-    // Abandonos más frecuentes para mostrar el problema
-    // Más de 20 minutos de simulación
-    if (tiempo_espera_sim > 1200) {
-        return (rand() % 100) < 40; // 40% probabilidad
-    }
-    // Más de 15 minutos de simulación
-    else if (tiempo_espera_sim > 900) {
-        return (rand() % 100) < 25; // 25% probabilidad
-    }
-    // Más de 10 minutos de simulación
-    else if (tiempo_espera_sim > 600) {
-        return (rand() % 100) < 15; // 15% probabilidad
+    while (!log_detener) {
+        if (drenar_buffers_log() == 0) {
+            nanosleep(&espera, NULL);
+        }
     }
-    
-    return 0;
+    drenar_buffers_log();
+    return NULL;
 }
 
-// Hilo generador de pacientes
-void* generador_pacientes(void* arg) {
-    (void)arg;
-    srand(time(NULL) + (unsigned long)pthread_self());
+void iniciar_log(void) {
+    pthread_key_create(&clave_buffer_log, soltar_buffer_log);
+    log_detener = 0;
+    log_activo = 1;
+    pthread_create(&hilo_escritor_log, NULL, escritor_log, NULL);
+}
+
+// Detener el escritor después de vaciar los anillos; lo que se registre
+// después se imprime directamente
+void finalizar_log(void) {
+    if (!log_activo) return;
+    log_detener = 1;
+    pthread_join(hilo_escritor_log, NULL);
+    log_activo = 0;
+    drenar_buffers_log();
+}
+
+// Funciones de estadísticas
+static __thread Estadisticas* estadisticas_del_shard = NULL;
+static __thread ShardEstadisticas* shard_hilo = NULL;
+
+// Shard del hilo actual; el primer uso reserva uno libre
+static ShardEstadisticas* shard_actual(Estadisticas* est) {
+    if (estadisticas_del_shard == est) return shard_hilo;
     
-    while (simulacion_activa) {
-        // Tiempo entre llegadas: 5-45 segundos de simulación
-        int intervalo = rand() % 41 + 5; // 5-45 segundos
-        dormir_simulacion(intervalo);
-        
-        if (!simulacion_activa) break;
-        
-        Paciente nuevo_paciente = {0};
-        
-        pthread_mutex_lock(&stats_mutex);
-        nuevo_paciente.id = ++total_pacientes_generados;
-        pthread_mutex_unlock(&stats_mutex);
-        
-        nuevo_paciente.tiempo_llegada = time(NULL);
-        nuevo_paciente.prioridad = rand() % 5 + 1;
-        
-        // Distribución: 70% general, 15% enfermería, 15% especialidad
-        int tipo_rand = rand() % 100;
-        if (tipo_rand < 70) {
-            nuevo_paciente.tipo_atencion = ATENCION_GENERAL;
-        } else if (tipo_rand < 85) {
-            nuevo_paciente.tipo_atencion = ATENCION_ENFERMERIA;
-        } else {
-            nuevo_paciente.tipo_atencion = ATENCION_ESPECIALIDAD;
-            nuevo_paciente.especialidad = rand() % 4;
-        }
-        
-        enqueue(&cola_recepcion, nuevo_paciente);
-        
-        pthread_mutex_lock(&print_mutex);
-        printf("👤 Paciente %d llegó - Tipo: %s, Prioridad: %d\n", 
-               nuevo_paciente.id,
-               (nuevo_paciente.tipo_atencion == ATENCION_GENERAL) ? "General" :
-               (nuevo_paciente.tipo_atencion == ATENCION_ENFERMERIA) ? "Enfermería" : "Especialidad",
-               nuevo_paciente.prioridad);
-        pthread_mutex_unlock(&print_mutex);
+    int indice = __atomic_fetch_add(&est->num_shards, 1, __ATOMIC_RELAXED);
+    shard_hilo = (indice < MAX_SHARDS_ESTADISTICAS) ? &est->shards[indice] : &est->compartido;
+    
+    // preparar_clinica no limpia los shards (son casi toda la clínica y una
+    // jornada usa pocos): lo hace su dueño al reservarlo
+    if (shard_hilo != &est->compartido) {
+        uint32_t secuencia = shard_hilo->secuencia | 1;
+        __atomic_store_n(&shard_hilo->secuencia, secuencia, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        memset(&shard_hilo->contadores, 0, sizeof(ContadoresPacientes));
+        __atomic_store_n(&shard_hilo->secuencia, secuencia + 1, __ATOMIC_RELEASE);
+        memset(&shard_hilo->histogramas, 0, sizeof(HistogramasPacientes));
     }
+    estadisticas_del_shard = est;
+    return shard_hilo;
+}
+
+// Sumar 'valor' al contador en el desplazamiento dado de ContadoresPacientes
+void sumar_estadistica(Estadisticas* est, size_t desplazamiento, long valor) {
+    ShardEstadisticas* shard = shard_actual(est);
+    int compartido = (shard == &est->compartido);
+    if (compartido) tomar_mutex(&est->mutex_compartido, &est->medicion_compartido);
     
-    return NULL;
+    long* contador = (long*)((char*)&shard->contadores + desplazamiento);
+    uint32_t secuencia = shard->secuencia;
+    __atomic_store_n(&shard->secuencia, secuencia + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(contador, *contador + valor, __ATOMIC_RELAXED);
+    __atomic_store_n(&shard->secuencia, secuencia + 2, __ATOMIC_RELEASE);
+    
+    if (compartido) soltar_mutex(&est->mutex_compartido, &est->medicion_compartido);
 }
 
-// Hilo del personal administrativo
-void* personal_administrativo(void* arg) {
-    PersonalAdmin* admin = (PersonalAdmin*)arg;
-    srand(time(NULL) + (unsigned long)pthread_self() + admin->id);
+// Sumar todos los contadores de 'parcial' en una sola escritura del shard
+// (al restaurar una instantánea)
+void sumar_contadores(Estadisticas* est, const ContadoresPacientes* parcial) {
+    ShardEstadisticas* shard = shard_actual(est);
+    int compartido = (shard == &est->compartido);
+    if (compartido) tomar_mutex(&est->mutex_compartido, &est->medicion_compartido);
     
-    while (simulacion_activa) {
-        Paciente paciente = dequeue(&cola_recepcion);
-        if (paciente.id == 0) continue;
-        
-        admin->ocupado = 1;
-        
-        pthread_mutex_lock(&print_mutex);
-        printf("📋 Admin %d clasificando paciente %d\n", admin->id, paciente.id);
-        pthread_mutex_unlock(&print_mutex);
-        
-        // Tiempo de clasificación: 2-5 minutos (120-300 segundos)
-        int tiempo_clasificacion = rand() % 121 + 60; // 60-180 segundos (1-3 min)
-        dormir_simulacion(tiempo_clasificacion);
-        
-        if (!simulacion_activa) break;
-        
-        paciente.tiempo_clasificacion = time(NULL);
-        paciente.clasificado = 1;
-        admin->pacientes_clasificados++;
-        
-        pthread_mutex_lock(&stats_mutex);
-        total_pacientes_clasificados++;
-        pthread_mutex_unlock(&stats_mutex);
-        
-        // Dirigir a la cola correspondiente
-        switch (paciente.tipo_atencion) {
-            case ATENCION_GENERAL:
-                enqueue_prioridad(&cola_medico_general, paciente);
-                break;
-            case ATENCION_ENFERMERIA:
-                enqueue_prioridad(&cola_enfermeria, paciente);
-                break;
-            case ATENCION_ESPECIALIDAD:
-                enqueue_prioridad(&cola_especialista[paciente.especialidad], paciente);
-                break;
-        }
-        
-        pthread_mutex_lock(&print_mutex);
-        printf("✅ Admin %d clasificó paciente %d hacia %s\n", 
-               admin->id, paciente.id,
-               (paciente.tipo_atencion == ATENCION_GENERAL) ? "Médico General" :
-               (paciente.tipo_atencion == ATENCION_ENFERMERIA) ? "Enfermería" : "Especialista");
-        pthread_mutex_unlock(&print_mutex);
-        
-        admin->ocupado = 0;
+    long* contadores = (long*)&shard->contadores;
+    uint32_t secuencia = shard->secuencia;
+    __atomic_store_n(&shard->secuencia, secuencia + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t c = 0; c < NUM_CONTADORES; c++) {
+        __atomic_store_n(&contadores[c], contadores[c] + ((const long*)parcial)[c], __ATOMIC_RELAXED);
     }
+    __atomic_store_n(&shard->secuencia, secuencia + 2, __ATOMIC_RELEASE);
     
-    return NULL;
+    if (compartido) soltar_mutex(&est->mutex_compartido, &est->medicion_compartido);
 }
 
-// Hilo del médico
-void* medico_atencion(void* arg) {
-    Medico* medico = (Medico*)arg;
-    srand(time(NULL) + (unsigned long)pthread_self() + medico->id);
+// Sumar una muestra a la cubeta en el desplazamiento dado de HistogramasPacientes
+void sumar_cubeta(Estadisticas* est, size_t desplazamiento) {
+    ShardEstadisticas* shard = shard_actual(est);
+    int compartido = (shard == &est->compartido);
+    if (compartido) tomar_mutex(&est->mutex_compartido, &est->medicion_compartido);
     
-    Cola* cola_asignada = NULL;
-    const char* tipo_str = "";
+    long* cubeta = (long*)((char*)&shard->histogramas + desplazamiento);
+    __atomic_store_n(cubeta, *cubeta + 1, __ATOMIC_RELAXED);
     
-    switch (medico->tipo) {
-        case ATENCION_GENERAL:
-            cola_asignada = &cola_medico_general;
-            tipo_str = "Médico";
-            break;
-        case ATENCION_ENFERMERIA:
-            cola_asignada = &cola_enfermeria;
-            tipo_str = "Enfermera";
-            break;
-        case ATENCION_ESPECIALIDAD:
-            cola_asignada = &cola_especialista[medico->especialidad];
-            tipo_str = "Especialista";
-            break;
-    }
+    if (compartido) soltar_mutex(&est->mutex_compartido, &est->medicion_compartido);
+}
+
+// Sumar todos los histogramas de 'parcial' (al restaurar una instantánea)
+void sumar_histogramas(Estadisticas* est, const HistogramasPacientes* parcial) {
+    ShardEstadisticas* shard = shard_actual(est);
+    int compartido = (shard == &est->compartido);
+    if (compartido) tomar_mutex(&est->mutex_compartido, &est->medicion_compartido);
     
-    while (simulacion_activa) {
-        Paciente paciente = dequeue(cola_asignada);
-        if (paciente.id == 0) continue;
-        
-        // Verificar si el paciente abandonó mientras esperaba
-        if (verificar_abandono(paciente.tiempo_clasificacion)) {
-            pthread_mutex_lock(&stats_mutex);
-            total_pacientes_abandonaron++;
-            pthread_mutex_unlock(&stats_mutex);
-            
-            pthread_mutex_lock(&print_mutex);
-            printf("🚪 Paciente %d abandonó la cola por tiempo de espera\n", paciente.id);
-            pthread_mutex_unlock(&print_mutex);
-            continue;
-        }
-        
-        medico->ocupado = 1;
-        paciente.tiempo_atencion = time(NULL);
-        
-        pthread_mutex_lock(&print_mutex);
-        printf("🩺 %s %d atendiendo paciente %d\n", tipo_str, medico->id, paciente.id);
-        pthread_mutex_unlock(&print_mutex);
-        
-        // Tiempo de atención: 12-18 minutos (720-1080 segundos)
-        int tiempo_atencion = rand() % 241 + 480; // 480-720 segundos (8-12 min)
-        dormir_simulacion(tiempo_atencion);
-        
-        if (!simulacion_activa) break;
-        
-        medico->pacientes_atendidos++;
-        paciente.atendido = 1;
-        
-        pthread_mutex_lock(&stats_mutex);
-        total_pacientes_atendidos++;
-        pthread_mutex_unlock(&stats_mutex);
-        
-        pthread_mutex_lock(&print_mutex);
-        printf("✅ %s %d terminó de atender paciente %d\n", tipo_str, medico->id, paciente.id);
-        pthread_mutex_unlock(&print_mutex);
-        
-        medico->ocupado = 0;
-        
-        // Pausa entre pacientes: 2-3 minutos (120-180 segundos)
-        int tiempo_pausa = rand() % 61 + 60; // 60-120 segundos (1-2 min)
-        dormir_simulacion(tiempo_pausa);
+    long* cubetas = (long*)&shard->histogramas;
+    for (size_t c = 0; c < NUM_CUBETAS_HISTOGRAMAS; c++) {
+        __atomic_store_n(&cubetas[c], cubetas[c] + ((const long*)parcial)[c], __ATOMIC_RELAXED);
     }
     
-    return NULL;
+    if (compartido) soltar_mutex(&est->mutex_compartido, &est->medicion_compartido);
 }
 
-// Función para gestionar cambios dinámicos de personal
+#define ACUMULAR_ESTADISTICA(campo, valor) \
+    sumar_estadistica(&clinica->estadisticas, offsetof(ContadoresPacientes, campo), (valor))
+#define SUMAR_ESTADISTICA(campo) ACUMULAR_ESTADISTICA(campo, 1)
+#define SUMAR_CUBETA(cubeta) \
+    sumar_cubeta(&clinica->estadisticas, offsetof(HistogramasPacientes, cubeta))
+
+// Copia consistente de los primeros 'n' contadores de un shard (reintenta
+// si el dueño estaba escribiendo)
+static void leer_contadores_shard(ShardEstadisticas* shard, long* destino, size_t n) {
+    long* origen = (long*)&shard->contadores;
+    uint32_t antes, despues;
+    do {
+        antes = __atomic_load_n(&shard->secuencia, __ATOMIC_ACQUIRE);
+        for (size_t i = 0; i < n; i++) {
+            destino[i] = __atomic_load_n(&origen[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        despues = __atomic_load_n(&shard->secuencia, __ATOMIC_RELAXED);
+    } while ((antes & 1) || antes != despues);
+}
+
+static ContadoresPacientes leer_shard(ShardEstadisticas* shard) {
+    ContadoresPacientes copia;
+    leer_contadores_shard(shard, (long*)&copia, NUM_CONTADORES);
+    return copia;
+}
+
+// Totales de todos los shards; única vía de lectura para monitores y reportes
+ContadoresPacientes leer_estadisticas(Estadisticas* est) {
+    ContadoresPacientes total = {0};
+    int num_shards = __atomic_load_n(&est->num_shards, __ATOMIC_RELAXED);
+    if (num_shards > MAX_SHARDS_ESTADISTICAS) num_shards = MAX_SHARDS_ESTADISTICAS;
+    
+    for (int i = 0; i <= num_shards; i++) {
+        ShardEstadisticas* shard = (i < num_shards) ? &est->shards[i] : &est->compartido;
+        ContadoresPacientes parcial = leer_shard(shard);
+        for (size_t c = 0; c < NUM_CONTADORES; c++) {
+            ((long*)&total)[c] += ((long*)&parcial)[c];
+        }
+    }
+    return total;
+}
+
+// Histogramas de todos los shards: para reportes y resúmenes de jornada
+void leer_histogramas(Estadisticas* est, HistogramasPacientes* total) {
+    memset(total, 0, sizeof(*total));
+    int num_shards = __atomic_load_n(&est->num_shards, __ATOMIC_RELAXED);
+    if (num_shards > MAX_SHARDS_ESTADISTICAS) num_shards = MAX_SHARDS_ESTADISTICAS;
+    
+    for (int i = 0; i <= num_shards; i++) {
+        ShardEstadisticas* shard = (i < num_shards) ? &est->shards[i] : &est->compartido;
+        const long* origen = (const long*)&shard->histogramas;
+        for (size_t c = 0; c < NUM_CUBETAS_HISTOGRAMAS; c++) {
+            ((long*)total)[c] += __atomic_load_n(&origen[c], __ATOMIC_RELAXED);
+        }
+    }
+}
+
+_Static_assert(offsetof(ContadoresPacientes, abandonaron) == 3 * sizeof(long),
+               "Los totales de pacientes deben ser los 4 primeros contadores");
+
+// Solo los totales de pacientes (los 4 primeros contadores), sin copiar los
+// histogramas: para muestreos frecuentes
+void leer_totales_pacientes(Estadisticas* est, long totales[4]) {
+    int num_shards = __atomic_load_n(&est->num_shards, __ATOMIC_RELAXED);
+    if (num_shards > MAX_SHARDS_ESTADISTICAS) num_shards = MAX_SHARDS_ESTADISTICAS;
+    
+    totales[0] = totales[1] = totales[2] = totales[3] = 0;
+    for (int i = 0; i <= num_shards; i++) {
+        ShardEstadisticas* shard = (i < num_shards) ? &est->shards[i] : &est->compartido;
+        long parcial[4];
+        leer_contadores_shard(shard, parcial, 4);
+        for (int c = 0; c < 4; c++) totales[c] += parcial[c];
+    }
+}
+
+// Olvidar el shard del hilo: una clínica nueva puede ocupar la misma dirección
+void reiniciar_shard_hilo(void) {
+    estadisticas_del_shard = NULL;
+    shard_hilo = NULL;
+}
+
+// ============================================================
+// Traza binaria de eventos (--traza ARCHIVO)
+// ------------------------------------------------------------
+// Registros de 32 bytes escritos sobre un archivo mapeado en memoria y
+// de solo anexado. Cada hilo reserva un bloque propio del archivo y lo
+// llena sin candados; al agotarlo reserva el siguiente. Los huecos que
+// quedan al final de cada bloque son registros en cero (TRAZA_VACIO).
+// El orden global lo da 'secuencia'; el analizador (--analizar-traza)
+// no necesita ordenar para reconstruir largos de cola y utilización.
+// ============================================================
+
+typedef enum {
+    TRAZA_VACIO,               // Hueco al final de un bloque
+    TRAZA_LLEGADA,
+    TRAZA_ENCOLADO,            // Entra a una cola (también por desvío)
+    TRAZA_DESENCOLADO,         // Sale del frente de una cola
+    TRAZA_RECHAZADO,           // Rechazado por cola llena
+    TRAZA_INICIO_CLASIFICACION,
+    TRAZA_FIN_CLASIFICACION,
+    TRAZA_INICIO_ATENCION,
+    TRAZA_FIN_ATENCION,
+    TRAZA_ABANDONO,            // Se retira de la cola al agotar su paciencia
+    NUM_EVENTOS_TRAZA
+} EventoTraza;
+
+typedef struct {
+    uint64_t secuencia;
+    int64_t tiempo;            // Segundos de simulación
+    uint32_t paciente;
+    uint16_t evento;
+    int16_t personal;          // Admin (clasificación) o médico (atención); -1 si no aplica
+    int16_t cola;              // Índice de la cola en la clínica; -1 si no aplica
+    uint8_t prioridad;
+    uint8_t tipo_atencion;
+    uint32_t reservado;
+} RegistroTraza;
+
+_Static_assert(sizeof(RegistroTraza) == 32, "RegistroTraza debe ocupar 32 bytes");
+_Static_assert(MAX_MEDICOS <= INT16_MAX && MAX_ADMIN <= INT16_MAX, "RegistroTraza.personal es de 16 bits");
+
+#define MAGIA_TRAZA "TRAZACLN"
+#define VERSION_TRAZA 3
+#define PAGINA_TRAZA 4096                   // La cabecera ocupa páginas enteras: los bloques quedan alineados
+#define REGISTROS_BLOQUE_TRAZA 4096         // 128 KB por bloque de hilo
+#define CRECIMIENTO_TRAZA (64L << 20)       // El archivo crece de a 64 MB
+
+
+typedef struct {
+    char magia[8];
+    uint32_t version;
+    uint32_t tam_registro;
+    uint64_t semilla;
+    int32_t factor_velocidad;  // 0 en modo eventos discretos
+    int32_t num_admin;
+    int32_t num_medicos;
+    uint32_t tam_cabecera;     // Bytes hasta el primer bloque, con la tabla de médicos
+    uint32_t reservado;
+    struct {
+        uint8_t tipo;
+        uint8_t especialidad;
+    } medicos[];               // num_medicos entradas
+} CabeceraTraza;
+
+// La tabla de médicos sigue a la cabecera; los bloques empiezan en la página siguiente
+static size_t tam_cabecera_traza(int num_medicos) {
+    size_t bytes = sizeof(CabeceraTraza) + (size_t)num_medicos * sizeof(((CabeceraTraza*)0)->medicos[0]);
+    return (bytes + PAGINA_TRAZA - 1) / PAGINA_TRAZA * PAGINA_TRAZA;
+}
+
+typedef struct {
+    int fd;
+    int activa;
+    int cerrada;
+    off_t reservado;           // Bytes ya asignados a bloques
+    off_t tamano;              // Tamaño actual del archivo
+    uint64_t secuencia;
+    pthread_mutex_t mutex;
+} ArchivoTraza;
+
+static ArchivoTraza traza = { .fd = -1, .mutex = PTHREAD_MUTEX_INITIALIZER };
+static __thread RegistroTraza* bloque_traza = NULL;
+static __thread int libres_traza = 0;
+
+// Crear el archivo con su cabecera; los agentes aún no corren
+void abrir_traza(const char* ruta, const CabeceraTraza* cabecera) {
+    traza.fd = open(ruta, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (traza.fd < 0 || ftruncate(traza.fd, cabecera->tam_cabecera) != 0 ||
+        pwrite(traza.fd, cabecera, cabecera->tam_cabecera, 0) != (ssize_t)cabecera->tam_cabecera) {
+        fprintf(stderr, "No se pudo crear la traza '%s'\n", ruta);
+        exit(1);
+    }
+    traza.reservado = traza.tamano = cabecera->tam_cabecera;
+    traza.activa = 1;
+}
+
+// Asignar al hilo el próximo bloque libre del archivo (NULL si la traza se cerró)
+static RegistroTraza* reservar_bloque_traza(void) {
+    const off_t tam_bloque = REGISTROS_BLOQUE_TRAZA * sizeof(RegistroTraza);
+    
+    pthread_mutex_lock(&traza.mutex);
+    if (traza.cerrada) {
+        pthread_mutex_unlock(&traza.mutex);
+        return NULL;
+    }
+    off_t desplazamiento = traza.reservado;
+    if (desplazamiento + tam_bloque > traza.tamano) {
+        if (ftruncate(traza.fd, traza.tamano + CRECIMIENTO_TRAZA) != 0) {
+            fprintf(stderr, "Sin espacio para la traza: se deja de registrar\n");
+            traza.cerrada = 1;
+            pthread_mutex_unlock(&traza.mutex);
+            return NULL;
+        }
+        traza.tamano += CRECIMIENTO_TRAZA;
+    }
+    traza.reservado += tam_bloque;
+    pthread_mutex_unlock(&traza.mutex);
+    
+    void* bloque = mmap(NULL, tam_bloque, PROT_READ | PROT_WRITE, MAP_SHARED, traza.fd, desplazamiento);
+    return (bloque == MAP_FAILED) ? NULL : bloque;
+}
+
+static void registrar_traza(EventoTraza evento, const Paciente* paciente, int personal, int cola) {
+    if (libres_traza == 0) {
+        if (bloque_traza) munmap(bloque_traza - REGISTROS_BLOQUE_TRAZA,
+                                 REGISTROS_BLOQUE_TRAZA * sizeof(RegistroTraza));
+        bloque_traza = reservar_bloque_traza();
+        if (!bloque_traza) return;
+        libres_traza = REGISTROS_BLOQUE_TRAZA;
+    }
+    
+    RegistroTraza* registro = bloque_traza++;
+    libres_traza--;
+    registro->secuencia = __atomic_fetch_add(&traza.secuencia, 1, __ATOMIC_RELAXED) + 1;
+    registro->tiempo = tiempo_simulado();
+    registro->paciente = paciente->id;
+    registro->personal = personal;
+    registro->cola = cola;
+    registro->prioridad = paciente->prioridad;
+    registro->tipo_atencion = paciente->tipo_atencion;
+    registro->evento = evento;
+}
+
+// Punto de registro en los caminos calientes: sin --traza cuesta una comparación
+static inline void trazar(EventoTraza evento, const Paciente* paciente, int personal, int cola) {
+    if (__builtin_expect(traza.activa, 0)) registrar_traza(evento, paciente, personal, cola);
+}
+
+// Dejar el archivo del tamaño de los bloques asignados. Los hilos que sigan
+// escribiendo lo hacen dentro de sus bloques, que ya están en el archivo
+void cerrar_traza(void) {
+    if (!traza.activa) return;
+    pthread_mutex_lock(&traza.mutex);
+    traza.cerrada = 1;
+    if (ftruncate(traza.fd, traza.reservado) != 0) {
+        fprintf(stderr, "No se pudo ajustar el tamaño de la traza\n");
+    }
+    pthread_mutex_unlock(&traza.mutex);
+    printf("🧾 Traza: %llu eventos\n", (unsigned long long)traza.secuencia);
+}
+
+// Funciones de la arena de pacientes
+// Requiere tener tomado arena->mutex
+static int agregar_bloque_arena(ArenaPacientes *arena) {
+    if (arena->num_bloques == MAX_BLOQUES_ARENA) return 0;
+    
+    uint32_t b = arena->num_bloques;
+    Paciente* bloque = calloc(TAM_BLOQUE_ARENA, sizeof(Paciente));
+    uint32_t* enlaces = malloc(TAM_BLOQUE_ARENA * sizeof(uint32_t));
+    uint8_t* estados = calloc(TAM_BLOQUE_ARENA, sizeof(uint8_t));  // PACIENTE_LIBRE
+    if (!bloque || !enlaces || !estados) {
+        free(bloque);
+        free(enlaces);
+        free(estados);
+        return 0;
+    }
+    
+    uint32_t base = b * TAM_BLOQUE_ARENA;
+    for (uint32_t i = 0; i < TAM_BLOQUE_ARENA; i++) {
+        enlaces[i] = (i + 1 < TAM_BLOQUE_ARENA) ? base + i + 1 : arena->libre;
+    }
+    arena->bloques[b] = bloque;
+    arena->enlaces[b] = enlaces;
+    arena->estados[b] = estados;
+    arena->libre = base;
+    arena->num_bloques++;
+    return 1;
+}
+
+void init_arena(ArenaPacientes *arena, uint32_t capacidad_inicial) {
+    arena->num_bloques = 0;
+    arena->libre = HANDLE_NULO;
+    arena->en_uso = 0;
+    pthread_mutex_init(&arena->mutex, NULL);
+    
+    do {
+        if (!agregar_bloque_arena(arena)) {
+            fprintf(stderr, "Sin memoria para la arena de pacientes\n");
+            exit(1);
+        }
+    } while (arena->num_bloques * TAM_BLOQUE_ARENA < capacidad_inicial);
+}
+
+void destruir_arena(ArenaPacientes *arena) {
+    for (uint32_t b = 0; b < arena->num_bloques; b++) {
+        free(arena->bloques[b]);
+        free(arena->enlaces[b]);
+        free(arena->estados[b]);
+    }
+    arena->num_bloques = 0;
+    arena->libre = HANDLE_NULO;
+    pthread_mutex_destroy(&arena->mutex);
+}
+
+static inline Paciente* paciente_de(ArenaPacientes *arena, HandlePaciente handle) {
+    return &arena->bloques[handle / TAM_BLOQUE_ARENA][handle % TAM_BLOQUE_ARENA];
+}
+
+static inline uint32_t* enlace_de(ArenaPacientes *arena, HandlePaciente handle) {
+    return &arena->enlaces[handle / TAM_BLOQUE_ARENA][handle % TAM_BLOQUE_ARENA];
+}
+
+static inline EstadoPaciente estado_paciente(ArenaPacientes *arena, HandlePaciente handle) {
+    return arena->estados[handle / TAM_BLOQUE_ARENA][handle % TAM_BLOQUE_ARENA];
+}
+
+static inline void fijar_estado(ArenaPacientes *arena, HandlePaciente handle, EstadoPaciente estado) {
+    arena->estados[handle / TAM_BLOQUE_ARENA][handle % TAM_BLOQUE_ARENA] = estado;
+}
+
+// Reservar un slot limpio, creciendo la arena si hace falta
+// Devuelve HANDLE_NULO solo si se agotó la memoria
+HandlePaciente reservar_paciente(ArenaPacientes *arena) {
+    pthread_mutex_lock(&arena->mutex);
+    if (arena->libre == HANDLE_NULO) {
+        agregar_bloque_arena(arena);
+    }
+    HandlePaciente handle = arena->libre;
+    if (handle != HANDLE_NULO) {
+        arena->libre = *enlace_de(arena, handle);
+        arena->en_uso++;
+    }
+    pthread_mutex_unlock(&arena->mutex);
+    
+    if (handle != HANDLE_NULO) {
+        memset(paciente_de(arena, handle), 0, sizeof(Paciente));
+    }
+    return handle;
+}
+
+void liberar_paciente(ArenaPacientes *arena, HandlePaciente handle) {
+    fijar_estado(arena, handle, PACIENTE_LIBRE);
+    
+    pthread_mutex_lock(&arena->mutex);
+    *enlace_de(arena, handle) = arena->libre;
+    arena->libre = handle;
+    arena->en_uso--;
+    pthread_mutex_unlock(&arena->mutex);
+}
+
+// Funciones del pool de segmentos
+SegmentoCola* tomar_segmento(PoolSegmentos *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    SegmentoCola* segmento = pool->libres;
+    if (segmento) {
+        pool->libres = segmento->siguiente;
+    } else {
+        segmento = malloc(sizeof(SegmentoCola));
+        if (segmento) pool->segmentos_creados++;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    
+    if (!segmento) {
+        fprintf(stderr, "Sin memoria para segmentos de cola\n");
+        exit(1);
+    }
+    segmento->siguiente = NULL;
+    return segmento;
+}
+
+void devolver_segmento(PoolSegmentos *pool, SegmentoCola* segmento) {
+    pthread_mutex_lock(&pool->mutex);
+    segmento->siguiente = pool->libres;
+    pool->libres = segmento;
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void destruir_pool_segmentos(PoolSegmentos *pool) {
+    while (pool->libres) {
+        SegmentoCola* segmento = pool->libres;
+        pool->libres = segmento->siguiente;
+        free(segmento);
+    }
+    pthread_mutex_destroy(&pool->mutex);
+}
+
+// Funciones del contador de eventos
+void init_contador_eventos(ContadorEventos *ec) {
+    ec->epoca = 0;
+    ec->esperando = 0;
+#ifndef __linux__
+    pthread_mutex_init(&ec->mutex, NULL);
+    pthread_cond_init(&ec->cond, NULL);
+#endif
+}
+
+// Anunciarse como esperando y obtener la época; después de esto el llamador
+// vuelve a comprobar la condición y llama a ec_esperar() o ec_cancelar()
+static inline uint32_t ec_preparar(ContadorEventos *ec) {
+    __atomic_fetch_add(&ec->esperando, 1, __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&ec->epoca, __ATOMIC_SEQ_CST);
+}
+
+static inline void ec_cancelar(ContadorEventos *ec) {
+    __atomic_fetch_sub(&ec->esperando, 1, __ATOMIC_SEQ_CST);
+}
+
+// Dormir mientras la época no cambie
+static void ec_esperar(ContadorEventos *ec, uint32_t epoca) {
+#ifdef __linux__
+    syscall(SYS_futex, &ec->epoca, FUTEX_WAIT_PRIVATE, epoca, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&ec->mutex);
+    while (__atomic_load_n(&ec->epoca, __ATOMIC_SEQ_CST) == epoca) {
+        pthread_cond_wait(&ec->cond, &ec->mutex);
+    }
+    pthread_mutex_unlock(&ec->mutex);
+#endif
+    __atomic_fetch_sub(&ec->esperando, 1, __ATOMIC_SEQ_CST);
+}
+
+static void ec_despertar(ContadorEventos *ec, int cuantos) {
+#ifdef __linux__
+    __atomic_fetch_add(&ec->epoca, 1, __ATOMIC_SEQ_CST);
+    syscall(SYS_futex, &ec->epoca, FUTEX_WAKE_PRIVATE, cuantos, NULL, NULL, 0);
+#else
+    pthread_mutex_lock(&ec->mutex);
+    __atomic_fetch_add(&ec->epoca, 1, __ATOMIC_SEQ_CST);
+    if (cuantos == 1) pthread_cond_signal(&ec->cond);
+    else pthread_cond_broadcast(&ec->cond);
+    pthread_mutex_unlock(&ec->mutex);
+#endif
+}
+
+// Llamar después de publicar el cambio que esperan los consumidores
+static inline void ec_notificar(ContadorEventos *ec) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ec->esperando, __ATOMIC_SEQ_CST) > 0) {
+        ec_despertar(ec, 1);
+    }
+}
+
+// Lo mismo para k cambios publicados juntos: despierta hasta k esperadores
+static inline void ec_notificar_varios(ContadorEventos *ec, int cuantos) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ec->esperando, __ATOMIC_SEQ_CST) > 0) {
+        ec_despertar(ec, cuantos);
+    }
+}
+
+static inline void ec_notificar_todos(ContadorEventos *ec) {
+    ec_despertar(ec, INT_MAX);
+}
+
+// Despertar a todos, pero solo si hay alguien esperando (esperadores heterogéneos:
+// despertar a uno solo podría elegir a quien no puede aprovechar el cambio)
+static inline void ec_difundir(ContadorEventos *ec) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ec->esperando, __ATOMIC_SEQ_CST) > 0) {
+        ec_despertar(ec, INT_MAX);
+    }
+}
+
+// Funciones del anillo sin bloqueo
+AnilloMPMC* crear_anillo(uint64_t tamano) {
+    AnilloMPMC* anillo = calloc(1, sizeof(AnilloMPMC));
+    CeldaAnillo* celdas = malloc(tamano * sizeof(CeldaAnillo));
+    if (!anillo || !celdas) {
+        fprintf(stderr, "Sin memoria para el anillo de la cola\n");
+        exit(1);
+    }
+    for (uint64_t i = 0; i < tamano; i++) {
+        celdas[i].secuencia = i;
+    }
+    anillo->celdas = celdas;
+    anillo->mascara = tamano - 1;
+    return anillo;
+}
+
+// Devuelve 0 si el anillo está lleno
+static int anillo_insertar(AnilloMPMC* anillo, HandlePaciente handle) {
+    uint64_t pos = __atomic_load_n(&anillo->pos_insercion, __ATOMIC_RELAXED);
+    while (1) {
+        CeldaAnillo* celda = &anillo->celdas[pos & anillo->mascara];
+        uint64_t secuencia = __atomic_load_n(&celda->secuencia, __ATOMIC_ACQUIRE);
+        int64_t diferencia = (int64_t)secuencia - (int64_t)pos;
+        if (diferencia == 0) {
+            if (__atomic_compare_exchange_n(&anillo->pos_insercion, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                celda->handle = handle;
+                __atomic_store_n(&celda->secuencia, pos + 1, __ATOMIC_RELEASE);
+                return 1;
+            }
+        } else if (diferencia < 0) {
+            return 0;
+        } else {
+            pos = __atomic_load_n(&anillo->pos_insercion, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Devuelve HANDLE_NULO si el anillo está vacío
+static HandlePaciente anillo_extraer(AnilloMPMC* anillo) {
+    uint64_t pos = __atomic_load_n(&anillo->pos_extraccion, __ATOMIC_RELAXED);
+    while (1) {
+        CeldaAnillo* celda = &anillo->celdas[pos & anillo->mascara];
+        uint64_t secuencia = __atomic_load_n(&celda->secuencia, __ATOMIC_ACQUIRE);
+        int64_t diferencia = (int64_t)secuencia - (int64_t)(pos + 1);
+        if (diferencia == 0) {
+            if (__atomic_compare_exchange_n(&anillo->pos_extraccion, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                HandlePaciente handle = celda->handle;
+                __atomic_store_n(&celda->secuencia, pos + anillo->mascara + 1, __ATOMIC_RELEASE);
+                return handle;
+            }
+        } else if (diferencia < 0) {
+            return HANDLE_NULO;
+        } else {
+            pos = __atomic_load_n(&anillo->pos_extraccion, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+// Funciones de cola
+void init_cola(Cola *cola, PoolSegmentos *pool, ArenaPacientes *arena) {
+    memset(cola->niveles, 0, sizeof(cola->niveles));
+    cola->pool = pool;
+    cola->arena = arena;
+    cola->con_abandonos = 0;
+    cola->count = 0;
+    cola->max_count = 0;
+    cola->capacidad = 0;
+    cola->politica = POLITICA_RECHAZAR;
+    cola->desvio = NULL;
+    cola->esperando_espacio = 0;
+    cola->rechazados = 0;
+    cola->bloqueos = 0;
+    cola->desviados = 0;
+    cola->insertados = 0;
+    pthread_mutex_init(&cola->mutex, NULL);
+    pthread_cond_init(&cola->cond, NULL);
+    pthread_cond_init(&cola->cond_espacio, NULL);
+#if INSTRUMENTAR_MUTEX
+    memset(&cola->medicion, 0, sizeof(cola->medicion));
+#endif
+    cola->anillo = NULL;
+    init_contador_eventos(&cola->hay_pacientes);
+    init_contador_eventos(&cola->hay_espacio);
+    cola->aviso = NULL;
+}
+
+// Pasar una cola FIFO (sin prioridades) al anillo sin bloqueo; debe
+// llamarse antes de que la usen otros hilos
+void activar_anillo_cola(Cola *cola, uint64_t tamano) {
+    cola->anillo = crear_anillo(tamano);
+}
+
+// Devolver los segmentos al pool y liberar el anillo; los pacientes que
+// quedaban se descartan junto con la arena
+void destruir_cola(Cola *cola) {
+    for (int i = 0; i < NUM_PRIORIDADES; i++) {
+        SegmentoCola* segmento = cola->niveles[i].primero;
+        while (segmento) {
+            SegmentoCola* siguiente = segmento->siguiente;
+            devolver_segmento(cola->pool, segmento);
+            segmento = siguiente;
+        }
+    }
+    memset(cola->niveles, 0, sizeof(cola->niveles));
+    cola->count = 0;
+    if (cola->anillo) {
+        free(cola->anillo->celdas);
+        free(cola->anillo);
+        cola->anillo = NULL;
+    }
+    pthread_mutex_destroy(&cola->mutex);
+    pthread_cond_destroy(&cola->cond);
+    pthread_cond_destroy(&cola->cond_espacio);
+}
+
+// Despertar a todos los hilos bloqueados en la cola (fin de la simulación)
+void despertar_cola(Cola *cola) {
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    pthread_cond_broadcast(&cola->cond);
+    pthread_cond_broadcast(&cola->cond_espacio);
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    ec_notificar_todos(&cola->hay_pacientes);
+    ec_notificar_todos(&cola->hay_espacio);
+}
+
+// Activar el modo acotado: capacidad 0 deja la cola sin límite
+void configurar_limite_cola(Cola *cola, int capacidad, PoliticaDesborde politica, Cola *desvio) {
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    cola->capacidad = capacidad;
+    cola->politica = politica;
+    cola->desvio = desvio;
+    soltar_mutex(&cola->mutex, &cola->medicion);
+}
+
+static void mn_aviso_insercion(Cola* cola, int cuantos);
+
+static inline void avisar_insercion(Cola *cola, int cuantos) {
+    if (cola->aviso) ec_difundir(cola->aviso);
+    if (modo_agentes_mn) mn_aviso_insercion(cola, cuantos);
+}
+
+// Nivel de la cola que corresponde a una prioridad (1 = nivel 0)
+static int nivel_de_prioridad(int prioridad) {
+    if (prioridad < 1) return 0;
+    if (prioridad > NUM_PRIORIDADES) return NUM_PRIORIDADES - 1;
+    return prioridad - 1;
+}
+
+// Operaciones internas: requieren tener tomado cola->mutex
+static void insertar_en_nivel(Cola *cola, int nivel, HandlePaciente handle) {
+    NivelPrioridad *n = &cola->niveles[nivel];
+    if (!n->ultimo) {
+        n->primero = n->ultimo = tomar_segmento(cola->pool);
+        n->frente = n->final = 0;
+    } else if (n->final == TAM_SEGMENTO_COLA) {
+        SegmentoCola* nuevo = tomar_segmento(cola->pool);
+        n->ultimo->siguiente = nuevo;
+        n->ultimo = nuevo;
+        n->final = 0;
+    }
+    // Los datos de la espera quedan en las columnas del segmento, junto al handle
+    Paciente* paciente = paciente_de(cola->arena, handle);
+    SegmentoCola* segmento = n->ultimo;
+    segmento->handles[n->final] = handle;
+    segmento->espera_desde[n->final] = paciente->clasificado ? paciente->tiempo_clasificacion
+                                                            : paciente->tiempo_llegada;
+    segmento->plazo[n->final] = paciente->plazo_abandono;
+    paciente->ranura_espera = &segmento->espera_desde[n->final];
+    n->final++;
+    n->count++;
+    cola->count++;
+    __atomic_fetch_add(&cola->insertados, 1, __ATOMIC_RELAXED);  // El gestor lo lee sin el lock
+    trazar(TRAZA_ENCOLADO, paciente, -1, cola->indice);
+    if (cola->con_abandonos) __atomic_store_n(&paciente->cola_espera, cola, __ATOMIC_RELEASE);
+    if (cola->count > cola->max_count) cola->max_count = cola->count;
+}
+
+static HandlePaciente extraer_primero(Cola *cola) {
+    for (int i = 0; i < NUM_PRIORIDADES; i++) {
+        NivelPrioridad *n = &cola->niveles[i];
+        while (n->count > 0) {
+            HandlePaciente handle = n->primero->handles[n->frente++];
+            n->count--;
+            
+            if (n->count == 0) {
+                // Nivel vacío: conservar un segmento para no ir al pool en cada inserción
+                while (n->primero != n->ultimo) {
+                    SegmentoCola* usado = n->primero;
+                    n->primero = usado->siguiente;
+                    devolver_segmento(cola->pool, usado);
+                }
+                n->frente = n->final = 0;
+            } else if (n->frente == TAM_SEGMENTO_COLA) {
+                SegmentoCola* usado = n->primero;
+                n->primero = usado->siguiente;
+                n->frente = 0;
+                devolver_segmento(cola->pool, usado);
+            }
+            
+            if (cola->con_abandonos) {
+                if (estado_paciente(cola->arena, handle) == PACIENTE_ABANDONO) {
+                    // Lápida: el paciente ya se fue y su slot se libera recién ahora
+                    liberar_paciente(cola->arena, handle);
+                    continue;
+                }
+                __atomic_store_n(&paciente_de(cola->arena, handle)->cola_espera, NULL, __ATOMIC_RELAXED);
+            }
+            
+            trazar(TRAZA_DESENCOLADO, paciente_de(cola->arena, handle), -1, cola->indice);
+            cola->count--;
+            if (cola->esperando_espacio > 0) {
+                pthread_cond_signal(&cola->cond_espacio);
+            }
+            return handle;
+        }
+    }
+    return HANDLE_NULO;
+}
+
+// Retirar a un paciente que abandonó sin esperar a que llegue al frente y
+// copiarlo en 'copia' (su slot puede reciclarse apenas se suelta el mutex);
+// devuelve 0 si ya no estaba en la cola (lo tomó un médico)
+int retirar_de_cola(Cola *cola, HandlePaciente handle, int id_paciente, Paciente *copia) {
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    Paciente* paciente = paciente_de(cola->arena, handle);
+    int sigue = paciente->cola_espera == cola && paciente->id == id_paciente;
+    if (sigue) {
+        *copia = *paciente;
+        fijar_estado(cola->arena, handle, PACIENTE_ABANDONO);
+        *paciente->ranura_espera = ESPERA_LAPIDA;
+        paciente->abandono = 1;
+        __atomic_store_n(&paciente->cola_espera, NULL, __ATOMIC_RELAXED);
+        cola->count--;
+        if (cola->esperando_espacio > 0) {
+            pthread_cond_signal(&cola->cond_espacio);
+        }
+    }
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    return sigue;
+}
+
+static ResultadoEncolado insertar_desviado(Cola *desvio, int nivel, HandlePaciente handle);
+
+// Operaciones del modo sin bloqueo. 'count' se reserva antes de publicar en el
+// anillo y se libera después de vaciar la celda, así que count < tamaño garantiza
+// que hay una celda libre para el productor que hizo la reserva
+static HandlePaciente extraer_anillo(Cola *cola) {
+    HandlePaciente handle = anillo_extraer(cola->anillo);
+    if (handle != HANDLE_NULO) {
+        trazar(TRAZA_DESENCOLADO, paciente_de(cola->arena, handle), -1, cola->indice);
+        __atomic_fetch_sub(&cola->count, 1, __ATOMIC_SEQ_CST);
+        ec_notificar(&cola->hay_espacio);
+    }
+    return handle;
+}
+
+// Con 'sin_desborde' una cola llena rechaza siempre (se usa al recibir un desvío)
+static ResultadoEncolado encolar_anillo(Cola *cola, HandlePaciente handle, int puede_bloquear,
+                                        int sin_desborde) {
+    int limite = (int)(cola->anillo->mascara + 1);
+    if (cola->capacidad > 0 && cola->capacidad < limite) limite = cola->capacidad;
+    int bloqueo_contado = 0;
+    
+    while (1) {
+        int ocupadas = __atomic_fetch_add(&cola->count, 1, __ATOMIC_SEQ_CST);
+        if (ocupadas < limite) {
+            int maximo = __atomic_load_n(&cola->max_count, __ATOMIC_RELAXED);
+            while (ocupadas + 1 > maximo &&
+                   !__atomic_compare_exchange_n(&cola->max_count, &maximo, ocupadas + 1, 1,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            }
+            __atomic_fetch_add(&cola->insertados, 1, __ATOMIC_RELAXED);
+            break;
+        }
+        __atomic_fetch_sub(&cola->count, 1, __ATOMIC_SEQ_CST);
+        
+        // Anillo lleno: sin capacidad configurada se espera (el anillo es el límite físico)
+        PoliticaDesborde politica = (cola->capacidad > 0) ? cola->politica : POLITICA_BLOQUEAR;
+        if (sin_desborde || politica == POLITICA_RECHAZAR ||
+            (politica == POLITICA_DESVIAR && (!cola->desvio || cola->desvio == cola))) {
+            __atomic_fetch_add(&cola->rechazados, 1, __ATOMIC_RELAXED);
+            return RECHAZADO;
+        }
+        if (politica == POLITICA_DESVIAR) {
+            __atomic_fetch_add(&cola->desviados, 1, __ATOMIC_RELAXED);
+            return insertar_desviado(cola->desvio, NUM_PRIORIDADES - 1, handle);
+        }
+        
+        if (!bloqueo_contado) {
+            __atomic_fetch_add(&cola->bloqueos, 1, __ATOMIC_RELAXED);
+            bloqueo_contado = 1;
+        }
+        if (!puede_bloquear) return COLA_LLENA;
+        
+        uint32_t epoca = ec_preparar(&cola->hay_espacio);
+        if (!simulacion_activa) {
+            ec_cancelar(&cola->hay_espacio);
+            __atomic_fetch_add(&cola->rechazados, 1, __ATOMIC_RELAXED);
+            return RECHAZADO;
+        }
+        if (__atomic_load_n(&cola->count, __ATOMIC_SEQ_CST) < limite) {
+            ec_cancelar(&cola->hay_espacio);
+            continue;
+        }
+        ec_esperar(&cola->hay_espacio, epoca);
+    }
+    
+    // Antes de publicarlo: después otro hilo puede extraerlo y reciclar su slot
+    trazar(TRAZA_ENCOLADO, paciente_de(cola->arena, handle), -1, cola->indice);
+    
+    // La reserva garantiza espacio; solo puede fallar un instante mientras
+    // un consumidor termina de liberar su celda
+    while (!anillo_insertar(cola->anillo, handle)) {
+        sched_yield();
+    }
+    ec_notificar(&cola->hay_pacientes);
+    avisar_insercion(cola, 1);
+    return ENCOLADO;
+}
+
+// Insertar en la cola de desvío: el destino aplica su capacidad pero no vuelve a desviar
+static ResultadoEncolado insertar_desviado(Cola *desvio, int nivel, HandlePaciente handle) {
+    if (desvio->anillo) {
+        return (encolar_anillo(desvio, handle, 0, 1) == ENCOLADO) ? DESVIADO : RECHAZADO;
+    }
+    
+    tomar_mutex(&desvio->mutex, &desvio->medicion);
+    if (desvio->capacidad > 0 && desvio->count >= desvio->capacidad) {
+        desvio->rechazados++;
+        soltar_mutex(&desvio->mutex, &desvio->medicion);
+        return RECHAZADO;
+    }
+    insertar_en_nivel(desvio, nivel, handle);
+    pthread_cond_signal(&desvio->cond);
+    soltar_mutex(&desvio->mutex, &desvio->medicion);
+    avisar_insercion(desvio, 1);
+    return DESVIADO;
+}
+
+// 'adelantados' (opcional) recibe cuántos pacientes de menor prioridad quedan detrás
+static ResultadoEncolado encolar(Cola *cola, int nivel, HandlePaciente handle, int puede_bloquear,
+                                 int *adelantados) {
+    if (cola->anillo) {
+        // El anillo es FIFO puro: la prioridad no reordena
+        if (adelantados) *adelantados = 0;
+        return encolar_anillo(cola, handle, puede_bloquear, 0);
+    }
+    
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    
+    if (cola->capacidad > 0 && cola->count >= cola->capacidad) {
+        switch (cola->politica) {
+            case POLITICA_BLOQUEAR:
+                cola->bloqueos++;
+                if (!puede_bloquear) {
+                    soltar_mutex(&cola->mutex, &cola->medicion);
+                    return COLA_LLENA;
+                }
+                cola->esperando_espacio++;
+                ESPERAR_MIENTRAS(cola->count >= cola->capacidad && simulacion_activa, &cola->cond_espacio, &cola->mutex, &cola->medicion);
+                cola->esperando_espacio--;
+                if (cola->count >= cola->capacidad) {
+                    cola->rechazados++;
+                    soltar_mutex(&cola->mutex, &cola->medicion);
+                    return RECHAZADO;
+                }
+                break;
+            case POLITICA_DESVIAR:
+                if (cola->desvio && cola->desvio != cola) {
+                    Cola* desvio = cola->desvio;
+                    cola->desviados++;
+                    soltar_mutex(&cola->mutex, &cola->medicion);
+                    return insertar_desviado(desvio, nivel, handle);
+                }
+                // Sin cola de desvío: se rechaza
+                cola->rechazados++;
+                soltar_mutex(&cola->mutex, &cola->medicion);
+                return RECHAZADO;
+            case POLITICA_RECHAZAR:
+            default:
+                cola->rechazados++;
+                soltar_mutex(&cola->mutex, &cola->medicion);
+                return RECHAZADO;
+        }
+    }
+    
+    if (adelantados) {
+        *adelantados = 0;
+        for (int i = nivel + 1; i < NUM_PRIORIDADES; i++) {
+            *adelantados += cola->niveles[i].count;
+        }
+    }
+    
+    insertar_en_nivel(cola, nivel, handle);
+    pthread_cond_signal(&cola->cond);
+    
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    avisar_insercion(cola, 1);
+    return ENCOLADO;
+}
+
+// Insertar al final de la cola (sin prioridad: detrás de todos los niveles)
+// En modo acotado aplica la política de desborde de la cola; en modo eventos
+// discretos y con agentes M:N nunca bloquea y devuelve COLA_LLENA para que el
+// llamador espere
+static int encolado_puede_bloquear(void) {
+    return !modo_eventos_discretos && !modo_agentes_mn;
+}
+
+ResultadoEncolado enqueue(Cola *cola, HandlePaciente handle) {
+    return encolar(cola, NUM_PRIORIDADES - 1, handle, encolado_puede_bloquear(), NULL);
+}
+
+// Extraer bloqueando; devuelve HANDLE_NULO si la simulación terminó
+HandlePaciente dequeue(Cola *cola) {
+    if (cola->anillo) {
+        while (1) {
+            HandlePaciente handle = extraer_anillo(cola);
+            if (handle != HANDLE_NULO || !simulacion_activa) return handle;
+            
+            uint32_t epoca = ec_preparar(&cola->hay_pacientes);
+            handle = extraer_anillo(cola);
+            if (handle != HANDLE_NULO || !simulacion_activa) {
+                ec_cancelar(&cola->hay_pacientes);
+                return handle;
+            }
+            ec_esperar(&cola->hay_pacientes, epoca);
+        }
+    }
+    
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    
+    ESPERAR_MIENTRAS(cola->count == 0 && simulacion_activa, &cola->cond, &cola->mutex, &cola->medicion);
+    
+    HandlePaciente handle = HANDLE_NULO;
+    if (cola->count > 0) {
+        handle = extraer_primero(cola);
+    }
+    
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    return handle;
+}
+
+// Extraer sin bloquear: devuelve HANDLE_NULO si la cola estaba vacía
+HandlePaciente intentar_dequeue(Cola *cola) {
+    if (cola->anillo) return extraer_anillo(cola);
+    
+    tomar_mutex(&cola->mutex, &cola->medicion);
+
+    HandlePaciente handle = HANDLE_NULO;
+    if (cola->count > 0) {
+        handle = extraer_primero(cola);
+    }
+
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    return handle;
+}
+
+// Insertar con prioridad (prioridad más baja = número menor)
+// Mismas reglas de desborde que enqueue()
+ResultadoEncolado enqueue_prioridad(Cola *cola, HandlePaciente handle) {
+    // Copiar los datos antes de insertar: tras soltar el mutex otro hilo puede
+    // extraer al paciente y reciclar su slot
+    const Paciente *paciente = paciente_de(cola->arena, handle);
+    int id = paciente->id;
+    int prioridad = paciente->prioridad;
+    int nivel = nivel_de_prioridad(prioridad);
+    int adelantados = 0;
+    
+    ResultadoEncolado resultado = encolar(cola, nivel, handle, encolado_puede_bloquear(),
+                                          log_habilitado(NIVEL_DEBUG) ? &adelantados : NULL);
+    
+    if (resultado == ENCOLADO && adelantados > 0) {
+        LOG(NIVEL_DEBUG, "🔄 Paciente %d insertado con prioridad %d, %d pacientes reordenados\n", 
+            id, prioridad, adelantados);
+    }
+    return resultado;
+}
+
+// Operaciones por lotes: el lote entero se inserta o extrae con una sola
+// toma del mutex (en el anillo, con una sola reserva de 'count') y un solo
+// aviso, en lugar de un ciclo lock/signal/unlock por paciente.
+// Despertares: insertar k pacientes despierta a lo sumo a k consumidores
+// bloqueados en la cola (k pthread_cond_signal con el mutex tomado, o un
+// único FUTEX_WAKE de k en el anillo) y difunde una sola vez el aviso de la
+// cola ('aviso': admins o médicos de varias colas), después de soltar el
+// mutex. Extraer k pacientes despierta a lo sumo a k productores que esperan
+// espacio. Un productor que debe bloquearse a mitad del lote primero avisa
+// lo que ya insertó, para que los consumidores puedan liberar lugar.
+// Cada paciente del lote recibe su propio resultado, con las mismas reglas
+// de desborde que enqueue(); tras el primer COLA_LLENA el resto del lote
+// también queda COLA_LLENA (en manos del llamador, que conserva el orden)
+
+static void avisar_lote(Cola *cola, int insertados) {
+    for (int i = 0; i < insertados; i++) {
+        pthread_cond_signal(&cola->cond);
+    }
+}
+
+static int encolar_anillo_varios(Cola *cola, const HandlePaciente *handles, int n, int puede_bloquear,
+                                 ResultadoEncolado *resultados) {
+    int limite = (int)(cola->anillo->mascara + 1);
+    if (cola->capacidad > 0 && cola->capacidad < limite) limite = cola->capacidad;
+    
+    // Una sola reserva para todo el lote; lo que no entra se devuelve
+    int ocupadas = __atomic_fetch_add(&cola->count, n, __ATOMIC_SEQ_CST);
+    int concedidas = limite - ocupadas;
+    if (concedidas < 0) concedidas = 0;
+    if (concedidas > n) concedidas = n;
+    if (concedidas < n) __atomic_fetch_sub(&cola->count, n - concedidas, __ATOMIC_SEQ_CST);
+    
+    if (concedidas > 0) {
+        int maximo = __atomic_load_n(&cola->max_count, __ATOMIC_RELAXED);
+        while (ocupadas + concedidas > maximo &&
+               !__atomic_compare_exchange_n(&cola->max_count, &maximo, ocupadas + concedidas, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        }
+        __atomic_fetch_add(&cola->insertados, concedidas, __ATOMIC_RELAXED);
+        for (int i = 0; i < concedidas; i++) {
+            trazar(TRAZA_ENCOLADO, paciente_de(cola->arena, handles[i]), -1, cola->indice);
+            while (!anillo_insertar(cola->anillo, handles[i])) {
+                sched_yield();
+            }
+            resultados[i] = ENCOLADO;
+        }
+        ec_notificar_varios(&cola->hay_pacientes, concedidas);
+        avisar_insercion(cola, concedidas);
+    }
+    
+    // El resto, de a uno con la política de desborde de la cola
+    int aceptados = concedidas;
+    for (int i = concedidas; i < n; i++) {
+        if (i > concedidas && resultados[i - 1] == COLA_LLENA) {
+            resultados[i] = COLA_LLENA;
+            continue;
+        }
+        resultados[i] = encolar_anillo(cola, handles[i], puede_bloquear, 0);
+        if (resultados[i] == ENCOLADO || resultados[i] == DESVIADO) aceptados++;
+    }
+    return aceptados;
+}
+
+// 'niveles' NULL: todos al último nivel (FIFO detrás de las prioridades)
+static int encolar_varios(Cola *cola, const int *niveles, const HandlePaciente *handles, int n,
+                          int puede_bloquear, ResultadoEncolado *resultados) {
+    if (n <= 0) return 0;
+    if (cola->anillo) return encolar_anillo_varios(cola, handles, n, puede_bloquear, resultados);
+    
+    int aceptados = 0, sin_avisar = 0, desviar = 0;
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    for (int i = 0; i < n; i++) {
+        int nivel = niveles ? niveles[i] : NUM_PRIORIDADES - 1;
+        if (cola->capacidad > 0 && cola->count >= cola->capacidad) {
+            if (cola->politica == POLITICA_DESVIAR && cola->desvio && cola->desvio != cola) {
+                // Se inserta en el desvío después de soltar este mutex
+                cola->desviados++;
+                resultados[i] = DESVIADO;
+                desviar = 1;
+                continue;
+            }
+            if (cola->politica != POLITICA_BLOQUEAR) {
+                cola->rechazados++;
+                resultados[i] = RECHAZADO;
+                continue;
+            }
+            
+            cola->bloqueos++;
+            if (!puede_bloquear) {
+                for (int j = i; j < n; j++) resultados[j] = COLA_LLENA;
+                break;
+            }
+            // Los ya insertados se avisan antes de esperar y, como al final
+            // del lote, con el mutex suelto (la espera vuelve a mirar el lugar)
+            avisar_lote(cola, sin_avisar);
+            if (sin_avisar > 0) {
+                soltar_mutex(&cola->mutex, &cola->medicion);
+                avisar_insercion(cola, sin_avisar);
+                tomar_mutex(&cola->mutex, &cola->medicion);
+                sin_avisar = 0;
+            }
+            cola->esperando_espacio++;
+            ESPERAR_MIENTRAS(cola->count >= cola->capacidad && simulacion_activa, &cola->cond_espacio, &cola->mutex, &cola->medicion);
+            cola->esperando_espacio--;
+            if (cola->count >= cola->capacidad) {
+                cola->rechazados++;
+                resultados[i] = RECHAZADO;
+                continue;
+            }
+        }
+        insertar_en_nivel(cola, nivel, handles[i]);
+        resultados[i] = ENCOLADO;
+        aceptados++;
+        sin_avisar++;
+    }
+    avisar_lote(cola, sin_avisar);
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    if (sin_avisar > 0) avisar_insercion(cola, sin_avisar);
+    
+    if (desviar) {
+        for (int i = 0; i < n; i++) {
+            if (resultados[i] != DESVIADO) continue;
+            int nivel = niveles ? niveles[i] : NUM_PRIORIDADES - 1;
+            resultados[i] = insertar_desviado(cola->desvio, nivel, handles[i]);
+            if (resultados[i] == DESVIADO) aceptados++;
+        }
+    }
+    return aceptados;
+}
+
+// Insertar varios pacientes al final de la cola, en orden; devuelve cuántos
+// quedaron en esta cola o en su desvío
+int enqueue_varios(Cola *cola, const HandlePaciente *handles, int n, ResultadoEncolado *resultados) {
+    return encolar_varios(cola, NULL, handles, n, encolado_puede_bloquear(), resultados);
+}
+
+// Insertar varios pacientes, cada uno en el nivel de su prioridad (entre
+// los de la misma prioridad conservan el orden del lote)
+int enqueue_prioridad_varios(Cola *cola, const HandlePaciente *handles, int n,
+                             ResultadoEncolado *resultados) {
+    // Los niveles se leen antes de insertar: después los pacientes ya son de la cola
+    int niveles[TAM_LOTE_COLA];
+    int aceptados = 0;
+    for (int desde = 0; desde < n; desde += TAM_LOTE_COLA) {
+        int cuantos = (n - desde < TAM_LOTE_COLA) ? n - desde : TAM_LOTE_COLA;
+        for (int i = 0; i < cuantos; i++) {
+            niveles[i] = nivel_de_prioridad(paciente_de(cola->arena, handles[desde + i])->prioridad);
+        }
+        aceptados += encolar_varios(cola, niveles, handles + desde, cuantos, encolado_puede_bloquear(),
+                                    resultados + desde);
+    }
+    return aceptados;
+}
+
+// Extraer hasta 'maximo' pacientes sin bloquear, en el orden de dequeue();
+// devuelve cuántos dejó en 'salida' (0 si la cola estaba vacía)
+int intentar_dequeue_varios(Cola *cola, HandlePaciente *salida, int maximo) {
+    int n = 0;
+    if (cola->anillo) {
+        while (n < maximo) {
+            HandlePaciente handle = anillo_extraer(cola->anillo);
+            if (handle == HANDLE_NULO) break;
+            trazar(TRAZA_DESENCOLADO, paciente_de(cola->arena, handle), -1, cola->indice);
+            salida[n++] = handle;
+        }
+        if (n > 0) {
+            __atomic_fetch_sub(&cola->count, n, __ATOMIC_SEQ_CST);
+            ec_notificar_varios(&cola->hay_espacio, n);
+        }
+        return n;
+    }
+    
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    while (n < maximo && cola->count > 0) {
+        salida[n++] = extraer_primero(cola);
+    }
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    return n;
+}
+
+// Extraer hasta 'maximo' pacientes bloqueando hasta que haya al menos uno;
+// devuelve 0 solo si la simulación terminó
+int dequeue_varios(Cola *cola, HandlePaciente *salida, int maximo) {
+    if (cola->anillo) {
+        while (1) {
+            int n = intentar_dequeue_varios(cola, salida, maximo);
+            if (n > 0 || !simulacion_activa) return n;
+            
+            uint32_t epoca = ec_preparar(&cola->hay_pacientes);
+            n = intentar_dequeue_varios(cola, salida, maximo);
+            if (n > 0 || !simulacion_activa) {
+                ec_cancelar(&cola->hay_pacientes);
+                return n;
+            }
+            ec_esperar(&cola->hay_pacientes, epoca);
+        }
+    }
+    
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    ESPERAR_MIENTRAS(cola->count == 0 && simulacion_activa, &cola->cond, &cola->mutex, &cola->medicion);
+    int n = 0;
+    while (n < maximo && cola->count > 0) {
+        salida[n++] = extraer_primero(cola);
+    }
+    soltar_mutex(&cola->mutex, &cola->medicion);
+    return n;
+}
+
+// Censo de las esperas de una cola (monitor y --benchmark): cuántos esperan
+// en cada nivel, la suma y el máximo de sus esperas y cuántos agotan la
+// paciencia antes de 'limite'. Se recorren las columnas de los segmentos,
+// así que el costo es proporcional a los que esperan y no toca la arena.
+// El anillo de recepción no tiene columnas: solo informa su largo
+typedef struct {
+    long esperando[NUM_PRIORIDADES];   // Por nivel (los desviados cuentan en el último)
+    long total;
+    long suma_espera;                  // Segundos
+    long espera_maxima;
+    long por_vencer;
+    int con_columnas;
+} CensoCola;
+
+// Los segmentos completos se recorren enteros con las lápidas como máscara:
+// sin saltos ni largo variable, el compilador vectoriza el bucle. Los de
+// los extremos de un nivel (a medio llenar o vaciar) van entrada por entrada
+static void censar_segmento(const SegmentoCola* segmento, int desde, int hasta, int32_t ahora,
+                            int32_t limite, long* esperando, CensoCola* censo) {
+    int32_t n = 0, suma = 0, maxima = 0, vencen = 0;  // 256 esperas de < 2^23 s no desbordan
+    if (desde == 0 && hasta == TAM_SEGMENTO_COLA) {
+        for (int i = 0; i < TAM_SEGMENTO_COLA; i++) {
+            int32_t vivo = (segmento->espera_desde[i] != ESPERA_LAPIDA);
+            int32_t espera = (ahora - segmento->espera_desde[i]) & -vivo;
+            n += vivo;
+            suma += espera;
+            maxima = (espera > maxima) ? espera : maxima;
+            vencen += vivo & (segmento->plazo[i] <= limite);
+        }
+    } else {
+        for (int i = desde; i < hasta; i++) {
+            if (segmento->espera_desde[i] == ESPERA_LAPIDA) continue;
+            int32_t espera = ahora - segmento->espera_desde[i];
+            n++;
+            suma += espera;
+            if (espera > maxima) maxima = espera;
+            vencen += (segmento->plazo[i] <= limite);
+        }
+    }
+    *esperando += n;
+    censo->total += n;
+    censo->suma_espera += suma;
+    if (maxima > censo->espera_maxima) censo->espera_maxima = maxima;
+    censo->por_vencer += vencen;
+}
+
+void censar_cola(Cola *cola, time_t ahora, time_t limite, CensoCola* censo) {
+    memset(censo, 0, sizeof(*censo));
+    if (cola->anillo) {
+        censo->total = __atomic_load_n(&cola->count, __ATOMIC_RELAXED);
+        return;
+    }
+    censo->con_columnas = 1;
+    if (limite >= PLAZO_NINGUNO) limite = PLAZO_NINGUNO - 1;
+    
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    for (int nivel = 0; nivel < NUM_PRIORIDADES; nivel++) {
+        NivelPrioridad *n = &cola->niveles[nivel];
+        if (n->count == 0) continue;
+        for (SegmentoCola* segmento = n->primero; ; segmento = segmento->siguiente) {
+            int desde = (segmento == n->primero) ? n->frente : 0;
+            int hasta = (segmento == n->ultimo) ? n->final : TAM_SEGMENTO_COLA;
+            censar_segmento(segmento, desde, hasta, ahora, limite, &censo->esperando[nivel], censo);
+            if (segmento == n->ultimo) break;
+        }
+    }
+    soltar_mutex(&cola->mutex, &cola->medicion);
+}
+
+// Las colas de la clínica actual en el orden de Cola.indice
+static void colas_clinica(Cola* colas[NUM_COLAS_CLINICA]) {
+    colas[0] = &clinica->cola_recepcion;
+    colas[1] = &clinica->cola_medico_general;
+    colas[2] = &clinica->cola_enfermeria;
+    for (int i = 0; i < 4; i++) colas[3 + i] = &clinica->cola_especialista[i];
+}
+
+// Funciones de la rueda de temporizadores
+void init_rueda(RuedaTemporizadores *rueda) {
+    memset(rueda->ranuras, 0, sizeof(rueda->ranuras));
+    rueda->ahora = 0;
+    rueda->pendientes = 0;
+    pthread_mutex_init(&rueda->mutex, NULL);
+}
+
+void destruir_rueda(RuedaTemporizadores *rueda) {
+    for (int nivel = 0; nivel < NIVELES_RUEDA; nivel++) {
+        for (int i = 0; i < RANURAS_RUEDA; i++) {
+            free(rueda->ranuras[nivel][i].entradas);
+        }
+    }
+    pthread_mutex_destroy(&rueda->mutex);
+}
+
+// Requiere tener tomado rueda->mutex
+static void colocar_en_rueda(RuedaTemporizadores *rueda, TemporizadorAbandono temporizador) {
+    // Un plazo ya vencido se atiende en el próximo segundo
+    if (temporizador.vencimiento <= rueda->ahora) temporizador.vencimiento = rueda->ahora + 1;
+    long delta = temporizador.vencimiento - rueda->ahora;
+    
+    // El nivel más bajo cuyo alcance (64^(nivel+1) segundos) cubre el plazo
+    int nivel = 0;
+    while (nivel < NIVELES_RUEDA - 1 && delta >= (1L << (BITS_RUEDA * (nivel + 1)))) {
+        nivel++;
+    }
+    int indice = (temporizador.vencimiento >> (BITS_RUEDA * nivel)) & (RANURAS_RUEDA - 1);
+    RanuraRueda *ranura = &rueda->ranuras[nivel][indice];
+    
+    if (ranura->count == ranura->capacidad) {
+        int nueva_capacidad = ranura->capacidad ? ranura->capacidad * 2 : 8;
+        TemporizadorAbandono* nuevas = realloc(ranura->entradas,
+                                               nueva_capacidad * sizeof(TemporizadorAbandono));
+        if (!nuevas) {
+            fprintf(stderr, "Sin memoria para la rueda de temporizadores\n");
+            exit(1);
+        }
+        ranura->entradas = nuevas;
+        ranura->capacidad = nueva_capacidad;
+    }
+    ranura->entradas[ranura->count++] = temporizador;
+}
+
+void programar_temporizador(RuedaTemporizadores *rueda, TemporizadorAbandono temporizador) {
+    pthread_mutex_lock(&rueda->mutex);
+    colocar_en_rueda(rueda, temporizador);
+    rueda->pendientes++;
+    pthread_mutex_unlock(&rueda->mutex);
+}
+
+// Bajar de nivel los temporizadores de una ranura cuyo bloque de tiempo empieza
+// ahora (requiere tener tomado rueda->mutex)
+static void cascada_rueda(RuedaTemporizadores *rueda, int nivel, int indice) {
+    RanuraRueda ranura = rueda->ranuras[nivel][indice];
+    rueda->ranuras[nivel][indice].count = 0;
+    for (int i = 0; i < ranura.count; i++) {
+        colocar_en_rueda(rueda, ranura.entradas[i]);
+    }
+}
+
+// Avanzar la rueda segundo a segundo hasta 'hasta', llamando a 'al_vencer' (sin
+// el mutex tomado) por cada temporizador vencido; devuelve cuántos vencieron
+int avanzar_rueda(RuedaTemporizadores *rueda, long hasta,
+                  void (*al_vencer)(const TemporizadorAbandono*)) {
+    int vencidos = 0;
+    
+    pthread_mutex_lock(&rueda->mutex);
+    while (rueda->ahora < hasta) {
+        // Sin temporizadores no hay nada que revisar: saltar directo al final
+        if (rueda->pendientes == 0) {
+            rueda->ahora = hasta;
+            break;
+        }
+        long t = ++rueda->ahora;
+        
+        for (int nivel = 1; nivel < NIVELES_RUEDA; nivel++) {
+            if (t & ((1L << (BITS_RUEDA * nivel)) - 1)) break;
+            cascada_rueda(rueda, nivel, (t >> (BITS_RUEDA * nivel)) & (RANURAS_RUEDA - 1));
+        }
+        
+        RanuraRueda *actual = &rueda->ranuras[0][t & (RANURAS_RUEDA - 1)];
+        if (actual->count == 0) continue;
+        
+        // Sacar la ranura entera para procesarla sin el mutex
+        RanuraRueda ranura = *actual;
+        actual->entradas = NULL;
+        actual->count = actual->capacidad = 0;
+        rueda->pendientes -= ranura.count;
+        pthread_mutex_unlock(&rueda->mutex);
+        
+        for (int i = 0; i < ranura.count; i++) {
+            al_vencer(&ranura.entradas[i]);
+        }
+        vencidos += ranura.count;
+        free(ranura.entradas);
+        
+        pthread_mutex_lock(&rueda->mutex);
+    }
+    pthread_mutex_unlock(&rueda->mutex);
+    return vencidos;
+}
+
+// Paciencia del paciente una vez clasificado, en segundos; 0 = espera lo que
+// haga falta. Conserva la escalera del modelo original: un 15% se va entre los
+// 10 y 15 minutos, otro 10% entre los 15 y 20 y otro 15% entre los 20 y 25.
+long paciencia_paciente(void) {
+    int sorteo = aleatorio() % 100;
+    int extra = aleatorio() % 300;
+    if (sorteo < 15) return 600 + extra;
+    if (sorteo < 25) return 900 + extra;
+    if (sorteo < 40) return 1200 + extra;
+    return 0;
+}
+
+// Tiempos aleatorios del modelo (en segundos de simulación, al menos 1)
+static int segundos_redondeados(double segundos) {
+    return (segundos < 1.0) ? 1 : (int)(segundos + 0.5);
+}
+
+int intervalo_llegada(void) {
+    return segundos_redondeados(aleatorio_exponencial(25.0)); // Llegadas de Poisson, media 25 s
+}
+
+// Medias del modelo; el gestor de personal las usa para dimensionar la dotación
+#define MEDIA_CLASIFICACION 120.0
+#define MEDIA_ATENCION 600.0
+#define MEDIA_PAUSA 90.0
+
+int duracion_clasificacion(void) {
+    return segundos_redondeados(aleatorio_lognormal(MEDIA_CLASIFICACION, 0.35)); // Casi siempre 1-3 min
+}
+
+int duracion_atencion(void) {
+    return segundos_redondeados(aleatorio_lognormal(MEDIA_ATENCION, 0.2)); // Casi siempre 7-14 min
+}
+
+int duracion_pausa(void) {
+    return aleatorio() % 61 + 60; // 60-120 segundos (1-2 min), media MEDIA_PAUSA
+}
+
+const char* nombre_tipo_atencion(TipoAtencion tipo) {
+    return (tipo == ATENCION_GENERAL) ? "General" :
+           (tipo == ATENCION_ENFERMERIA) ? "Enfermería" : "Especialidad";
+}
+
+const char* nombre_destino(TipoAtencion tipo) {
+    return (tipo == ATENCION_GENERAL) ? "Médico General" :
+           (tipo == ATENCION_ENFERMERIA) ? "Enfermería" : "Especialista";
+}
+
+// ============================================================
+// Llegadas desde un registro real (--llegadas ARCHIVO)
+// ------------------------------------------------------------
+// Una línea por llegada: hora,tipo,especialidad,prioridad. La hora va en
+// segundos o como H:MM[:SS]; el tipo como general/enfermeria/especialidad
+// (o 0-2) y la especialidad como cardiologia/neurologia/pediatria/
+// dermatologia (o 0-3), vacía si no corresponde. Se aceptan ',' o ';',
+// una cabecera y comentarios con '#'.
+//
+// El archivo se mapea una vez y cada clínica lo recorre con su propio
+// cursor sin copiarlo: las páginas ya leídas se devuelven de a
+// VENTANA_LLEGADAS, así que un registro de millones de filas se
+// reproduce con memoria constante. La primera llegada marca el inicio
+// de la jornada.
+// ============================================================
+
+#define VENTANA_LLEGADAS (16L << 20)
+
+typedef struct {
+    const char* datos;
+    size_t tamano;
+    long origen;               // Hora de la primera llegada válida
+    int activo;
+} RegistroLlegadas;
+
+static RegistroLlegadas registro_llegadas;
+
+// Próximo campo de la línea [p, fin): sin espacios ni comillas alrededor
+static const char* siguiente_campo(const char* p, const char* fin, const char** campo, size_t* largo) {
+    const char* inicio = p;
+    while (p < fin && *p != ',' && *p != ';') p++;
+    const char* final = p;
+    while (inicio < final && (*inicio == ' ' || *inicio == '\t' || *inicio == '"')) inicio++;
+    while (final > inicio && (final[-1] == ' ' || final[-1] == '\t' || final[-1] == '"' || final[-1] == '\r')) final--;
+    *campo = inicio;
+    *largo = final - inicio;
+    return (p < fin) ? p + 1 : p;
+}
+
+// Segundos, o H:MM[:SS]; -1 si no es una hora
+static long interpretar_hora(const char* campo, size_t largo) {
+    long total = 0, parte = 0;
+    int digitos = 0;
+    for (size_t i = 0; i < largo; i++) {
+        if (campo[i] >= '0' && campo[i] <= '9') {
+            parte = parte * 10 + (campo[i] - '0');
+            digitos++;
+        } else if (campo[i] == ':' && digitos > 0) {
+            total = (total + parte) * 60;
+            parte = 0;
+            digitos = 0;
+        } else {
+            return -1;
+        }
+    }
+    if (digitos == 0) return -1;
+    // "8:30" son horas y minutos: completar los segundos
+    int separadores = 0;
+    for (size_t i = 0; i < largo; i++) separadores += (campo[i] == ':');
+    total += parte;
+    return (separadores == 1) ? total * 60 : total;
+}
+
+// Índice de 'campo' en 'nombres' por sus primeras tres letras (o como dígito); -1 si no está
+static int interpretar_nombre(const char* campo, size_t largo, const char* const* nombres, int num_nombres) {
+    if (largo == 1 && campo[0] >= '0' && campo[0] < '0' + num_nombres) return campo[0] - '0';
+    if (largo < 3) return -1;
+    for (int i = 0; i < num_nombres; i++) {
+        if (strncasecmp(campo, nombres[i], 3) == 0) return i;
+    }
+    return -1;
+}
+
+// Interpretar una línea; 0 si no es una llegada válida
+static int interpretar_llegada(const char* linea, const char* fin, LlegadaRegistrada* llegada) {
+    static const char* const tipos[] = { "general", "enfermeria", "especialidad" };
+    static const char* const especialidades[] = { "cardiologia", "neurologia", "pediatria", "dermatologia" };
+    const char* campo;
+    size_t largo;
+    
+    linea = siguiente_campo(linea, fin, &campo, &largo);
+    llegada->tiempo = interpretar_hora(campo, largo);
+    linea = siguiente_campo(linea, fin, &campo, &largo);
+    int tipo = interpretar_nombre(campo, largo, tipos, 3);
+    linea = siguiente_campo(linea, fin, &campo, &largo);
+    int especialidad = interpretar_nombre(campo, largo, especialidades, 4);
+    linea = siguiente_campo(linea, fin, &campo, &largo);
+    int prioridad = (largo == 1) ? campo[0] - '0' : 0;
+    
+    if (llegada->tiempo < 0 || tipo < 0 || prioridad < 1 || prioridad > 5) return 0;
+    if (tipo == ATENCION_ESPECIALIDAD && especialidad < 0) return 0;
+    llegada->tipo = tipo;
+    llegada->especialidad = (tipo == ATENCION_ESPECIALIDAD) ? especialidad : 0;
+    llegada->prioridad = prioridad;
+    return 1;
+}
+
+// Avanzar el cursor hasta la próxima llegada válida y dejarla en
+// cursor->proxima, con la hora relativa a la primera; 0 al final del archivo
+static int leer_llegada(CursorLlegadas* cursor) {
+    const char* datos = registro_llegadas.datos;
+    size_t tamano = registro_llegadas.tamano;
+    
+    while (cursor->posicion < tamano) {
+        const char* linea = datos + cursor->posicion;
+        const char* fin = memchr(linea, '\n', tamano - cursor->posicion);
+        if (!fin) fin = datos + tamano;
+        int primera = (cursor->posicion == 0);
+        cursor->posicion = fin - datos + 1;
+        
+        // Devolver las páginas que ya no se van a leer
+        if (cursor->posicion - cursor->liberado >= (size_t)VENTANA_LLEGADAS) {
+            madvise((void*)(datos + cursor->liberado), VENTANA_LLEGADAS, MADV_DONTNEED);
+            cursor->liberado += VENTANA_LLEGADAS;
+        }
+        
+        while (linea < fin && (*linea == ' ' || *linea == '\t' || *linea == '\r')) linea++;
+        if (linea == fin || *linea == '#') continue;
+        
+        LlegadaRegistrada llegada;
+        if (!interpretar_llegada(linea, fin, &llegada)) {
+            if (!primera) cursor->descartadas++;  // La primera puede ser la cabecera
+            continue;
+        }
+        
+        // Un registro desordenado no puede hacer retroceder el reloj
+        llegada.tiempo -= registro_llegadas.origen;
+        if (llegada.tiempo < cursor->proxima.tiempo) llegada.tiempo = cursor->proxima.tiempo;
+        cursor->proxima = llegada;
+        cursor->leidas++;
+        return 1;
+    }
+    return 0;
+}
+
+void abrir_llegadas(const char* ruta) {
+    int fd = open(ruta, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0) {
+        fprintf(stderr, "No se pudo leer el registro de llegadas '%s'\n", ruta);
+        exit(1);
+    }
+    void* datos = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (datos == MAP_FAILED) {
+        fprintf(stderr, "No se pudo mapear el registro de llegadas '%s'\n", ruta);
+        exit(1);
+    }
+    madvise(datos, info.st_size, MADV_SEQUENTIAL);
+    registro_llegadas.datos = datos;
+    registro_llegadas.tamano = info.st_size;
+    
+    // La primera llegada válida fija el origen de la jornada
+    CursorLlegadas cursor = {0};
+    registro_llegadas.origen = 0;
+    if (!leer_llegada(&cursor)) {
+        fprintf(stderr, "'%s' no tiene llegadas válidas (hora,tipo,especialidad,prioridad)\n", ruta);
+        exit(1);
+    }
+    registro_llegadas.origen = cursor.proxima.tiempo;
+    registro_llegadas.activo = 1;
+}
+
+// Instante de la próxima llegada a partir de 'ahora': sorteado, o el de la
+// siguiente línea del registro (-1 cuando ya no quedan)
+long tiempo_proxima_llegada(long ahora) {
+    if (!registro_llegadas.activo) return ahora + intervalo_llegada();
+    
+    CursorLlegadas* cursor = &clinica->llegadas;
+    if (!leer_llegada(cursor)) {
+        if (!cursor->agotado) {
+            cursor->agotado = 1;
+            LOG(NIVEL_AVISO, "📂 Registro de llegadas agotado: %ld pacientes, %ld líneas descartadas\n",
+                cursor->leidas, cursor->descartadas);
+        }
+        return -1;
+    }
+    return (cursor->proxima.tiempo > ahora) ? cursor->proxima.tiempo : ahora;
+}
+
+// Crear un paciente recién llegado a recepción en la arena
+// (con --llegadas, con los datos de la línea que leyó el generador)
+// Devuelve HANDLE_NULO si no queda espacio para más pacientes
+HandlePaciente crear_paciente(void) {
+    HandlePaciente handle = reservar_paciente(&clinica->arena_pacientes);
+    if (handle == HANDLE_NULO) return HANDLE_NULO;
+    
+    Paciente* nuevo_paciente = paciente_de(&clinica->arena_pacientes, handle);
+    
+    nuevo_paciente->id = __atomic_add_fetch(&clinica->siguiente_id_paciente, 1, __ATOMIC_RELAXED);
+    SUMAR_ESTADISTICA(generados);
+    
+    fijar_estado(&clinica->arena_pacientes, handle, PACIENTE_EN_RECEPCION);
+    nuevo_paciente->tiempo_llegada = tiempo_simulado();
+    nuevo_paciente->plazo_abandono = PLAZO_NINGUNO;
+    
+    if (registro_llegadas.activo) {
+        const LlegadaRegistrada* llegada = &clinica->llegadas.proxima;
+        nuevo_paciente->prioridad = llegada->prioridad;
+        nuevo_paciente->tipo_atencion = llegada->tipo;
+        nuevo_paciente->especialidad = llegada->especialidad;
+    } else {
+        nuevo_paciente->prioridad = aleatorio() % 5 + 1;
+        
+        // Distribución: 70% general, 15% enfermería, 15% especialidad
+        int tipo_rand = aleatorio() % 100;
+        if (tipo_rand < 70) {
+            nuevo_paciente->tipo_atencion = ATENCION_GENERAL;
+        } else if (tipo_rand < 85) {
+            nuevo_paciente->tipo_atencion = ATENCION_ENFERMERIA;
+        } else {
+            nuevo_paciente->tipo_atencion = ATENCION_ESPECIALIDAD;
+            nuevo_paciente->especialidad = aleatorio() % 4;
+        }
+    }
+    
+    trazar(TRAZA_LLEGADA, nuevo_paciente, -1, -1);
+    
+    LOG(NIVEL_INFO, "👤 Paciente %d llegó - Tipo: %s, Prioridad: %d\n", 
+        nuevo_paciente->id, nombre_tipo_atencion(nuevo_paciente->tipo_atencion),
+        nuevo_paciente->prioridad);
+    
+    return handle;
+}
+
+// Un paciente rechazado por una cola llena sale del sistema
+static void descartar_rechazado(HandlePaciente handle, const char* donde) {
+    int id = paciente_de(&clinica->arena_pacientes, handle)->id;
+    trazar(TRAZA_RECHAZADO, paciente_de(&clinica->arena_pacientes, handle), -1, -1);
+    liberar_paciente(&clinica->arena_pacientes, handle);
+    
+    LOG(NIVEL_INFO, "⛔ Paciente %d rechazado: cola de %s llena\n", id, donde);
+}
+
+// Ingresar un paciente nuevo a recepción
+// Con COLA_LLENA el paciente sigue en manos del llamador, que debe reintentar
+ResultadoEncolado admitir_paciente(HandlePaciente handle) {
+    ResultadoEncolado resultado = enqueue(&clinica->cola_recepcion, handle);
+    if (resultado == RECHAZADO) {
+        descartar_rechazado(handle, "recepción");
+    }
+    return resultado;
+}
+
+// Ingresar a recepción un lote de pacientes llegados juntos, con una sola
+// sincronización; los rechazados salen del sistema. Solo en el modo con
+// hilos, donde recepción bloquea en lugar de devolver COLA_LLENA
+static int admitir_pacientes(const HandlePaciente* handles, int n) {
+    ResultadoEncolado resultados[TAM_LOTE_COLA];
+    int admitidos = enqueue_varios(&clinica->cola_recepcion, handles, n, resultados);
+    for (int i = 0; i < n; i++) {
+        if (resultados[i] == RECHAZADO) descartar_rechazado(handles[i], "recepción");
+    }
+    return admitidos;
+}
+
+// Cola de espera que corresponde al tipo de atención del paciente
+Cola* cola_destino(const Paciente* paciente) {
+    switch (paciente->tipo_atencion) {
+        case ATENCION_GENERAL:
+            return &clinica->cola_medico_general;
+        case ATENCION_ENFERMERIA:
+            return &clinica->cola_enfermeria;
+        case ATENCION_ESPECIALIDAD:
+        default:
+            if (!clinica->especialidad_cubierta[paciente->especialidad]) {
+                return &clinica->cola_medico_general;
+            }
+            return &clinica->cola_especialista[paciente->especialidad];
+    }
+}
+
+// Cola de la que toma pacientes cada médico
+Cola* cola_de_medico(const Medico* medico) {
+    switch (medico->tipo) {
+        case ATENCION_GENERAL:
+            return &clinica->cola_medico_general;
+        case ATENCION_ENFERMERIA:
+            return &clinica->cola_enfermeria;
+        case ATENCION_ESPECIALIDAD:
+        default:
+            return &clinica->cola_especialista[medico->especialidad];
+    }
+}
+
+const char* nombre_tipo_medico(const Medico* medico) {
+    return (medico->tipo == ATENCION_GENERAL) ? "Médico" :
+           (medico->tipo == ATENCION_ENFERMERIA) ? "Enfermera" : "Especialista";
+}
+
+int total_medicos_clinica(void) {
+    const ConfiguracionPersonal* p = &clinica->personal;
+    return p->num_medicos_general + p->num_enfermeras + p->num_especialistas;
+}
+
+// Matriz de capacidades: qué tipo de cola puede atender cada tipo de profesional
+// (fila: tipo del médico, columna: tipo de atención de la cola). Un especialista
+// solo atiende la cola de su propia especialidad.
+static const int matriz_capacidades[3][3] = {
+    //                  General  Enfermería  Especialidad
+    /* General */      { 1,       1,          0 },
+    /* Enfermería */   { 0,       1,          0 },
+    /* Especialista */ { 1,       0,          1 }
+};
+
+int puede_atender(const Medico* medico, const Cola* cola) {
+    if (cola == &clinica->cola_medico_general) {
+        return matriz_capacidades[medico->tipo][ATENCION_GENERAL];
+    }
+    if (cola == &clinica->cola_enfermeria) {
+        return matriz_capacidades[medico->tipo][ATENCION_ENFERMERIA];
+    }
+    for (int i = 0; i < 4; i++) {
+        if (cola == &clinica->cola_especialista[i]) {
+            return matriz_capacidades[medico->tipo][ATENCION_ESPECIALIDAD] &&
+                   medico->especialidad == (Especialidad)i;
+        }
+    }
+    return 0;
+}
+
+// Médicos libres (sin contar a 'excepto') que tienen la cola como propia
+static int libres_propios(const Cola* cola, const Medico* excepto) {
+    int libres = 0;
+    int total_medicos = total_medicos_clinica();
+    for (int i = 0; i < total_medicos; i++) {
+        const Medico* m = &clinica->medicos[i];
+        if (m != excepto && !__atomic_load_n(&m->ocupado, __ATOMIC_RELAXED) &&
+            __atomic_load_n(&m->activo, __ATOMIC_RELAXED) && cola_de_medico(m) == cola) {
+            libres++;
+        }
+    }
+    return libres;
+}
+
+// Tomar el próximo paciente para el médico sin bloquear: primero de su propia
+// cola y, si está vacía, de la cola compatible con más pacientes esperando.
+// Solo se roba el excedente que no alcanzan a tomar los médicos propios libres.
+HandlePaciente tomar_paciente_compatible(Medico* medico) {
+    Cola* propia = cola_de_medico(medico);
+    HandlePaciente handle = intentar_dequeue(propia);
+    if (handle != HANDLE_NULO) return handle;
+    
+    Cola* colas[] = { &clinica->cola_medico_general, &clinica->cola_enfermeria,
+                      &clinica->cola_especialista[0], &clinica->cola_especialista[1],
+                      &clinica->cola_especialista[2], &clinica->cola_especialista[3] };
+    int num_colas = sizeof(colas) / sizeof(colas[0]);
+    
+    // Otro médico puede vaciar la elegida entre la lectura y la extracción: reintentar
+    for (int intento = 0; intento < num_colas; intento++) {
+        Cola* mas_larga = NULL;
+        int max_esperando = 0;
+        for (int i = 0; i < num_colas; i++) {
+            if (colas[i] == propia || !puede_atender(medico, colas[i])) continue;
+            int esperando = __atomic_load_n(&colas[i]->count, __ATOMIC_RELAXED);
+            if (esperando > max_esperando && esperando > libres_propios(colas[i], medico)) {
+                max_esperando = esperando;
+                mas_larga = colas[i];
+            }
+        }
+        if (!mas_larga) return HANDLE_NULO;
+        
+        handle = intentar_dequeue(mas_larga);
+        if (handle != HANDLE_NULO) {
+            medico->pacientes_ajenos++;
+            return handle;
+        }
+    }
+    return HANDLE_NULO;
+}
+
+// Esperar (modo con hilos) hasta que haya un paciente que el médico pueda atender;
+// devuelve HANDLE_NULO si la simulación terminó
+HandlePaciente esperar_paciente_compatible(Medico* medico) {
+    while (simulacion_activa && __atomic_load_n(&medico->activo, __ATOMIC_ACQUIRE)) {
+        HandlePaciente handle = tomar_paciente_compatible(medico);
+        if (handle != HANDLE_NULO) return handle;
+        
+        uint32_t epoca = ec_preparar(&clinica->hay_trabajo);
+        handle = tomar_paciente_compatible(medico);
+        if (handle != HANDLE_NULO || !simulacion_activa ||
+            !__atomic_load_n(&medico->activo, __ATOMIC_ACQUIRE)) {
+            ec_cancelar(&clinica->hay_trabajo);
+            return handle;
+        }
+        ec_esperar(&clinica->hay_trabajo, epoca);
+    }
+    return HANDLE_NULO;
+}
+
+// Lo mismo para un admin con la cola de recepción; HANDLE_NULO también si
+// el gestor lo desactivó mientras esperaba
+HandlePaciente esperar_paciente_recepcion(PersonalAdmin* admin) {
+    while (simulacion_activa && __atomic_load_n(&admin->activo, __ATOMIC_ACQUIRE)) {
+        HandlePaciente handle = intentar_dequeue(&clinica->cola_recepcion);
+        if (handle != HANDLE_NULO) return handle;
+        
+        uint32_t epoca = ec_preparar(&clinica->hay_recepcion);
+        handle = intentar_dequeue(&clinica->cola_recepcion);
+        if (handle != HANDLE_NULO || !simulacion_activa ||
+            !__atomic_load_n(&admin->activo, __ATOMIC_ACQUIRE)) {
+            ec_cancelar(&clinica->hay_recepcion);
+            return handle;
+        }
+        ec_esperar(&clinica->hay_recepcion, epoca);
+    }
+    return HANDLE_NULO;
+}
+
+// Estacionar (modo con hilos) a un miembro inactivo del personal hasta que el
+// gestor lo active; devuelve 0 si la simulación terminó
+int esperar_activacion(const int* activo) {
+    while (simulacion_activa && !__atomic_load_n(activo, __ATOMIC_ACQUIRE)) {
+        uint32_t epoca = ec_preparar(&clinica->cambio_personal);
+        if (__atomic_load_n(activo, __ATOMIC_ACQUIRE) || !simulacion_activa) {
+            ec_cancelar(&clinica->cambio_personal);
+            break;
+        }
+        ec_esperar(&clinica->cambio_personal, epoca);
+    }
+    return simulacion_activa;
+}
+
+// Cubeta en la que cae 'valor' en un histograma log-lineal de 'num_cubetas'
+// (la última acumula todo lo que pasa del rango)
+static int cubeta_log_lineal(long valor, int num_cubetas) {
+    if (valor < 0) valor = 0;
+    if (valor < (2L << BITS_SUBCUBETA)) return valor;
+    
+    int exponente = 63 - __builtin_clzl(valor);
+    int sub = (valor >> (exponente - BITS_SUBCUBETA)) & ((1 << BITS_SUBCUBETA) - 1);
+    int cubeta = (2 << BITS_SUBCUBETA) + ((exponente - BITS_SUBCUBETA - 1) << BITS_SUBCUBETA) + sub;
+    return (cubeta < num_cubetas) ? cubeta : num_cubetas - 1;
+}
+
+// Cubeta del histograma de latencia en la que cae 'segundos'
+static int cubeta_latencia(long segundos) {
+    return cubeta_log_lineal(segundos, NUM_CUBETAS_LATENCIA);
+}
+
+// Mayor valor en segundos que cae en la cubeta (cota superior al reportar)
+static long techo_cubeta_latencia(int cubeta) {
+    if (cubeta < (2 << BITS_SUBCUBETA)) return cubeta;
+    
+    int resto = cubeta - (2 << BITS_SUBCUBETA);
+    int exponente = (resto >> BITS_SUBCUBETA) + BITS_SUBCUBETA + 1;
+    long ancho = 1L << (exponente - BITS_SUBCUBETA);
+    return ((1L << BITS_SUBCUBETA) + (resto & ((1 << BITS_SUBCUBETA) - 1))) * ancho + ancho - 1;
+}
+
+// Anotar la duración de un tramo en los histogramas del shard del hilo
+static void registrar_latencia(TramoLatencia tramo, const Paciente* paciente, long segundos) {
+    int cubeta = cubeta_latencia(segundos);
+    SUMAR_CUBETA(latencia_tipo[tramo][paciente->tipo_atencion].cubetas[cubeta]);
+    if (paciente->tipo_atencion == ATENCION_ESPECIALIDAD) {
+        SUMAR_CUBETA(latencia_especialidad[tramo][paciente->especialidad].cubetas[cubeta]);
+    }
+    SUMAR_CUBETA(latencia_prioridad[tramo][paciente->prioridad - 1].cubetas[cubeta]);
+}
+
+void combinar_histograma(HistogramaLatencia* destino, const HistogramaLatencia* origen) {
+    for (int i = 0; i < NUM_CUBETAS_LATENCIA; i++) {
+        destino->cubetas[i] += origen->cubetas[i];
+    }
+}
+
+long muestras_histograma(const HistogramaLatencia* histograma) {
+    long total = 0;
+    for (int i = 0; i < NUM_CUBETAS_LATENCIA; i++) total += histograma->cubetas[i];
+    return total;
+}
+
+// Valor por debajo del cual queda la fracción 'p' de las muestras
+static long percentil_cubetas(const long* cubetas, int num_cubetas, double p) {
+    long total = 0;
+    for (int i = 0; i < num_cubetas; i++) total += cubetas[i];
+    if (total == 0) return 0;
+    
+    long acumulado = 0;
+    for (int i = 0; i < num_cubetas; i++) {
+        acumulado += cubetas[i];
+        if (acumulado >= p * total) return techo_cubeta_latencia(i);
+    }
+    return techo_cubeta_latencia(num_cubetas - 1);
+}
+
+// Segundos por debajo de los cuales queda la fracción 'p' de las muestras
+long percentil_latencia(const HistogramaLatencia* histograma, double p) {
+    return percentil_cubetas(histograma->cubetas, NUM_CUBETAS_LATENCIA, p);
+}
+
+static inline void anotar_nanosegundos(HistogramaNanosegundos* histograma, long nanosegundos) {
+    histograma->cubetas[cubeta_log_lineal(nanosegundos, NUM_CUBETAS_NANOSEGUNDOS)]++;
+}
+
+void combinar_nanosegundos(HistogramaNanosegundos* destino, const HistogramaNanosegundos* origen) {
+    for (int i = 0; i < NUM_CUBETAS_NANOSEGUNDOS; i++) {
+        destino->cubetas[i] += origen->cubetas[i];
+    }
+}
+
+long muestras_nanosegundos(const HistogramaNanosegundos* histograma) {
+    long total = 0;
+    for (int i = 0; i < NUM_CUBETAS_NANOSEGUNDOS; i++) total += histograma->cubetas[i];
+    return total;
+}
+
+long percentil_nanosegundos(const HistogramaNanosegundos* histograma, double p) {
+    return percentil_cubetas(histograma->cubetas, NUM_CUBETAS_NANOSEGUNDOS, p);
+}
+
+static long nanosegundos_monotonos(void) {
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return ahora.tv_sec * 1000000000L + ahora.tv_nsec;
+}
+
+// Histograma de un tramo para todos los pacientes (suma de los tipos de atención)
+HistogramaLatencia latencia_total(const HistogramasPacientes* totales, TramoLatencia tramo) {
+    HistogramaLatencia total = {{0}};
+    for (int t = 0; t < 3; t++) {
+        combinar_histograma(&total, &totales->latencia_tipo[tramo][t]);
+    }
+    return total;
+}
+
+void iniciar_clasificacion(PersonalAdmin* admin, HandlePaciente handle) {
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    admin->ocupado = 1;
+    fijar_estado(&clinica->arena_pacientes, handle, PACIENTE_EN_CLASIFICACION);
+    
+    SUMAR_ESTADISTICA(inicios_clasificacion);
+    ACUMULAR_ESTADISTICA(espera_recepcion, tiempo_simulado() - paciente->tiempo_llegada);
+    registrar_latencia(TRAMO_RECEPCION, paciente, tiempo_simulado() - paciente->tiempo_llegada);
+    trazar(TRAZA_INICIO_CLASIFICACION, paciente, admin - clinica->personal_admin, -1);
+    
+    LOG(NIVEL_INFO, "📋 Admin %d clasificando paciente %d\n", admin->id, paciente->id);
+}
+
+// Encolar a un paciente ya clasificado con su plazo de abandono (los
+// rechazados salen del sistema; con COLA_LLENA sigue en manos del llamador)
+static ResultadoEncolado encolar_clasificado(HandlePaciente handle) {
+    // Una vez encolado el paciente pertenece a la cola: copiar lo que se usa después
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    int id = paciente->id;
+    TipoAtencion tipo = paciente->tipo_atencion;
+    long paciencia = paciencia_paciente();
+    time_t limite = paciente->tiempo_clasificacion + paciencia;
+    paciente->plazo_abandono = (paciencia > 0 && limite < PLAZO_NINGUNO) ? limite : PLAZO_NINGUNO;
+    
+    ResultadoEncolado resultado = enqueue_prioridad(cola_destino(paciente), handle);
+    if (resultado == RECHAZADO) {
+        descartar_rechazado(handle, nombre_destino(tipo));
+    } else if (resultado != COLA_LLENA && paciencia > 0) {
+        programar_temporizador(&clinica->rueda_abandonos,
+                               (TemporizadorAbandono){handle, id, limite});
+    }
+    return resultado;
+}
+
+// Dirigir al paciente clasificado a su cola. Con COLA_LLENA el admin sigue
+// ocupado con el paciente y debe reintentar cuando la cola tenga espacio
+ResultadoEncolado derivar_paciente(PersonalAdmin* admin, HandlePaciente handle) {
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    int id = paciente->id;
+    TipoAtencion tipo = paciente->tipo_atencion;
+    
+    ResultadoEncolado resultado = encolar_clasificado(handle);
+    if (resultado == COLA_LLENA) return resultado;
+    
+    if (resultado != RECHAZADO) {
+        LOG(NIVEL_INFO, "✅ Admin %d clasificó paciente %d hacia %s%s\n", 
+            admin->id, id, nombre_destino(tipo),
+            (resultado == DESVIADO) ? " (desviado por cola llena)" : "");
+    }
+    
+    admin->ocupado = 0;
+    return resultado;
+}
+
+// Registrar el fin de la clasificación (el paciente todavía no tiene cola)
+void registrar_clasificacion(PersonalAdmin* admin, HandlePaciente handle) {
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    paciente->tiempo_clasificacion = tiempo_simulado();
+    paciente->clasificado = 1;
+    fijar_estado(&clinica->arena_pacientes, handle, PACIENTE_EN_ESPERA);
+    admin->pacientes_clasificados++;
+    
+    SUMAR_ESTADISTICA(clasificados);
+    trazar(TRAZA_FIN_CLASIFICACION, paciente, admin - clinica->personal_admin, -1);
+}
+
+// Registrar el fin de la clasificación y dirigir al paciente a su cola
+ResultadoEncolado completar_clasificacion(PersonalAdmin* admin, HandlePaciente handle) {
+    registrar_clasificacion(admin, handle);
+    return derivar_paciente(admin, handle);
+}
+
+// Anotar en el histograma cuánto esperó el paciente desde su llegada hasta
+// que un médico lo sacó de la cola (para atenderlo o porque abandonó)
+static void registrar_espera_total(const Paciente* paciente, time_t ahora) {
+    long minutos = (ahora - paciente->tiempo_llegada) / 60;
+    if (minutos >= NUM_CUBETAS_ESPERA) minutos = NUM_CUBETAS_ESPERA - 1;
+    SUMAR_CUBETA(espera_total[minutos]);
+}
+
+// Minutos de espera por debajo de los cuales queda la fracción 'p' de los pacientes
+double percentil_espera(const HistogramasPacientes* totales, double p) {
+    long total = 0;
+    for (int i = 0; i < NUM_CUBETAS_ESPERA; i++) total += totales->espera_total[i];
+    if (total == 0) return 0;
+    
+    long acumulado = 0;
+    for (int i = 0; i < NUM_CUBETAS_ESPERA; i++) {
+        acumulado += totales->espera_total[i];
+        if (acumulado >= p * total) return i + 1;
+    }
+    return NUM_CUBETAS_ESPERA;
+}
+
+// Vence la paciencia de un paciente: si sigue en una cola se retira de ella
+// (queda como lápida que el próximo dequeue libera)
+void vencer_abandono(const TemporizadorAbandono* temporizador) {
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, temporizador->handle);
+    Cola* cola = __atomic_load_n(&paciente->cola_espera, __ATOMIC_ACQUIRE);
+    Paciente copia;
+    if (!cola || !retirar_de_cola(cola, temporizador->handle, temporizador->id_paciente, &copia)) {
+        return;
+    }
+    
+    SUMAR_ESTADISTICA(abandonaron);
+    registrar_espera_total(&copia, temporizador->vencimiento);
+    trazar(TRAZA_ABANDONO, &copia, -1, cola->indice);
+    
+    LOG(NIVEL_INFO, "🚪 Paciente %d abandonó la cola tras %ld min de espera\n",
+        copia.id, (long)(temporizador->vencimiento - copia.tiempo_clasificacion) / 60);
+}
+
+void iniciar_atencion(Medico* medico, HandlePaciente handle) {
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    medico->ocupado = 1;
+    paciente->tiempo_atencion = tiempo_simulado();
+    fijar_estado(&clinica->arena_pacientes, handle, PACIENTE_EN_ATENCION);
+    
+    SUMAR_ESTADISTICA(inicios_atencion);
+    registrar_espera_total(paciente, paciente->tiempo_atencion);
+    ACUMULAR_ESTADISTICA(espera_atencion, paciente->tiempo_atencion - paciente->tiempo_clasificacion);
+    registrar_latencia(TRAMO_ESPERA_MEDICO, paciente, paciente->tiempo_atencion - paciente->tiempo_clasificacion);
+    trazar(TRAZA_INICIO_ATENCION, paciente, medico - clinica->medicos, -1);
+    
+    LOG(NIVEL_INFO, "🩺 %s %d atendiendo paciente %d\n", nombre_tipo_medico(medico), medico->id, paciente->id);
+}
+
+// Cerrar la consulta: el paciente sale del sistema y su slot se recicla
+void completar_atencion(Medico* medico, HandlePaciente handle) {
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    medico->pacientes_atendidos++;
+    paciente->atendido = 1;
+    fijar_estado(&clinica->arena_pacientes, handle, PACIENTE_ATENDIDO);
+    
+    SUMAR_ESTADISTICA(atendidos);
+    registrar_latencia(TRAMO_CONSULTA, paciente, tiempo_simulado() - paciente->tiempo_atencion);
+    trazar(TRAZA_FIN_ATENCION, paciente, medico - clinica->medicos, -1);
+    
+    LOG(NIVEL_INFO, "✅ %s %d terminó de atender paciente %d\n", nombre_tipo_medico(medico), medico->id, paciente->id);
+    
+    liberar_paciente(&clinica->arena_pacientes, handle);
+    medico->ocupado = 0;
+}
+
+// Hilo generador de pacientes
+void* generador_pacientes(void* arg) {
+    (void)arg;
+    sembrar_aleatorio(FLUJO_GENERADOR);
+    
+    // Las llegadas del mismo instante (las ráfagas de un registro de llegadas)
+    // entran a recepción como un solo lote: un aviso a los admins por ráfaga
+    HandlePaciente lote[TAM_LOTE_COLA];
+    int en_lote = 0;
+    while (simulacion_activa) {
+        long llegada = tiempo_proxima_llegada(clinica->llegadas.reloj);
+        if (llegada != clinica->llegadas.reloj && en_lote > 0) {
+            admitir_pacientes(lote, en_lote);
+            en_lote = 0;
+        }
+        if (llegada < 0) break;  // Registro de llegadas agotado
+        dormir_simulacion(llegada - clinica->llegadas.reloj);
+        clinica->llegadas.reloj = llegada;
+        
+        if (!simulacion_activa) break;
+        
+        HandlePaciente nuevo_paciente = crear_paciente();
+        if (nuevo_paciente != HANDLE_NULO) {
+            lote[en_lote++] = nuevo_paciente;
+        }
+        if (en_lote == TAM_LOTE_COLA) {
+            admitir_pacientes(lote, en_lote);
+            en_lote = 0;
+        }
+    }
+    if (en_lote > 0) admitir_pacientes(lote, en_lote);
+    
+    return NULL;
+}
+
+// Hilo del personal administrativo
+void* personal_administrativo(void* arg) {
+    PersonalAdmin* admin = (PersonalAdmin*)arg;
+    sembrar_aleatorio(FLUJO_ADMIN(admin - clinica->personal_admin));
+    
+    while (simulacion_activa) {
+        // Inactivo: estacionado hasta que el gestor lo vuelva a activar
+        if (!esperar_activacion(&admin->activo)) break;
+        
+        HandlePaciente paciente = esperar_paciente_recepcion(admin);
+        if (paciente == HANDLE_NULO) continue;
+        
+        iniciar_clasificacion(admin, paciente);
+        
+        // Tiempo de clasificación: 1-3 minutos
+        dormir_simulacion(duracion_clasificacion());
+        
+        if (!simulacion_activa) break;
+        
+        completar_clasificacion(admin, paciente);
+    }
+    
+    return NULL;
+}
+
+// Hilo del médico
+void* medico_atencion(void* arg) {
+    Medico* medico = (Medico*)arg;
+    sembrar_aleatorio(FLUJO_MEDICO(medico - clinica->medicos));
+    
+    while (simulacion_activa) {
+        if (!esperar_activacion(&medico->activo)) break;
+        
+        // Su propia cola primero; si está vacía, trabajo de otra cola compatible
+        HandlePaciente paciente = esperar_paciente_compatible(medico);
+        if (paciente == HANDLE_NULO) continue;
+        
+        iniciar_atencion(medico, paciente);
+        
+        // Tiempo de atención: 8-12 minutos
+        dormir_simulacion(duracion_atencion());
+        
+        if (!simulacion_activa) break;
+        
+        completar_atencion(medico, paciente);
+        
+        // Pausa entre pacientes: 1-2 minutos
+        dormir_simulacion(duracion_pausa());
+    }
+    
+    return NULL;
+}
+
+// Gestión de personal por pronóstico. Para cada servicio (recepción y cada
+// cola de atención con su personal propio) se estima la tasa de llegadas con
+// un promedio móvil exponencial. Por la ley de Little (L = λ·W), la cola
+// compatible con la espera objetivo es λ·ESPERA_OBJETIVO: el exceso sobre
+// ella se reparte en el horizonte del pronóstico. La carga resultante
+// (llegadas más exceso, por el tiempo de servicio) se cubre de una vez hasta
+// UTILIZACION_MAXIMA; se baja de a uno solo si con uno menos la utilización
+// quedaría por debajo de UTILIZACION_MINIMA, para no oscilar.
+#define ALFA_PRONOSTICO 0.3
+#define ESPERA_OBJETIVO 600.0          // Segundos de espera aceptables en cada servicio
+#define HORIZONTE_PRONOSTICO 1800.0    // Plazo para absorber el exceso de cola
+#define UTILIZACION_MAXIMA 0.85
+#define UTILIZACION_MINIMA 0.5
+#define PAUSA_BAJAS_PERSONAL 120       // Mín 2 min de simulación entre bajas de un servicio
+#define CALENTAMIENTO_PRONOSTICO 600   // Sin bajas hasta tener historia (las colas de atención arrancan vacías)
+
+// Actualizar el pronóstico del servicio de 'cola' y devolver su carga
+// pronosticada en servidores ocupados, con 'tiempo_servicio' segundos por paciente
+static double carga_pronosticada(Cola* cola, double tiempo_servicio, time_t ahora) {
+    PronosticoServicio* p = &clinica->pronostico[cola->indice];
+    long insertados = __atomic_load_n(&cola->insertados, __ATOMIC_RELAXED);
+    if (ahora > p->ultima_medicion) {
+        double tasa = (double)(insertados - p->insertados_previos) / (ahora - p->ultima_medicion);
+        p->tasa_llegadas = p->inicializado ?
+                           p->tasa_llegadas + ALFA_PRONOSTICO * (tasa - p->tasa_llegadas) : tasa;
+        p->inicializado = 1;
+        p->insertados_previos = insertados;
+        p->ultima_medicion = ahora;
+    }
+    
+    double exceso = __atomic_load_n(&cola->count, __ATOMIC_RELAXED) - p->tasa_llegadas * ESPERA_OBJETIVO;
+    double demanda = p->tasa_llegadas + ((exceso > 0) ? exceso / HORIZONTE_PRONOSTICO : 0);
+    return demanda * tiempo_servicio;
+}
+
+// Activos que corresponden a un servicio con 'activos' de 'total' y la carga pronosticada
+static int ajustar_activos(PronosticoServicio* p, int activos, int total, double carga, time_t ahora) {
+    int necesarios = (int)ceil(carga / UTILIZACION_MAXIMA);
+    if (necesarios > total) necesarios = total;
+    if (necesarios > activos) return necesarios;
+    if (activos > 1 && carga <= (activos - 1) * UTILIZACION_MINIMA && ahora >= CALENTAMIENTO_PRONOSTICO &&
+        ahora - p->ultimo_cambio >= PAUSA_BAJAS_PERSONAL) {
+        return activos - 1;
+    }
+    return activos;
+}
+
+static void mn_aviso_cambio_personal(void);
+
+// Despertar a quien espera un cambio: los estacionados que se activaron y
+// los activos esperando trabajo que se desactivaron
+static void avisar_cambio_personal(void) {
+    if (modo_eventos_discretos) return;
+    ec_difundir(&clinica->cambio_personal);
+    ec_difundir(&clinica->hay_recepcion);
+    ec_difundir(&clinica->hay_trabajo);
+    if (modo_agentes_mn) mn_aviso_cambio_personal();
+}
+
+// Evaluar la demanda pronosticada y ajustar el personal activo
+void evaluar_personal(time_t ahora) {
+    int hubo_cambios = 0;
+    
+    // Personal administrativo: los activos son siempre los primeros
+    PronosticoServicio* recepcion = &clinica->pronostico[clinica->cola_recepcion.indice];
+    double carga = carga_pronosticada(&clinica->cola_recepcion, MEDIA_CLASIFICACION, ahora);
+    int activos = clinica->admin_activos;
+    int nuevos = ajustar_activos(recepcion, activos, clinica->personal.num_admin, carga, ahora);
+    
+    // Cada línea lleva el total tras ese cambio, como las de los médicos
+    for (int i = activos; i < nuevos; i++) {
+        LOG(NIVEL_AVISO, "🚨 ALTA DEMANDA: Activando Admin %d (Total activos: %d, pronóstico %.0f llegadas/h, %d en recepción)\n",
+            i + 1, i + 1, recepcion->tasa_llegadas * 3600, clinica->cola_recepcion.count);
+    }
+    for (int i = activos - 1; i >= nuevos; i--) {
+        LOG(NIVEL_AVISO, "📉 Baja demanda: Desactivando Admin %d (Total activos: %d, pronóstico %.0f llegadas/h)\n",
+            i + 1, i, recepcion->tasa_llegadas * 3600);
+    }
+    if (nuevos != activos) {
+        for (int i = 0; i < clinica->personal.num_admin; i++) {
+            __atomic_store_n(&clinica->personal_admin[i].activo, i < nuevos, __ATOMIC_RELEASE);
+        }
+        clinica->admin_activos = nuevos;
+        recepcion->ultimo_cambio = ahora;
+        hubo_cambios = 1;
+    }
+    
+    // Médicos: cada cola de atención con quienes la tienen como propia. Siempre
+    // queda uno activo por cola; se activan primero los de menor índice
+    const char* nombres_colas[] = { "Recepción", "Médico general", "Enfermería",
+                                    "Cardiología", "Neurología", "Pediatría", "Dermatología" };
+    Cola* colas[] = { &clinica->cola_medico_general, &clinica->cola_enfermeria,
+                      &clinica->cola_especialista[0], &clinica->cola_especialista[1],
+                      &clinica->cola_especialista[2], &clinica->cola_especialista[3] };
+    int total_medicos = total_medicos_clinica();
+    for (int c = 0; c < 6; c++) {
+        int total = 0, activos_cola = 0;
+        for (int i = 0; i < total_medicos; i++) {
+            if (cola_de_medico(&clinica->medicos[i]) != colas[c]) continue;
+            total++;
+            activos_cola += clinica->medicos[i].activo;
+        }
+        if (total == 0) continue;
+        
+        PronosticoServicio* p = &clinica->pronostico[colas[c]->indice];
+        carga = carga_pronosticada(colas[c], MEDIA_ATENCION + MEDIA_PAUSA, ahora);
+        int objetivo = ajustar_activos(p, activos_cola, total, carga, ahora);
+        if (objetivo == activos_cola) continue;
+        
+        // Se activan los de menor índice y se desactivan los de mayor
+        int activar = (objetivo > activos_cola);
+        for (int k = 0; k < total_medicos && activos_cola != objetivo; k++) {
+            Medico* medico = &clinica->medicos[activar ? k : total_medicos - 1 - k];
+            if (cola_de_medico(medico) != colas[c] || medico->activo == activar) continue;
+            __atomic_store_n(&medico->activo, activar, __ATOMIC_RELEASE);
+            activos_cola += activar ? 1 : -1;
+            LOG(NIVEL_AVISO, "%s %s %d (%s: %d/%d activos, pronóstico %.0f llegadas/h, %d en cola)\n",
+                activar ? "🚨 ALTA DEMANDA: Activando" : "📉 Baja demanda: Desactivando",
+                nombre_tipo_medico(medico), medico->id, nombres_colas[colas[c]->indice],
+                activos_cola, total, p->tasa_llegadas * 3600, colas[c]->count);
+        }
+        p->ultimo_cambio = ahora;
+        hubo_cambios = 1;
+    }
+    
+    if (hubo_cambios) avisar_cambio_personal();
+    
+    // Detectar colapso del sistema
+    int total_esperando = clinica->cola_recepcion.count + clinica->cola_medico_general.count + 
+                         clinica->cola_enfermeria.count;
+    for (int i = 0; i < 4; i++) {
+        total_esperando += clinica->cola_especialista[i].count;
+    }
+    
+    if (total_esperando > 50) {
+        LOG(NIVEL_AVISO, "🆘 SISTEMA COLAPSADO: %d pacientes esperando en total!\n", total_esperando);
+    }
+}
+
+// Función para gestionar cambios dinámicos de personal
 void* gestor_personal(void* arg) {
     (void)arg;
     
     while (simulacion_activa) {
-        dormir_simulacion(180); // Cada 3 minutos de simulación
+        dormir_simulacion(180); // Cada 3 minutos de simulación
+        
+        if (!simulacion_activa) break;
+        
+        evaluar_personal(tiempo_simulado());
+    }
+    
+    return NULL;
+}
+// Hilo que hace avanzar la rueda de abandonos al ritmo del reloj simulado
+void* reloj_abandonos(void* arg) {
+    (void)arg;
+    
+    while (simulacion_activa) {
+        dormir_simulacion(1);
+        
+        if (!simulacion_activa) break;
+        
+        avanzar_rueda(&clinica->rueda_abandonos, tiempo_simulado(), vencer_abandono);
+    }
+    
+    return NULL;
+}
+
+void* contador_tiempo(void* arg) {
+    (void)arg;
+    
+    while (simulacion_activa) {
+        sleep(10); // Cada 10 segundos reales
+        
+        if (!simulacion_activa) break;
+        
+        time_t tiempo_actual = time(NULL);
+        int tiempo_real_transcurrido = tiempo_actual - tiempo_inicio_simulacion;
+        int tiempo_simulacion_transcurrido = tiempo_real_transcurrido * SPEED_FACTOR;
+        
+        // Convertir a formato legible
+        int horas_real = tiempo_real_transcurrido / 3600;
+        int minutos_real = (tiempo_real_transcurrido % 3600) / 60;
+        int segundos_real = tiempo_real_transcurrido % 60;
+        
+        int horas_sim = tiempo_simulacion_transcurrido / 3600;
+        int minutos_sim = (tiempo_simulacion_transcurrido % 3600) / 60;
+        int segundos_sim = tiempo_simulacion_transcurrido % 60;
+        
+        ContadoresPacientes totales = leer_estadisticas(&clinica->estadisticas);
+        LOG(NIVEL_AVISO,
+            "\n⏰ TIEMPO TRANSCURRIDO:\n"
+            "   Real: %02d:%02d:%02d | Simulación: %02d:%02d:%02d (x%d)\n"
+            "   Pacientes: Gen=%ld, Clas=%ld, Atend=%ld, Aband=%ld\n\n", 
+            horas_real, minutos_real, segundos_real,
+            horas_sim, minutos_sim, segundos_sim, SPEED_FACTOR,
+            totales.generados, totales.clasificados,
+            totales.atendidos, totales.abandonaron);
+    }
+    
+    return NULL;
+}
+
+#define HORIZONTE_CENSO 900       // Segundos: el monitor avisa quiénes abandonan dentro de este plazo
+
+// Imprimir una instantánea del estado de colas y personal (un solo mensaje,
+// para que no se intercale con los de otros hilos)
+void imprimir_estado_sistema(void) {
+    if (!log_habilitado(NIVEL_AVISO)) return;
+    
+    char texto[TAM_MENSAJE_LOG];
+    int n = 0;
+#define AGREGAR(...) n += snprintf(texto + n, (n < (int)sizeof(texto)) ? sizeof(texto) - n : 0, __VA_ARGS__)
+    
+    AGREGAR("\n=== ESTADO DEL SISTEMA ===\n");
+    AGREGAR("Pacientes en recepción: %d\n", clinica->cola_recepcion.count);
+    AGREGAR("Pacientes esperando médico general: %d\n", clinica->cola_medico_general.count);
+    AGREGAR("Pacientes esperando enfermería: %d\n", clinica->cola_enfermeria.count);
+    
+    for (int i = 0; i < 4; i++) {
+        const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
+        AGREGAR("Pacientes esperando %s: %d\n", especialidades[i], clinica->cola_especialista[i].count);
+    }
+    
+    // Desglose por nivel y plazos desde las columnas de los segmentos
+    const char* nombres_colas[] = { "Recepción", "Médico general", "Enfermería",
+                                    "Cardiología", "Neurología", "Pediatría", "Dermatología" };
+    Cola* colas[NUM_COLAS_CLINICA];
+    colas_clinica(colas);
+    time_t ahora = tiempo_simulado();
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) {
+        CensoCola censo;
+        censar_cola(colas[c], ahora, ahora + HORIZONTE_CENSO, &censo);
+        if (!censo.con_columnas || censo.total == 0) continue;
+        AGREGAR("  %s por nivel 1-5: %ld/%ld/%ld/%ld/%ld, espera media %.1f min, máx %.1f min, %ld abandonan en %d min\n",
+                nombres_colas[c], censo.esperando[0], censo.esperando[1], censo.esperando[2],
+                censo.esperando[3], censo.esperando[4], censo.suma_espera / 60.0 / censo.total,
+                censo.espera_maxima / 60.0, censo.por_vencer, HORIZONTE_CENSO / 60);
+    }
+    
+    ContadoresPacientes totales = leer_estadisticas(&clinica->estadisticas);
+    AGREGAR("Total generados: %ld, Clasificados: %ld, Atendidos: %ld, Abandonaron: %ld\n", 
+            totales.generados, totales.clasificados, 
+            totales.atendidos, totales.abandonaron);
+    
+    // Los histogramas se copian sin seqlock: alcanza con percentiles aproximados
+    HistogramasPacientes histogramas;
+    leer_histogramas(&clinica->estadisticas, &histogramas);
+    const char* tramos[] = {"recepción", "espera de médico", "consulta"};
+    for (int t = 0; t < NUM_TRAMOS; t++) {
+        HistogramaLatencia total = latencia_total(&histogramas, t);
+        AGREGAR("Latencia %s p50/p95/p99: %.1f / %.1f / %.1f min\n", tramos[t],
+                percentil_latencia(&total, 0.50) / 60.0, percentil_latencia(&total, 0.95) / 60.0,
+                percentil_latencia(&total, 0.99) / 60.0);
+    }
+    
+    AGREGAR("Personal administrativo activos: %d/%d - ", clinica->admin_activos, clinica->personal.num_admin);
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        if (i < clinica->admin_activos) {
+            AGREGAR("%s%d", (i > 0) ? ", " : "", clinica->personal_admin[i].ocupado);
+        } else {
+            AGREGAR("%s0", (i > 0) ? ", " : ""); // Inactivo
+        }
+    }
+    AGREGAR("\n");
+    
+    AGREGAR("Médicos ocupados: ");
+    int total_medicos = total_medicos_clinica();
+    for (int i = 0; i < total_medicos; i++) {
+        AGREGAR("%s%d", (i > 0) ? ", " : "", clinica->medicos[i].ocupado);
+    }
+    AGREGAR("\n");
+    
+    AGREGAR("========================\n\n");
+#undef AGREGAR
+    
+    registrar_log("%s", texto);
+}
+
+void* monitor_sistema(void* arg) {
+    (void)arg;
+    
+    while (simulacion_activa) {
+        dormir_simulacion(300); // Cada 5 minutos de simulación
+        
+        if (!simulacion_activa) break;
+        
+        imprimir_estado_sistema();
+    }
+    
+    return NULL;
+}
+
+// ============================================================
+// Métricas en memoria compartida (--metricas NOMBRE)
+// ------------------------------------------------------------
+// Un bloque POSIX (shm_open) con una instantánea de colas, personal,
+// contadores y tasas que un hilo publicador reescribe cada
+// INTERVALO_METRICAS_MS. Tiene un único escritor y un seqlock, como los
+// shards de estadísticas: los lectores (--leer-metricas NOMBRE, o
+// cualquier tablero que mapee el bloque) copian sin tomar ningún lock
+// de la simulación ni esperar al publicador. El publicador deja su pid y
+// un latido en la cabecera para que un lector note si murió sin cerrar.
+// ============================================================
+
+#define MAGIA_METRICAS "CLINMETR"
+#define VERSION_METRICAS 3
+#define INTERVALO_METRICAS_MS 100
+#define LATIDO_VENCIDO_MS 10000         // Sin publicaciones por este tiempo el lector se retira
+#define ALFA_TASAS 0.2                  // Suavizado exponencial de las tasas por hora
+
+// Todos los campos son int64_t: se copian como un arreglo bajo el seqlock
+typedef struct {
+    int64_t publicaciones;
+    int64_t tiempo_simulado;            // Segundos de simulación
+    int64_t factor_velocidad;           // 0 en modo eventos discretos
+    int64_t finalizada;                 // 1 cuando la simulación terminó
+    int64_t largo_cola[NUM_COLAS_CLINICA];
+    int64_t maximo_cola[NUM_COLAS_CLINICA];
+    int64_t admin_activos;
+    int64_t num_admin;
+    int64_t admin_ocupados;
+    int64_t num_medicos;
+    int64_t medicos_ocupados;
+    int64_t generados;
+    int64_t clasificados;
+    int64_t atendidos;
+    int64_t abandonaron;
+    int64_t rechazados;
+    int64_t llegadas_hora;              // Tasas suavizadas, en pacientes por hora simulada
+    int64_t atendidos_hora;
+    int64_t abandonos_hora;
+    // Un bit por persona (1 = ocupada), en el orden de personal_admin y medicos
+    uint64_t admin_ocupado[MAX_ADMIN / 64];
+    uint64_t medico_ocupado[MAX_MEDICOS / 64];
+} MetricasPublicadas;
+
+_Static_assert(MAX_ADMIN % 64 == 0 && MAX_MEDICOS % 64 == 0, "Los mapas de ocupados usan palabras enteras");
+#define NUM_CAMPOS_METRICAS (sizeof(MetricasPublicadas) / sizeof(int64_t))
+
+typedef struct {
+    char magia[8];
+    uint32_t version;
+    uint32_t tam_metricas;
+    int64_t pid;
+    uint32_t secuencia;                 // Impar mientras el publicador escribe
+    uint32_t reservado;
+    int64_t latido;                     // CLOCK_MONOTONIC (ms) de la última publicación
+    MetricasPublicadas metricas;
+} BloqueMetricas;
+
+static BloqueMetricas* bloque_metricas = NULL;
+static char nombre_metricas[NAME_MAX];
+static pthread_t hilo_metricas;
+
+// Estado del publicador para calcular tasas entre publicaciones
+static int64_t metricas_tiempo_anterior = -1;
+static int64_t metricas_contadores_anteriores[3];
+static double metricas_tasas[3];
+
+// Los nombres POSIX de memoria compartida empiezan con '/'
+static void normalizar_nombre_metricas(char* destino, const char* nombre) {
+    snprintf(destino, NAME_MAX, "%s%s", (nombre[0] == '/') ? "" : "/", nombre);
+}
+
+// El reloj monótono es el mismo para todos los procesos del sistema
+static int64_t latido_actual(void) {
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return (int64_t)ahora.tv_sec * 1000 + ahora.tv_nsec / 1000000;
+}
+
+void abrir_metricas(const char* nombre) {
+    normalizar_nombre_metricas(nombre_metricas, nombre);
+    int fd = shm_open(nombre_metricas, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(BloqueMetricas)) != 0) {
+        fprintf(stderr, "No se pudo crear la memoria compartida '%s'\n", nombre_metricas);
+        exit(1);
+    }
+    bloque_metricas = mmap(NULL, sizeof(BloqueMetricas), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bloque_metricas == MAP_FAILED) {
+        fprintf(stderr, "No se pudo mapear la memoria compartida '%s'\n", nombre_metricas);
+        exit(1);
+    }
+    
+    // La magia va al final: un lector que la ve encuentra la cabecera completa
+    bloque_metricas->version = VERSION_METRICAS;
+    bloque_metricas->tam_metricas = sizeof(MetricasPublicadas);
+    bloque_metricas->pid = getpid();
+    bloque_metricas->latido = latido_actual();
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(bloque_metricas->magia, MAGIA_METRICAS, sizeof(bloque_metricas->magia));
+}
+
+// Armar la instantánea con las mismas lecturas sin lock que usa el monitor
+static void tomar_metricas(MetricasPublicadas* m) {
+    Cola* colas[NUM_COLAS_CLINICA] = {
+        &clinica->cola_recepcion, &clinica->cola_medico_general, &clinica->cola_enfermeria,
+        &clinica->cola_especialista[0], &clinica->cola_especialista[1],
+        &clinica->cola_especialista[2], &clinica->cola_especialista[3]
+    };
+    
+    m->tiempo_simulado = tiempo_simulado();
+    m->factor_velocidad = modo_eventos_discretos ? 0 : SPEED_FACTOR;
+    m->rechazados = 0;
+    for (int i = 0; i < NUM_COLAS_CLINICA; i++) {
+        m->largo_cola[i] = __atomic_load_n(&colas[i]->count, __ATOMIC_RELAXED);
+        m->maximo_cola[i] = __atomic_load_n(&colas[i]->max_count, __ATOMIC_RELAXED);
+        m->rechazados += __atomic_load_n(&colas[i]->rechazados, __ATOMIC_RELAXED);
+    }
+    
+    m->admin_activos = __atomic_load_n(&clinica->admin_activos, __ATOMIC_RELAXED);
+    m->num_admin = clinica->personal.num_admin;
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        if (__atomic_load_n(&clinica->personal_admin[i].ocupado, __ATOMIC_RELAXED)) {
+            m->admin_ocupados++;
+            m->admin_ocupado[i / 64] |= 1ull << (i % 64);
+        }
+    }
+    m->num_medicos = total_medicos_clinica();
+    for (int i = 0; i < m->num_medicos; i++) {
+        if (__atomic_load_n(&clinica->medicos[i].ocupado, __ATOMIC_RELAXED)) {
+            m->medicos_ocupados++;
+            m->medico_ocupado[i / 64] |= 1ull << (i % 64);
+        }
+    }
+    
+    // Solo los totales: cada publicación no necesita copiar los demás contadores
+    long totales[4];
+    leer_totales_pacientes(&clinica->estadisticas, totales);
+    m->generados = totales[0];
+    m->clasificados = totales[1];
+    m->atendidos = totales[2];
+    m->abandonaron = totales[3];
+    
+    // Tasas por hora simulada, suavizadas entre publicaciones con avance de reloj
+    int64_t contadores[3] = { m->generados, m->atendidos, m->abandonaron };
+    if (metricas_tiempo_anterior >= 0 && m->tiempo_simulado > metricas_tiempo_anterior) {
+        double horas = (m->tiempo_simulado - metricas_tiempo_anterior) / 3600.0;
+        for (int i = 0; i < 3; i++) {
+            double tasa = (contadores[i] - metricas_contadores_anteriores[i]) / horas;
+            metricas_tasas[i] += ALFA_TASAS * (tasa - metricas_tasas[i]);
+        }
+    }
+    if (metricas_tiempo_anterior < 0 || m->tiempo_simulado > metricas_tiempo_anterior) {
+        metricas_tiempo_anterior = m->tiempo_simulado;
+        memcpy(metricas_contadores_anteriores, contadores, sizeof(contadores));
+    }
+    m->llegadas_hora = (int64_t)(metricas_tasas[0] + 0.5);
+    m->atendidos_hora = (int64_t)(metricas_tasas[1] + 0.5);
+    m->abandonos_hora = (int64_t)(metricas_tasas[2] + 0.5);
+}
+
+// Publicar una instantánea (solo desde un escritor a la vez)
+void publicar_metricas(int finalizada) {
+    if (!bloque_metricas) return;
+    
+    MetricasPublicadas nuevas = {0};
+    tomar_metricas(&nuevas);
+    nuevas.publicaciones = bloque_metricas->metricas.publicaciones + 1;
+    nuevas.finalizada = finalizada;
+    
+    int64_t* origen = (int64_t*)&nuevas;
+    int64_t* destino = (int64_t*)&bloque_metricas->metricas;
+    uint32_t secuencia = bloque_metricas->secuencia;
+    __atomic_store_n(&bloque_metricas->secuencia, secuencia + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < NUM_CAMPOS_METRICAS; i++) {
+        __atomic_store_n(&destino[i], origen[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&bloque_metricas->secuencia, secuencia + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&bloque_metricas->latido, latido_actual(), __ATOMIC_RELAXED);
+}
+
+void* publicador_metricas(void* arg) {
+    (void)arg;
+    
+    while (simulacion_activa) {
+        publicar_metricas(0);
+        usleep(INTERVALO_METRICAS_MS * 1000);
+    }
+    return NULL;
+}
+
+void iniciar_publicador_metricas(void) {
+    if (bloque_metricas) pthread_create(&hilo_metricas, NULL, publicador_metricas, NULL);
+}
+
+// Última publicación marcada como final; el nombre se retira para que no
+// quede en /dev/shm, pero los lectores que ya lo mapearon siguen leyendo
+void cerrar_metricas(void) {
+    if (!bloque_metricas) return;
+    if (!modo_eventos_discretos) pthread_join(hilo_metricas, NULL);
+    publicar_metricas(1);
+    shm_unlink(nombre_metricas);
+    munmap(bloque_metricas, sizeof(BloqueMetricas));
+    bloque_metricas = NULL;
+}
+
+// Copia consistente del bloque (reintenta si el publicador estaba escribiendo)
+static MetricasPublicadas leer_bloque_metricas(const BloqueMetricas* bloque) {
+    MetricasPublicadas copia;
+    const int64_t* origen = (const int64_t*)&bloque->metricas;
+    int64_t* destino = (int64_t*)&copia;
+    uint32_t antes, despues;
+    do {
+        antes = __atomic_load_n(&bloque->secuencia, __ATOMIC_ACQUIRE);
+        for (size_t i = 0; i < NUM_CAMPOS_METRICAS; i++) {
+            destino[i] = __atomic_load_n(&origen[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        despues = __atomic_load_n(&bloque->secuencia, __ATOMIC_RELAXED);
+    } while ((antes & 1) || antes != despues);
+    return copia;
+}
+
+// Motivo para dejar de leer un bloque que nunca se marcará como final: el
+// publicador murió (o su pid es de otro proceso y dejó de latir)
+static const char* publicador_perdido(const BloqueMetricas* bloque) {
+    if (kill((pid_t)bloque->pid, 0) != 0 && errno == ESRCH) {
+        return "el proceso de la simulación ya no existe";
+    }
+    if (latido_actual() - __atomic_load_n(&bloque->latido, __ATOMIC_RELAXED) > LATIDO_VENCIDO_MS) {
+        return "la simulación dejó de publicar";
+    }
+    return NULL;
+}
+
+// Una marca por persona: 1 ocupada, 0 libre
+static void escribir_ocupados(const char* titulo, const uint64_t* mapa, int64_t cuantos, int64_t maximo) {
+    if (cuantos > maximo) cuantos = maximo;
+    printf("    %s", titulo);
+    for (int64_t i = 0; i < cuantos; i++) putchar(((mapa[i / 64] >> (i % 64)) & 1) ? '1' : '0');
+    printf("\n");
+}
+
+// Lector de consola: una línea por cada publicación nueva, con el estado de
+// cada persona debajo, hasta que la simulación termine (o deje de publicar)
+// o se presione Ctrl+C
+void leer_metricas(const char* nombre, int intervalo_ms) {
+    char ruta[NAME_MAX];
+    normalizar_nombre_metricas(ruta, nombre);
+    int fd = shm_open(ruta, O_RDONLY, 0);
+    if (fd < 0) {
+        fprintf(stderr, "No existe la memoria compartida '%s' (¿corre la simulación con --metricas?)\n", ruta);
+        exit(1);
+    }
+    const BloqueMetricas* bloque = mmap(NULL, sizeof(BloqueMetricas), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (bloque == MAP_FAILED || memcmp(bloque->magia, MAGIA_METRICAS, 8) != 0 ||
+        bloque->version != VERSION_METRICAS || bloque->tam_metricas != sizeof(MetricasPublicadas)) {
+        fprintf(stderr, "'%s' no es un bloque de métricas de esta versión\n", ruta);
+        exit(1);
+    }
+    
+    printf("📡 Leyendo '%s' (simulación pid %lld)\n", ruta, (long long)bloque->pid);
+    printf("  Hora     Recep  Gral  Enf  Esp  Admin  Médicos  Gen    Atend  Aband  Lleg/h  Atend/h\n");
+    int64_t ultima = 0;
+    while (simulacion_activa) {
+        MetricasPublicadas m = leer_bloque_metricas(bloque);
+        if (m.publicaciones != ultima) {
+            ultima = m.publicaciones;
+            printf("  %2lld:%02lld:%02lld  %5lld %5lld %4lld %4lld  %2lld/%lld  %4d/%-3lld %6lld %6lld %6lld %7lld %8lld\n",
+                   (long long)(m.tiempo_simulado / 3600), (long long)(m.tiempo_simulado % 3600 / 60),
+                   (long long)(m.tiempo_simulado % 60),
+                   (long long)m.largo_cola[0], (long long)m.largo_cola[1], (long long)m.largo_cola[2],
+                   (long long)(m.largo_cola[3] + m.largo_cola[4] + m.largo_cola[5] + m.largo_cola[6]),
+                   (long long)m.admin_activos, (long long)m.num_admin, (int)m.medicos_ocupados, (long long)m.num_medicos,
+                   (long long)m.generados, (long long)m.atendidos, (long long)m.abandonaron,
+                   (long long)m.llegadas_hora, (long long)m.atendidos_hora);
+            escribir_ocupados("Admins:  ", m.admin_ocupado, m.num_admin, MAX_ADMIN);
+            escribir_ocupados("Médicos: ", m.medico_ocupado, m.num_medicos, MAX_MEDICOS);
+            fflush(stdout);
+        }
+        if (m.finalizada) {
+            printf("✅ La simulación terminó\n");
+            break;
+        }
+        // Releer antes de rendirse: pudo cerrar el bloque justo antes de salir
+        const char* perdido = publicador_perdido(bloque);
+        if (perdido && !leer_bloque_metricas(bloque).finalizada) {
+            fprintf(stderr, "⚠️  Lectura interrumpida: %s\n", perdido);
+            break;
+        }
+        usleep(intervalo_ms * 1000);
+    }
+    munmap((void*)bloque, sizeof(BloqueMetricas));
+}
+
+// ============================================================
+// Serie temporal en columnas (--serie ARCHIVO, --muestreo SEGUNDOS)
+// ------------------------------------------------------------
+// Cada --muestreo segundos simulados (60 por omisión) se toma una fila con
+// el largo de cada cola, el personal activo y ocupado y los contadores
+// acumulados. Las filas se juntan por columna en bloques de
+// FILAS_BLOQUE_SERIE y un hilo escritor codifica cada bloque lleno y lo
+// agrega al final del archivo: el muestreo nunca espera al disco.
+// Dentro de un bloque cada columna se guarda como diferencias con la fila
+// anterior (la primera, con cero) en zigzag y varint: entre muestras las
+// colas y los contadores cambian poco y casi todo ocupa un byte. El largo
+// de cada columna va en la cabecera del bloque, así un lector salta las
+// que no necesita y decodifica un bloque sin leer los anteriores.
+// En eventos discretos se muestrea desde el bucle de eventos sin programar
+// eventos nuevos (la jornada no cambia); con hilos, desde un hilo que
+// sigue el reloj simulado. --leer-serie ARCHIVO la vuelca como CSV.
+//
+// Formato: CabeceraSerie y luego bloques de
+//   uint32 filas | uint32 bytes[NUM_COLUMNAS_SERIE] | columnas codificadas
+// ============================================================
+
+#define MAGIA_SERIE "CLINSERI"
+#define VERSION_SERIE 1
+#define FILAS_BLOQUE_SERIE 1024             // 17 horas por bloque con el muestreo por omisión
+#define TAM_NOMBRE_COLUMNA 24
+#define INTERVALO_MUESTREADOR_MS 50         // Consulta del reloj simulado en modo con hilos
+
+typedef enum {
+    COLUMNA_TIEMPO,            // Segundos de simulación
+    COLUMNA_COLA_RECEPCION,    // Largo de cada cola, en el orden de Cola.indice
+    COLUMNA_COLA_GENERAL,
+    COLUMNA_COLA_ENFERMERIA,
+    COLUMNA_COLA_CARDIOLOGIA,
+    COLUMNA_COLA_NEUROLOGIA,
+    COLUMNA_COLA_PEDIATRIA,
+    COLUMNA_COLA_DERMATOLOGIA,
+    COLUMNA_ADMIN_ACTIVOS,
+    COLUMNA_ADMIN_OCUPADOS,
+    COLUMNA_MEDICOS_ACTIVOS,
+    COLUMNA_MEDICOS_OCUPADOS,
+    COLUMNA_GENERADOS,         // Acumulados desde el inicio de la jornada
+    COLUMNA_CLASIFICADOS,
+    COLUMNA_ATENDIDOS,
+    COLUMNA_ABANDONARON,
+    COLUMNA_RECHAZADOS,
+    NUM_COLUMNAS_SERIE
+} ColumnaSerie;
+
+static const char* nombres_columnas_serie[NUM_COLUMNAS_SERIE] = {
+    "tiempo", "cola_recepcion", "cola_general", "cola_enfermeria", "cola_cardiologia",
+    "cola_neurologia", "cola_pediatria", "cola_dermatologia", "admin_activos", "admin_ocupados",
+    "medicos_activos", "medicos_ocupados", "generados", "clasificados", "atendidos",
+    "abandonaron", "rechazados"
+};
+
+typedef struct {
+    char magia[8];
+    uint32_t version;
+    uint32_t num_columnas;
+    uint32_t filas_bloque;
+    int32_t intervalo;         // Segundos simulados entre muestras
+    uint64_t semilla;
+    int32_t factor_velocidad;  // 0 en modo eventos discretos
+    int32_t reservado;
+    char columnas[NUM_COLUMNAS_SERIE][TAM_NOMBRE_COLUMNA];
+} CabeceraSerie;
+
+// Bloque en memoria, por columnas
+typedef struct BloqueSerie {
+    int filas;
+    struct BloqueSerie* siguiente;
+    int64_t valores[NUM_COLUMNAS_SERIE][FILAS_BLOQUE_SERIE];
+} BloqueSerie;
+
+#define TAM_CABECERA_BLOQUE_SERIE ((1 + NUM_COLUMNAS_SERIE) * sizeof(uint32_t))
+#define TAM_MAXIMO_BLOQUE_SERIE \
+    (TAM_CABECERA_BLOQUE_SERIE + NUM_COLUMNAS_SERIE * FILAS_BLOQUE_SERIE * 10)  // Varints de 10 bytes
+
+typedef struct {
+    int fd;
+    int activa;
+    int detener;
+    BloqueSerie* actual;       // Lo llena el muestreador
+    BloqueSerie* pendientes;   // Llenos, en orden, esperando al escritor
+    BloqueSerie** fin_pendientes;
+    long muestras;
+    long bytes;                // Escritos en el archivo
+    pthread_mutex_t mutex;
+    pthread_cond_t hay_bloques;
+    pthread_t escritor;
+    pthread_t muestreador;
+} ArchivoSerie;
+
+static ArchivoSerie serie = { .fd = -1, .mutex = PTHREAD_MUTEX_INITIALIZER,
+                              .hay_bloques = PTHREAD_COND_INITIALIZER };
+int intervalo_serie = 60;                  // --muestreo
+long proxima_muestra_serie = LONG_MAX;     // Eventos discretos: instante de la próxima muestra
+
+// Diferencias con signo como enteros sin signo pequeños: 0, -1, 1, -2... -> 0, 1, 2, 3...
+static inline uint64_t zigzag(int64_t valor) {
+    return ((uint64_t)valor << 1) ^ (uint64_t)(valor >> 63);
+}
+
+static inline int64_t deshacer_zigzag(uint64_t valor) {
+    return (int64_t)(valor >> 1) ^ -(int64_t)(valor & 1);
+}
+
+static uint8_t* escribir_varint(uint8_t* p, uint64_t valor) {
+    while (valor >= 0x80) {
+        *p++ = (uint8_t)(valor | 0x80);
+        valor >>= 7;
+    }
+    *p++ = (uint8_t)valor;
+    return p;
+}
+
+// NULL si el varint está cortado o es demasiado largo
+static const uint8_t* leer_varint(const uint8_t* p, const uint8_t* fin, uint64_t* valor) {
+    uint64_t v = 0;
+    for (int desplazamiento = 0; p < fin && desplazamiento < 64; desplazamiento += 7) {
+        uint8_t byte = *p++;
+        v |= (uint64_t)(byte & 0x7f) << desplazamiento;
+        if (!(byte & 0x80)) {
+            *valor = v;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+// Codificar un bloque en 'salida' (al menos TAM_MAXIMO_BLOQUE_SERIE bytes)
+static size_t codificar_bloque_serie(const BloqueSerie* bloque, uint8_t* salida) {
+    uint32_t cabecera[1 + NUM_COLUMNAS_SERIE];
+    uint8_t* p = salida + TAM_CABECERA_BLOQUE_SERIE;
+    cabecera[0] = bloque->filas;
+    for (int c = 0; c < NUM_COLUMNAS_SERIE; c++) {
+        uint8_t* inicio = p;
+        int64_t anterior = 0;
+        for (int f = 0; f < bloque->filas; f++) {
+            p = escribir_varint(p, zigzag(bloque->valores[c][f] - anterior));
+            anterior = bloque->valores[c][f];
+        }
+        cabecera[1 + c] = p - inicio;
+    }
+    memcpy(salida, cabecera, TAM_CABECERA_BLOQUE_SERIE);
+    return p - salida;
+}
+
+static int escribir_todo(int fd, const uint8_t* datos, size_t n) {
+    while (n > 0) {
+        ssize_t escritos = write(fd, datos, n);
+        if (escritos <= 0) return 0;
+        datos += escritos;
+        n -= escritos;
+    }
+    return 1;
+}
+
+// Hilo escritor: codifica y anexa los bloques pendientes hasta que se cierre la serie
+static void* escritor_serie(void* arg) {
+    (void)arg;
+    uint8_t* buffer = malloc(TAM_MAXIMO_BLOQUE_SERIE);
+    int error = (buffer == NULL);
+    if (error) fprintf(stderr, "Sin memoria para escribir la serie\n");
+    
+    pthread_mutex_lock(&serie.mutex);
+    while (1) {
+        while (!serie.pendientes && !serie.detener) {
+            pthread_cond_wait(&serie.hay_bloques, &serie.mutex);
+        }
+        BloqueSerie* lista = serie.pendientes;
+        if (!lista) break;
+        serie.pendientes = NULL;
+        serie.fin_pendientes = &serie.pendientes;
+        pthread_mutex_unlock(&serie.mutex);
+        
+        while (lista) {
+            BloqueSerie* siguiente = lista->siguiente;
+            if (!error) {
+                size_t n = codificar_bloque_serie(lista, buffer);
+                if (escribir_todo(serie.fd, buffer, n)) {
+                    serie.bytes += n;
+                } else {
+                    fprintf(stderr, "No se pudo escribir la serie: se deja de registrar\n");
+                    error = 1;
+                }
+            }
+            free(lista);
+            lista = siguiente;
+        }
+        pthread_mutex_lock(&serie.mutex);
+    }
+    pthread_mutex_unlock(&serie.mutex);
+    free(buffer);
+    return NULL;
+}
+
+static void entregar_bloque_serie(void) {
+    BloqueSerie* lleno = serie.actual;
+    serie.actual = NULL;
+    lleno->siguiente = NULL;
+    
+    pthread_mutex_lock(&serie.mutex);
+    *serie.fin_pendientes = lleno;
+    serie.fin_pendientes = &lleno->siguiente;
+    pthread_cond_signal(&serie.hay_bloques);
+    pthread_mutex_unlock(&serie.mutex);
+}
+
+// Agregar una fila con el estado de la clínica actual, con las mismas
+// lecturas sin lock que usa el monitor (solo desde un muestreador a la vez)
+static void muestrear_serie(int64_t tiempo) {
+    if (!serie.actual) {
+        serie.actual = malloc(sizeof(BloqueSerie));
+        if (!serie.actual) {
+            fprintf(stderr, "Sin memoria para la serie\n");
+            exit(1);
+        }
+        serie.actual->filas = 0;
+    }
+    BloqueSerie* bloque = serie.actual;
+    int f = bloque->filas;
+    Cola* colas[NUM_COLAS_CLINICA] = {
+        &clinica->cola_recepcion, &clinica->cola_medico_general, &clinica->cola_enfermeria,
+        &clinica->cola_especialista[0], &clinica->cola_especialista[1],
+        &clinica->cola_especialista[2], &clinica->cola_especialista[3]
+    };
+    
+    bloque->valores[COLUMNA_TIEMPO][f] = tiempo;
+    int64_t rechazados = 0;
+    for (int i = 0; i < NUM_COLAS_CLINICA; i++) {
+        bloque->valores[COLUMNA_COLA_RECEPCION + i][f] = __atomic_load_n(&colas[i]->count, __ATOMIC_RELAXED);
+        rechazados += __atomic_load_n(&colas[i]->rechazados, __ATOMIC_RELAXED);
+    }
+    
+    int64_t ocupados = 0;
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        ocupados += (__atomic_load_n(&clinica->personal_admin[i].ocupado, __ATOMIC_RELAXED) != 0);
+    }
+    bloque->valores[COLUMNA_ADMIN_ACTIVOS][f] = __atomic_load_n(&clinica->admin_activos, __ATOMIC_RELAXED);
+    bloque->valores[COLUMNA_ADMIN_OCUPADOS][f] = ocupados;
+    
+    int64_t activos = 0;
+    ocupados = 0;
+    int total_medicos = total_medicos_clinica();
+    for (int i = 0; i < total_medicos; i++) {
+        activos += (__atomic_load_n(&clinica->medicos[i].activo, __ATOMIC_RELAXED) != 0);
+        ocupados += (__atomic_load_n(&clinica->medicos[i].ocupado, __ATOMIC_RELAXED) != 0);
+    }
+    bloque->valores[COLUMNA_MEDICOS_ACTIVOS][f] = activos;
+    bloque->valores[COLUMNA_MEDICOS_OCUPADOS][f] = ocupados;
+    
+    long totales[4];
+    leer_totales_pacientes(&clinica->estadisticas, totales);
+    for (int c = 0; c < 4; c++) bloque->valores[COLUMNA_GENERADOS + c][f] = totales[c];
+    bloque->valores[COLUMNA_RECHAZADOS][f] = rechazados;
+    
+    serie.muestras++;
+    if (++bloque->filas == FILAS_BLOQUE_SERIE) entregar_bloque_serie();
+}
+
+// Eventos discretos: las muestras de los instantes anteriores a 'hasta'.
+// Entre eventos el estado no cambia, así que la muestra de T ve todos los
+// eventos hasta T (los abandonos vencidos se descuentan en el evento
+// siguiente, igual que en la jornada)
+void muestrear_serie_hasta(long hasta) {
+    while (proxima_muestra_serie < hasta) {
+        muestrear_serie(proxima_muestra_serie);
+        proxima_muestra_serie += intervalo_serie;
+    }
+}
+
+// Modo con hilos: una muestra al cruzar cada múltiplo del intervalo y una
+// última al detenerse la simulación
+static void* muestreador_serie(void* arg) {
+    (void)arg;
+    int64_t proxima = 0, ultima = -1;
+    
+    while (simulacion_activa) {
+        int64_t ahora = tiempo_simulado();
+        if (ahora >= proxima) {
+            muestrear_serie(ahora);
+            ultima = ahora;
+            proxima = ahora - ahora % intervalo_serie + intervalo_serie;
+        }
+        usleep(INTERVALO_MUESTREADOR_MS * 1000);
+    }
+    int64_t ahora = tiempo_simulado();
+    if (ahora > ultima) muestrear_serie(ahora);
+    return NULL;
+}
+
+// Crear el archivo con su cabecera y arrancar el escritor
+void abrir_serie(const char* ruta) {
+    CabeceraSerie cabecera = { .version = VERSION_SERIE, .num_columnas = NUM_COLUMNAS_SERIE,
+                               .filas_bloque = FILAS_BLOQUE_SERIE, .intervalo = intervalo_serie,
+                               .semilla = semilla_global,
+                               .factor_velocidad = modo_eventos_discretos ? 0 : SPEED_FACTOR };
+    memcpy(cabecera.magia, MAGIA_SERIE, sizeof(cabecera.magia));
+    for (int c = 0; c < NUM_COLUMNAS_SERIE; c++) {
+        strncpy(cabecera.columnas[c], nombres_columnas_serie[c], TAM_NOMBRE_COLUMNA - 1);
+    }
+    
+    serie.fd = open(ruta, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (serie.fd < 0 || write(serie.fd, &cabecera, sizeof(cabecera)) != (ssize_t)sizeof(cabecera)) {
+        fprintf(stderr, "No se pudo crear la serie '%s'\n", ruta);
+        exit(1);
+    }
+    serie.bytes = sizeof(cabecera);
+    serie.fin_pendientes = &serie.pendientes;
+    serie.activa = 1;
+    pthread_create(&serie.escritor, NULL, escritor_serie, NULL);
+    
+    // Desde un estado restaurado la serie sigue en el próximo múltiplo del intervalo
+    if (modo_eventos_discretos) {
+        proxima_muestra_serie = (clinica->reloj_virtual + intervalo_serie - 1) / intervalo_serie * intervalo_serie;
+    }
+}
+
+void iniciar_muestreador_serie(void) {
+    if (serie.activa) pthread_create(&serie.muestreador, NULL, muestreador_serie, NULL);
+}
+
+// Última muestra, último bloque (aunque esté incompleto) y esperar al escritor
+void cerrar_serie(void) {
+    if (!serie.activa) return;
+    if (modo_eventos_discretos) {
+        muestrear_serie_hasta(clinica->reloj_virtual + 1);
+        proxima_muestra_serie = LONG_MAX;
+    } else {
+        pthread_join(serie.muestreador, NULL);
+    }
+    if (serie.actual) entregar_bloque_serie();
+    
+    pthread_mutex_lock(&serie.mutex);
+    serie.detener = 1;
+    pthread_cond_signal(&serie.hay_bloques);
+    pthread_mutex_unlock(&serie.mutex);
+    pthread_join(serie.escritor, NULL);
+    close(serie.fd);
+    serie.activa = 0;
+    
+    printf("📈 Serie temporal: %ld muestras cada %d s en %ld bytes (%.1f bytes por muestra)\n",
+           serie.muestras, intervalo_serie, serie.bytes,
+           serie.muestras > 0 ? (double)(serie.bytes - sizeof(CabeceraSerie)) / serie.muestras : 0.0);
+}
+
+// Volcar una serie como CSV por la salida estándar (el resumen va a stderr)
+void leer_serie(const char* ruta) {
+    int fd = open(ruta, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(CabeceraSerie)) {
+        fprintf(stderr, "No se pudo leer la serie '%s'\n", ruta);
+        exit(1);
+    }
+    
+    const uint8_t* datos = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (datos == MAP_FAILED) {
+        fprintf(stderr, "No se pudo mapear la serie '%s'\n", ruta);
+        exit(1);
+    }
+    madvise((void*)datos, info.st_size, MADV_SEQUENTIAL);
+    
+    const CabeceraSerie* cabecera = (const CabeceraSerie*)datos;
+    if (memcmp(cabecera->magia, MAGIA_SERIE, 8) != 0 || cabecera->version != VERSION_SERIE ||
+        cabecera->num_columnas != NUM_COLUMNAS_SERIE || cabecera->filas_bloque > FILAS_BLOQUE_SERIE) {
+        fprintf(stderr, "'%s' no es una serie válida de esta versión\n", ruta);
+        exit(1);
+    }
+    
+    BloqueSerie* bloque = malloc(sizeof(BloqueSerie));
+    if (!bloque) {
+        fprintf(stderr, "Sin memoria para leer la serie\n");
+        exit(1);
+    }
+    for (int c = 0; c < NUM_COLUMNAS_SERIE; c++) {
+        printf("%s%.*s", c ? "," : "", TAM_NOMBRE_COLUMNA, cabecera->columnas[c]);
+    }
+    printf("\n");
+    
+    const uint8_t* fin = datos + info.st_size;
+    const uint8_t* p = datos + sizeof(CabeceraSerie);
+    long muestras = 0, bloques = 0;
+    const char* problema = NULL;
+    while (p < fin && !problema) {
+        uint32_t largos[1 + NUM_COLUMNAS_SERIE];
+        if (fin - p < (ptrdiff_t)TAM_CABECERA_BLOQUE_SERIE) {
+            problema = "bloque final cortado";
+            break;
+        }
+        memcpy(largos, p, TAM_CABECERA_BLOQUE_SERIE);
+        p += TAM_CABECERA_BLOQUE_SERIE;
+        if (largos[0] > cabecera->filas_bloque) {
+            problema = "bloque con demasiadas filas";
+            break;
+        }
+        
+        // Cada columna se decodifica sola: suma acumulada de las diferencias
+        for (int c = 0; c < NUM_COLUMNAS_SERIE && !problema; c++) {
+            if ((size_t)(fin - p) < largos[1 + c]) {
+                problema = "bloque final cortado";
+                break;
+            }
+            const uint8_t* fin_columna = p + largos[1 + c];
+            int64_t valor = 0;
+            for (uint32_t f = 0; f < largos[0]; f++) {
+                uint64_t diferencia;
+                p = leer_varint(p, fin_columna, &diferencia);
+                if (!p) {
+                    problema = "columna dañada";
+                    break;
+                }
+                valor += deshacer_zigzag(diferencia);
+                bloque->valores[c][f] = valor;
+            }
+            p = fin_columna;
+        }
+        if (problema) break;
+        
+        for (uint32_t f = 0; f < largos[0]; f++) {
+            for (int c = 0; c < NUM_COLUMNAS_SERIE; c++) {
+                printf("%s%lld", c ? "," : "", (long long)bloque->valores[c][f]);
+            }
+            printf("\n");
+        }
+        muestras += largos[0];
+        bloques++;
+    }
+    
+    fprintf(stderr, "📈 Serie '%s': %ld muestras cada %d s en %ld bloques (%lld bytes)\n",
+            ruta, muestras, cabecera->intervalo, bloques, (long long)info.st_size);
+    if (problema) fprintf(stderr, "⚠️  Lectura interrumpida: %s\n", problema);
+    free(bloque);
+    munmap((void*)datos, info.st_size);
+}
+
+// ============================================================
+// Motor de simulación por eventos discretos
+// ------------------------------------------------------------
+// En lugar de un hilo por agente que duerme, una lista de eventos
+// futuros ordenada por tiempo y un reloj virtual que salta de un
+// evento al siguiente. Una jornada completa se simula tan rápido
+// como permita la CPU, con la misma lógica de llegada, clasificación,
+// atención, gestión de personal y monitoreo que el modo con hilos.
+// ============================================================
+
+static int evento_antes(const Evento* a, const Evento* b) {
+    if (a->tiempo != b->tiempo) return a->tiempo < b->tiempo;
+    return a->secuencia < b->secuencia;
+}
+
+static void insertar_evento(ListaEventos* lista, Evento evento) {
+    if (lista->count == lista->capacidad) {
+        int nueva_capacidad = lista->capacidad ? lista->capacidad * 2 : 64;
+        Evento* nuevos = realloc(lista->eventos, nueva_capacidad * sizeof(Evento));
+        if (!nuevos) {
+            fprintf(stderr, "Sin memoria para la lista de eventos\n");
+            exit(1);
+        }
+        lista->eventos = nuevos;
+        lista->capacidad = nueva_capacidad;
+    }
+    
+    evento.secuencia = lista->siguiente_secuencia++;
+    
+    // Subir el evento hasta su posición en el montículo
+    int i = lista->count++;
+    while (i > 0) {
+        int padre = (i - 1) / 2;
+        if (!evento_antes(&evento, &lista->eventos[padre])) break;
+        lista->eventos[i] = lista->eventos[padre];
+        i = padre;
+    }
+    lista->eventos[i] = evento;
+}
+
+void programar_evento(ListaEventos* lista, long tiempo, TipoEvento tipo, int agente) {
+    insertar_evento(lista, (Evento){ .tiempo = tiempo, .tipo = tipo, .agente = agente });
+}
+
+// Red de clínicas: el evento lleva al paciente derivado en lugar de un agente
+void programar_llegada_derivada(ListaEventos* lista, long tiempo, HandlePaciente paciente) {
+    insertar_evento(lista, (Evento){ .tiempo = tiempo, .tipo = EVENTO_LLEGADA_DERIVADA, .paciente = paciente });
+}
+
+// Bajar 'evento' desde la posición i hasta donde corresponda en el montículo
+static void hundir_evento(ListaEventos* lista, int i, Evento evento) {
+    while (1) {
+        int hijo = 2 * i + 1;
+        if (hijo >= lista->count) break;
+        if (hijo + 1 < lista->count && evento_antes(&lista->eventos[hijo + 1], &lista->eventos[hijo])) {
+            hijo++;
+        }
+        if (!evento_antes(&lista->eventos[hijo], &evento)) break;
+        lista->eventos[i] = lista->eventos[hijo];
+        i = hijo;
+    }
+    lista->eventos[i] = evento;
+}
+
+Evento extraer_evento(ListaEventos* lista) {
+    Evento primero = lista->eventos[0];
+    Evento ultimo = lista->eventos[--lista->count];
+    
+    // Bajar el último evento desde la raíz
+    if (lista->count > 0) hundir_evento(lista, 0, ultimo);
+    
+    return primero;
+}
+
+static void des_despertar_medicos(Cola* cola);
+static void des_admin_tomar_paciente(int i);
+void guardar_instantanea(void);
+static int red_enviar_paciente(PersonalAdmin* admin, HandlePaciente handle);
+static void red_recibir_paciente(HandlePaciente handle);
+
+// Programar la próxima llegada (ninguna si el registro de llegadas se agotó)
+static void des_programar_llegada(void) {
+    long tiempo = tiempo_proxima_llegada(clinica->reloj_virtual);
+    if (tiempo >= 0) programar_evento(&clinica->lista_eventos, tiempo, EVENTO_LLEGADA, 0);
+}
+
+// Al liberarse espacio en una cola, reintentar con los productores detenidos
+static void des_reintentar_bloqueados(void) {
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        if (!clinica->admin_bloqueado[i]) continue;
+        
+        HandlePaciente paciente = clinica->paciente_en_clasificacion[i];
+        Cola* destino = cola_destino(paciente_de(&clinica->arena_pacientes, paciente));
+        if (destino->count >= destino->capacidad) continue;
+        
+        clinica->admin_bloqueado[i] = 0;
+        derivar_paciente(&clinica->personal_admin[i], paciente);
+        des_despertar_medicos(destino);
+        des_admin_tomar_paciente(i);
+    }
+    
+    if (clinica->llegada_bloqueada != HANDLE_NULO && clinica->cola_recepcion.count < clinica->cola_recepcion.capacidad) {
+        HandlePaciente paciente = clinica->llegada_bloqueada;
+        clinica->llegada_bloqueada = HANDLE_NULO;
+        admitir_paciente(paciente);
+        des_programar_llegada();
+    }
+}
+
+// Un admin libre toma el siguiente paciente de recepción (si hay)
+static void des_admin_tomar_paciente(int i) {
+    PersonalAdmin* admin = &clinica->personal_admin[i];
+    if (admin->ocupado || !admin->activo) return;
+    
+    HandlePaciente paciente = intentar_dequeue(&clinica->cola_recepcion);
+    if (paciente == HANDLE_NULO) return;
+    
+    iniciar_clasificacion(admin, paciente);
+    clinica->paciente_en_clasificacion[i] = paciente;
+    
+    programar_evento(&clinica->lista_eventos, clinica->reloj_virtual + duracion_clasificacion(),
+                     EVENTO_FIN_CLASIFICACION, i);
+    
+    if (clinica->llegada_bloqueada != HANDLE_NULO) des_reintentar_bloqueados();
+}
+
+// Algún productor espera lugar en una cola (solo con política bloquear)
+static int des_hay_bloqueados(void) {
+    if (clinica->llegada_bloqueada != HANDLE_NULO) return 1;
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        if (clinica->admin_bloqueado[i]) return 1;
+    }
+    return 0;
+}
+
+// Los admins libres toman pacientes de recepción, en orden de admin, con
+// una sola extracción por lotes. Con una llegada retenida cada extracción
+// puede destrabarla: entonces de a uno
+static void des_admins_tomar_pacientes(void) {
+    int* libres = clinica->libres_lote;
+    int num_libres = 0;
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        PersonalAdmin* admin = &clinica->personal_admin[i];
+        if (!admin->ocupado && admin->activo) libres[num_libres++] = i;
+    }
+    if (num_libres == 0) return;
+    
+    if (clinica->llegada_bloqueada != HANDLE_NULO) {
+        for (int k = 0; k < num_libres; k++) des_admin_tomar_paciente(libres[k]);
+        return;
+    }
+    
+    HandlePaciente* lote = clinica->lote;
+    int n = intentar_dequeue_varios(&clinica->cola_recepcion, lote, num_libres);
+    for (int k = 0; k < n; k++) {
+        int i = libres[k];
+        iniciar_clasificacion(&clinica->personal_admin[i], lote[k]);
+        clinica->paciente_en_clasificacion[i] = lote[k];
+        programar_evento(&clinica->lista_eventos, clinica->reloj_virtual + duracion_clasificacion(),
+                         EVENTO_FIN_CLASIFICACION, i);
+    }
+}
+
+// Un médico libre toma el siguiente paciente de su cola (los abandonos ya se
+// retiraron al vencer su temporizador)
+static void des_medico_tomar_paciente(int i) {
+    Medico* medico = &clinica->medicos[i];
+    if (medico->ocupado || clinica->medico_en_pausa[i] || !medico->activo) return;
+    
+    HandlePaciente paciente = tomar_paciente_compatible(medico);
+    if (paciente != HANDLE_NULO) {
+        iniciar_atencion(medico, paciente);
+        clinica->paciente_en_atencion[i] = paciente;
+        programar_evento(&clinica->lista_eventos, clinica->reloj_virtual + duracion_atencion(),
+                         EVENTO_FIN_ATENCION, i);
+    }
+    
+    des_reintentar_bloqueados();
+}
+
+// Los médicos libres que tienen la cola como propia toman sus pacientes con
+// una sola extracción por lotes, en orden de médico. Con productores
+// bloqueados cada extracción puede destrabarlos: entonces de a uno
+static void des_medicos_propios_tomar(Cola* cola) {
+    int total_medicos = total_medicos_clinica();
+    if (des_hay_bloqueados()) {
+        for (int i = 0; i < total_medicos && cola->count > 0; i++) {
+            Medico* medico = &clinica->medicos[i];
+            if (cola_de_medico(medico) == cola && puede_atender(medico, cola)) {
+                des_medico_tomar_paciente(i);
+            }
+        }
+        return;
+    }
+    
+    int* libres = clinica->libres_lote;
+    int num_libres = 0;
+    for (int i = 0; i < total_medicos; i++) {
+        Medico* medico = &clinica->medicos[i];
+        if (!medico->ocupado && !clinica->medico_en_pausa[i] && medico->activo &&
+            cola_de_medico(medico) == cola && puede_atender(medico, cola)) {
+            libres[num_libres++] = i;
+        }
+    }
+    if (num_libres == 0 || cola->count == 0) return;
+    
+    HandlePaciente* lote = clinica->lote;
+    int n = intentar_dequeue_varios(cola, lote, num_libres);
+    for (int k = 0; k < n; k++) {
+        int i = libres[k];
+        iniciar_atencion(&clinica->medicos[i], lote[k]);
+        clinica->paciente_en_atencion[i] = lote[k];
+        programar_evento(&clinica->lista_eventos, clinica->reloj_virtual + duracion_atencion(),
+                         EVENTO_FIN_ATENCION, i);
+    }
+}
+
+// Ofrecer los pacientes recién encolados a los médicos libres que pueden
+// atender la cola (o la de desvío, si el paciente fue desviado): primero a los
+// que la tienen como propia y después a los demás compatibles
+static void des_despertar_medicos(Cola* cola) {
+    int total_medicos = total_medicos_clinica();
+    for (Cola* c = cola; c; c = (c->desvio != c) ? c->desvio : NULL) {
+        des_medicos_propios_tomar(c);
+        // Los demás, de a uno: cada uno elige entre todas las colas que puede atender
+        for (int i = 0; i < total_medicos && c->count > 0; i++) {
+            Medico* medico = &clinica->medicos[i];
+            if (cola_de_medico(medico) != c && puede_atender(medico, c)) {
+                des_medico_tomar_paciente(i);
+            }
+        }
+        if (c->politica != POLITICA_DESVIAR) break;
+    }
+}
+
+static void des_procesar_evento(const Evento* evento) {
+    switch (evento->tipo) {
+        case EVENTO_LLEGADA: {
+            HandlePaciente nuevo_paciente = crear_paciente();
+            if (nuevo_paciente != HANDLE_NULO &&
+                admitir_paciente(nuevo_paciente) == COLA_LLENA) {
+                // Recepción llena: las llegadas se detienen hasta que haya lugar
+                clinica->llegada_bloqueada = nuevo_paciente;
+            } else {
+                des_programar_llegada();
+            }
+            des_admins_tomar_pacientes();
+            break;
+        }
+        case EVENTO_FIN_CLASIFICACION: {
+            int i = evento->agente;
+            HandlePaciente paciente = clinica->paciente_en_clasificacion[i];
+            Cola* destino = cola_destino(paciente_de(&clinica->arena_pacientes, paciente));
+            registrar_clasificacion(&clinica->personal_admin[i], paciente);
+            if (red_enviar_paciente(&clinica->personal_admin[i], paciente)) {
+                des_admin_tomar_paciente(i);
+                break;
+            }
+            if (derivar_paciente(&clinica->personal_admin[i], paciente) == COLA_LLENA) {
+                clinica->admin_bloqueado[i] = 1;
+                break;
+            }
+            des_despertar_medicos(destino);
+            des_admin_tomar_paciente(i);
+            break;
+        }
+        case EVENTO_FIN_ATENCION: {
+            int i = evento->agente;
+            completar_atencion(&clinica->medicos[i], clinica->paciente_en_atencion[i]);
+            clinica->medico_en_pausa[i] = 1;
+            programar_evento(&clinica->lista_eventos, clinica->reloj_virtual + duracion_pausa(), EVENTO_FIN_PAUSA, i);
+            break;
+        }
+        case EVENTO_FIN_PAUSA: {
+            int i = evento->agente;
+            clinica->medico_en_pausa[i] = 0;
+            des_medico_tomar_paciente(i);
+            break;
+        }
+        case EVENTO_GESTOR_PERSONAL:
+            evaluar_personal(clinica->reloj_virtual);
+            // El personal recién activado toma el trabajo pendiente
+            des_admins_tomar_pacientes();
+            for (int i = 0; i < total_medicos_clinica(); i++) {
+                des_medico_tomar_paciente(i);
+            }
+            programar_evento(&clinica->lista_eventos, clinica->reloj_virtual + 180, EVENTO_GESTOR_PERSONAL, 0);
+            break;
+        case EVENTO_MONITOR:
+            imprimir_estado_sistema();
+            publicar_metricas(0);
+            programar_evento(&clinica->lista_eventos, clinica->reloj_virtual + 300, EVENTO_MONITOR, 0);
+            break;
+        case EVENTO_DESPERTAR_AGENTE:  // Solo lo usa el planificador M:N
+            break;
+        case EVENTO_GUARDAR_ESTADO:
+            guardar_instantanea();
+            break;
+        case EVENTO_LLEGADA_DERIVADA:
+            red_recibir_paciente(evento->paciente);
+            break;
+        case EVENTO_FIN_JORNADA:
+            clinica->jornada_activa = 0;
+            break;
+    }
+}
+
+// Instantánea programada (--guardar-estado ARCHIVO --instante H:MM); solo
+// la clínica principal, las réplicas y el optimizador no guardan estado
+const char* ruta_guardar_estado = NULL;
+long instante_guardar_estado = -1;
+
+void continuar_eventos_discretos(void);
+static void des_avanzar_hasta(long limite);
+static void des_liberar_eventos(void);
+
+// Programar los primeros eventos de una jornada de la clínica actual
+static void des_iniciar_jornada(void) {
+    clinica->reloj_virtual = 0;
+    clinica->jornada_activa = 1;
+    
+    des_programar_llegada();
+    programar_evento(&clinica->lista_eventos, 180, EVENTO_GESTOR_PERSONAL, 0);
+    programar_evento(&clinica->lista_eventos, 300, EVENTO_MONITOR, 0);
+    programar_evento(&clinica->lista_eventos, duracion_jornada, EVENTO_FIN_JORNADA, 0);
+}
+
+// Ejecutar una jornada completa de la clínica actual con el reloj virtual
+// (el generador aleatorio del hilo ya debe estar sembrado)
+void ejecutar_eventos_discretos(void) {
+    des_iniciar_jornada();
+    continuar_eventos_discretos();
+}
+
+// Procesar eventos hasta el fin de la jornada: desde el comienzo o desde el
+// estado que dejó restaurar_instantanea()
+void continuar_eventos_discretos(void) {
+    if (ruta_guardar_estado && clinica == &clinica_principal &&
+        instante_guardar_estado > clinica->reloj_virtual) {
+        programar_evento(&clinica->lista_eventos, instante_guardar_estado, EVENTO_GUARDAR_ESTADO, 0);
+    }
+    
+    des_avanzar_hasta(LONG_MAX);
+    des_liberar_eventos();
+}
+
+// Procesar los eventos anteriores a 'limite' (la red de clínicas avanza a
+// todas las sedes por ventanas de tiempo; una sola clínica, de una vez)
+static void des_avanzar_hasta(long limite) {
+    while (clinica->jornada_activa && simulacion_activa && clinica->lista_eventos.count > 0 &&
+           clinica->lista_eventos.eventos[0].tiempo < limite) {
+        // Las muestras de la serie pendientes ven el estado previo al próximo evento
+        long siguiente = clinica->lista_eventos.eventos[0].tiempo;
+        if (__builtin_expect(siguiente > proxima_muestra_serie, 0) && clinica == &clinica_principal) {
+            muestrear_serie_hasta(siguiente);
+        }
+        
+        long inicio = clinica->latencia_eventos ? nanosegundos_monotonos() : 0;
+        Evento evento = extraer_evento(&clinica->lista_eventos);
+        clinica->reloj_virtual = evento.tiempo;
+        
+        // Los abandonos vencidos hasta este instante liberan lugar en las colas
+        if (avanzar_rueda(&clinica->rueda_abandonos, evento.tiempo, vencer_abandono) > 0) {
+            des_reintentar_bloqueados();
+        }
+        des_procesar_evento(&evento);
+        clinica->eventos_procesados++;
+        if (clinica->latencia_eventos) {
+            anotar_nanosegundos(clinica->latencia_eventos, nanosegundos_monotonos() - inicio);
+        }
+    }
+}
+
+static void des_liberar_eventos(void) {
+    free(clinica->lista_eventos.eventos);
+    clinica->lista_eventos.eventos = NULL;
+    clinica->lista_eventos.count = clinica->lista_eventos.capacidad = 0;
+}
+
+// ============================================================
+// Instantáneas del estado (--guardar-estado / --restaurar-estado)
+// ------------------------------------------------------------
+// Un archivo binario con todo lo que hace falta para seguir una
+// jornada en modo eventos discretos: reloj, lista de eventos futuros,
+// pacientes en curso y el contenido de cada cola, personal, pronósticos,
+// temporizadores de abandono, contadores y el estado del generador
+// aleatorio. Los pacientes se guardan en una tabla y las colas, los
+// temporizadores y el personal los referencian por su índice en ella,
+// así que los handles de la arena no necesitan coincidir al restaurar.
+// Se guardan solo los pacientes vivos: las lápidas y los temporizadores
+// de quienes ya salieron de su cola se descartan.
+//
+// La instantánea se lee una sola vez y cada clínica (también cada réplica
+// con --replicas) se restaura desde la copia en memoria: un estado de media
+// jornada ya calentado se puede bifurcar en muchos experimentos.
+// ============================================================
+
+#define MAGIA_ESTADO "ESTADCLN"
+#define VERSION_ESTADO 2
+#define PACIENTE_NINGUNO UINT32_MAX    // Índice nulo en la tabla de pacientes
+
+typedef struct {
+    char magia[8];
+    uint32_t version;
+    uint32_t tam_contadores;           // Contadores más histogramas: detecta otra compilación
+    uint64_t semilla;
+    uint64_t estado_aleatorio[4];
+    int64_t reloj;
+    int64_t eventos_procesados;
+    uint64_t siguiente_secuencia;
+    int64_t ahora_rueda;
+    int32_t num_admin;
+    int32_t num_medicos_general;
+    int32_t num_enfermeras;
+    int32_t num_especialistas;
+    int32_t admin_activos;
+    int32_t siguiente_id_paciente;
+    int32_t con_llegadas;              // Se tomó con --llegadas
+    uint32_t num_pacientes;
+    uint32_t num_eventos;
+    uint32_t num_temporizadores;
+} CabeceraEstado;
+
+typedef struct {
+    int32_t id;
+    int32_t ocupado;
+    int32_t pacientes_clasificados;
+    int32_t activo;
+    int32_t bloqueado;                 // Conserva al paciente clasificado con la cola llena
+    uint32_t paciente;                 // En clasificación (PACIENTE_NINGUNO si está libre)
+} AdminGuardado;
+
+typedef struct {
+    int32_t id;
+    int32_t tipo;
+    int32_t especialidad;
+    int32_t ocupado;
+    int32_t pacientes_atendidos;
+    int32_t pacientes_ajenos;
+    int32_t activo;
+    int32_t en_pausa;
+    uint32_t paciente;                 // En consulta (PACIENTE_NINGUNO si no atiende)
+} MedicoGuardado;
+
+typedef struct {
+    int64_t tiempo_llegada;
+    int64_t tiempo_clasificacion;
+    int64_t tiempo_atencion;
+    int32_t id;
+    uint8_t estado;
+    uint8_t tipo_atencion;
+    uint8_t especialidad;
+    uint8_t prioridad;
+    uint8_t atendido;
+    uint8_t abandono;
+    uint8_t clasificado;
+    uint8_t reservado;
+} PacienteGuardado;
+
+typedef struct {
+    int32_t max_count;
+    int32_t count;                     // Pacientes que siguen esperando (sin lápidas)
+    int64_t rechazados;
+    int64_t bloqueos;
+    int64_t desviados;
+    int64_t insertados;
+} ColaGuardada;
+
+typedef struct {
+    uint32_t paciente;
+    uint32_t nivel;
+} EntradaGuardada;
+
+typedef struct {
+    uint32_t paciente;
+    int32_t id_paciente;
+    int64_t vencimiento;
+} TemporizadorGuardado;
+
+// Instantánea leída con --restaurar-estado (NULL si no hay)
+const char* ruta_restaurar_estado = NULL;
+static char* datos_estado = NULL;
+static size_t tamano_estado = 0;
+
+// Tabla de pacientes que se está armando al guardar: el índice de cada
+// handle se anota en 'indices' (una entrada por slot de la arena)
+typedef struct {
+    HandlePaciente* handles;
+    uint32_t count;
+    uint32_t* indices;
+} TablaPacientes;
+
+static uint32_t anotar_paciente(TablaPacientes* tabla, HandlePaciente handle) {
+    if (handle == HANDLE_NULO) return PACIENTE_NINGUNO;
+    if (tabla->indices[handle] == PACIENTE_NINGUNO) {
+        tabla->indices[handle] = tabla->count;
+        tabla->handles[tabla->count++] = handle;
+    }
+    return tabla->indices[handle];
+}
+
+// Recorrer la cola en orden de extracción, sin lápidas; 'entradas' puede ser NULL para solo contar
+static int entradas_cola(Cola* cola, TablaPacientes* tabla, EntradaGuardada* entradas) {
+    int n = 0;
+    if (cola->anillo) {
+        AnilloMPMC* anillo = cola->anillo;
+        for (uint64_t pos = anillo->pos_extraccion; pos != anillo->pos_insercion; pos++) {
+            if (entradas) {
+                entradas[n].paciente = anotar_paciente(tabla, anillo->celdas[pos & anillo->mascara].handle);
+                entradas[n].nivel = NUM_PRIORIDADES - 1;
+            }
+            n++;
+        }
+        return n;
+    }
+    for (int nivel = 0; nivel < NUM_PRIORIDADES; nivel++) {
+        NivelPrioridad* niv = &cola->niveles[nivel];
+        SegmentoCola* segmento = niv->primero;
+        int pos = niv->frente;
+        for (int k = 0; k < niv->count; k++) {
+            if (pos == TAM_SEGMENTO_COLA) {
+                segmento = segmento->siguiente;
+                pos = 0;
+            }
+            HandlePaciente handle = segmento->handles[pos++];
+            if (cola->con_abandonos && estado_paciente(cola->arena, handle) == PACIENTE_ABANDONO) continue;
+            if (entradas) {
+                entradas[n].paciente = anotar_paciente(tabla, handle);
+                entradas[n].nivel = nivel;
+            }
+            n++;
+        }
+    }
+    return n;
+}
+
+// Escribir todo el estado de la clínica actual (modo eventos discretos, entre
+// dos eventos). Un error se informa y la jornada sigue
+void guardar_instantanea(void) {
+    ArenaPacientes* arena = &clinica->arena_pacientes;
+    RuedaTemporizadores* rueda = &clinica->rueda_abandonos;
+    Cola* colas[NUM_COLAS_CLINICA];
+    colas_clinica(colas);
+    
+    TablaPacientes tabla = { 0 };
+    size_t slots = (size_t)arena->num_bloques * TAM_BLOQUE_ARENA;
+    tabla.handles = malloc(arena->en_uso * sizeof(HandlePaciente) + 1);
+    tabla.indices = malloc(slots * sizeof(uint32_t));
+    int total_entradas = 0;
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) total_entradas += entradas_cola(colas[c], NULL, NULL);
+    int num_temporizadores = 0;
+    for (int nivel = 0; nivel < NIVELES_RUEDA; nivel++) {
+        for (int i = 0; i < RANURAS_RUEDA; i++) num_temporizadores += rueda->ranuras[nivel][i].count;
+    }
+    EntradaGuardada* entradas = malloc(total_entradas * sizeof(EntradaGuardada) + 1);
+    TemporizadorGuardado* temporizadores = malloc(num_temporizadores * sizeof(TemporizadorGuardado) + 1);
+    int total_medicos = total_medicos_clinica();
+    AdminGuardado* admins = malloc(clinica->personal.num_admin * sizeof(AdminGuardado));
+    MedicoGuardado* medicos = malloc(total_medicos * sizeof(MedicoGuardado) + 1);
+    if (!tabla.handles || !tabla.indices || !entradas || !temporizadores || !admins || !medicos) {
+        fprintf(stderr, "Sin memoria para guardar el estado en '%s'\n", ruta_guardar_estado);
+        free(tabla.handles);
+        free(tabla.indices);
+        free(entradas);
+        free(temporizadores);
+        free(admins);
+        free(medicos);
+        return;
+    }
+    memset(tabla.indices, 0xff, slots * sizeof(uint32_t));
+    
+    // Colas primero: la tabla queda en el orden en que se volverán a encolar
+    ColaGuardada guardadas[NUM_COLAS_CLINICA];
+    int n = 0;
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) {
+        Cola* cola = colas[c];
+        guardadas[c] = (ColaGuardada){ cola->max_count, entradas_cola(cola, &tabla, entradas + n),
+                                       cola->rechazados, cola->bloqueos, cola->desviados, cola->insertados };
+        n += guardadas[c].count;
+    }
+    
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        const PersonalAdmin* admin = &clinica->personal_admin[i];
+        admins[i] = (AdminGuardado){ admin->id, admin->ocupado, admin->pacientes_clasificados, admin->activo,
+                                     clinica->admin_bloqueado[i],
+                                     admin->ocupado ? anotar_paciente(&tabla, clinica->paciente_en_clasificacion[i])
+                                                    : PACIENTE_NINGUNO };
+    }
+    for (int i = 0; i < total_medicos; i++) {
+        const Medico* medico = &clinica->medicos[i];
+        medicos[i] = (MedicoGuardado){ medico->id, medico->tipo, medico->especialidad, medico->ocupado,
+                                       medico->pacientes_atendidos, medico->pacientes_ajenos, medico->activo,
+                                       clinica->medico_en_pausa[i],
+                                       medico->ocupado ? anotar_paciente(&tabla, clinica->paciente_en_atencion[i])
+                                                       : PACIENTE_NINGUNO };
+    }
+    uint32_t llegada_bloqueada = anotar_paciente(&tabla, clinica->llegada_bloqueada);
+    
+    // Temporizadores de pacientes que siguen en una cola de atención
+    int t = 0;
+    for (int nivel = 0; nivel < NIVELES_RUEDA; nivel++) {
+        for (int i = 0; i < RANURAS_RUEDA; i++) {
+            const RanuraRueda* ranura = &rueda->ranuras[nivel][i];
+            for (int k = 0; k < ranura->count; k++) {
+                const TemporizadorAbandono* temporizador = &ranura->entradas[k];
+                const Paciente* paciente = paciente_de(arena, temporizador->handle);
+                uint32_t indice = tabla.indices[temporizador->handle];
+                if (indice == PACIENTE_NINGUNO || paciente->id != temporizador->id_paciente ||
+                    !paciente->cola_espera) continue;
+                temporizadores[t++] = (TemporizadorGuardado){ indice, temporizador->id_paciente,
+                                                              temporizador->vencimiento };
+            }
+        }
+    }
+    
+    CabeceraEstado cabecera = {
+        .version = VERSION_ESTADO, .tam_contadores = sizeof(ContadoresPacientes) + sizeof(HistogramasPacientes),
+        .semilla = semilla_global, .reloj = clinica->reloj_virtual,
+        .eventos_procesados = clinica->eventos_procesados,
+        .siguiente_secuencia = clinica->lista_eventos.siguiente_secuencia,
+        .ahora_rueda = rueda->ahora,
+        .num_admin = clinica->personal.num_admin,
+        .num_medicos_general = clinica->personal.num_medicos_general,
+        .num_enfermeras = clinica->personal.num_enfermeras,
+        .num_especialistas = clinica->personal.num_especialistas,
+        .admin_activos = clinica->admin_activos, .siguiente_id_paciente = clinica->siguiente_id_paciente,
+        .con_llegadas = registro_llegadas.activo, .num_pacientes = tabla.count,
+        .num_eventos = clinica->lista_eventos.count, .num_temporizadores = t
+    };
+    memcpy(cabecera.magia, MAGIA_ESTADO, sizeof(cabecera.magia));
+    memcpy(cabecera.estado_aleatorio, estado_aleatorio, sizeof(cabecera.estado_aleatorio));
+    ContadoresPacientes totales = leer_estadisticas(&clinica->estadisticas);
+    HistogramasPacientes histogramas;
+    leer_histogramas(&clinica->estadisticas, &histogramas);
+    
+    FILE* archivo = fopen(ruta_guardar_estado, "wb");
+    int ok = archivo != NULL;
+#define ESCRIBIR(datos, tam) (ok = ok && fwrite((datos), 1, (tam), archivo) == (size_t)(tam))
+    ESCRIBIR(&cabecera, sizeof(cabecera));
+    ESCRIBIR(admins, clinica->personal.num_admin * sizeof(AdminGuardado));
+    ESCRIBIR(medicos, total_medicos * sizeof(MedicoGuardado));
+    ESCRIBIR(clinica->especialidad_cubierta, sizeof(clinica->especialidad_cubierta));
+    ESCRIBIR(clinica->pronostico, sizeof(clinica->pronostico));
+    ESCRIBIR(&llegada_bloqueada, sizeof(llegada_bloqueada));
+    ESCRIBIR(&clinica->llegadas, sizeof(clinica->llegadas));
+    ESCRIBIR(guardadas, sizeof(guardadas));
+    ESCRIBIR(entradas, total_entradas * sizeof(EntradaGuardada));
+    for (uint32_t i = 0; i < tabla.count && ok; i++) {
+        const Paciente* p = paciente_de(arena, tabla.handles[i]);
+        uint8_t estado = estado_paciente(arena, tabla.handles[i]);
+        PacienteGuardado guardado = { p->tiempo_llegada, p->tiempo_clasificacion, p->tiempo_atencion, p->id,
+                                      estado, p->tipo_atencion, p->especialidad, p->prioridad,
+                                      p->atendido, p->abandono, p->clasificado, 0 };
+        ESCRIBIR(&guardado, sizeof(guardado));
+    }
+    ESCRIBIR(clinica->lista_eventos.eventos, clinica->lista_eventos.count * sizeof(Evento));
+    ESCRIBIR(temporizadores, t * sizeof(TemporizadorGuardado));
+    ESCRIBIR(&totales, sizeof(totales));
+    ESCRIBIR(&histogramas, sizeof(histogramas));
+#undef ESCRIBIR
+    long bytes = ok ? ftell(archivo) : 0;
+    if (archivo && fclose(archivo) != 0) ok = 0;
+    
+    if (ok) {
+        LOG(NIVEL_AVISO, "💾 Estado guardado en '%s' a las %ld:%02ld:%02ld (%u pacientes en curso, %ld bytes)\n",
+            ruta_guardar_estado, clinica->reloj_virtual / 3600, clinica->reloj_virtual % 3600 / 60,
+            clinica->reloj_virtual % 60, tabla.count, bytes);
+    } else {
+        fprintf(stderr, "No se pudo escribir el estado en '%s'\n", ruta_guardar_estado);
+    }
+    
+    free(tabla.handles);
+    free(tabla.indices);
+    free(entradas);
+    free(temporizadores);
+    free(admins);
+    free(medicos);
+}
+
+static const CabeceraEstado* cabecera_estado(void) {
+    return (const CabeceraEstado*)datos_estado;
+}
+
+// Leer la instantánea completa en memoria y validarla; la dotación pasa a
+// ser la guardada (el personal en curso no se puede cambiar a mitad de jornada)
+void cargar_instantanea(const char* ruta) {
+    FILE* archivo = fopen(ruta, "rb");
+    struct stat info;
+    if (!archivo || fstat(fileno(archivo), &info) != 0 || (size_t)info.st_size < sizeof(CabeceraEstado)) {
+        fprintf(stderr, "No se pudo leer el estado '%s'\n", ruta);
+        exit(1);
+    }
+    tamano_estado = info.st_size;
+    datos_estado = malloc(tamano_estado);
+    if (!datos_estado || fread(datos_estado, 1, tamano_estado, archivo) != tamano_estado) {
+        fprintf(stderr, "No se pudo leer el estado '%s'\n", ruta);
+        exit(1);
+    }
+    fclose(archivo);
+    
+    const CabeceraEstado* cabecera = cabecera_estado();
+    if (memcmp(cabecera->magia, MAGIA_ESTADO, 8) != 0 || cabecera->version != VERSION_ESTADO ||
+        cabecera->tam_contadores != sizeof(ContadoresPacientes) + sizeof(HistogramasPacientes) ||
+        cabecera->num_admin < 1 || cabecera->num_admin > MAX_ADMIN || cabecera->num_especialistas < 0 ||
+        cabecera->num_medicos_general < 0 || cabecera->num_enfermeras < 0 ||
+        cabecera->num_medicos_general + cabecera->num_enfermeras + cabecera->num_especialistas > MAX_MEDICOS) {
+        fprintf(stderr, "'%s' no es un estado válido de esta versión\n", ruta);
+        exit(1);
+    }
+    if (cabecera->con_llegadas != registro_llegadas.activo) {
+        fprintf(stderr, "El estado '%s' se guardó %s --llegadas: repetir la misma opción\n",
+                ruta, cabecera->con_llegadas ? "con" : "sin");
+        exit(1);
+    }
+    
+    personal_configurado = (ConfiguracionPersonal){ cabecera->num_admin, cabecera->num_medicos_general,
+                                                    cabecera->num_enfermeras, cabecera->num_especialistas };
+    ruta_restaurar_estado = ruta;
+}
+
+typedef struct {
+    const char* datos;
+    size_t posicion;
+} LectorEstado;
+
+static const void* leer_estado(LectorEstado* lector, size_t tam) {
+    if (tam > tamano_estado - lector->posicion) {
+        fprintf(stderr, "El estado '%s' está truncado\n", ruta_restaurar_estado);
+        exit(1);
+    }
+    const void* datos = lector->datos + lector->posicion;
+    lector->posicion += tam;
+    return datos;
+}
+
+// Handle de un índice de la tabla de pacientes restaurada
+static HandlePaciente handle_guardado(const HandlePaciente* handles, uint32_t num_pacientes, uint32_t indice) {
+    if (indice == PACIENTE_NINGUNO) return HANDLE_NULO;
+    if (indice >= num_pacientes) {
+        fprintf(stderr, "El estado '%s' está dañado\n", ruta_restaurar_estado);
+        exit(1);
+    }
+    return handles[indice];
+}
+
+// Volver a poner al paciente en la cola tal como estaba: sin capacidad ni
+// desborde (la cola puede estar configurada más chica que al guardar)
+static void reponer_en_cola(Cola* cola, int nivel, HandlePaciente handle) {
+    if (cola->anillo) {
+        if (!anillo_insertar(cola->anillo, handle)) {
+            fprintf(stderr, "El estado no entra en el anillo de recepción (usar --anillo o --recepcion-mutex)\n");
+            exit(1);
+        }
+        trazar(TRAZA_ENCOLADO, paciente_de(cola->arena, handle), -1, cola->indice);
+        cola->count++;
+        return;
+    }
+    tomar_mutex(&cola->mutex, &cola->medicion);
+    insertar_en_nivel(cola, nivel, handle);
+    soltar_mutex(&cola->mutex, &cola->medicion);
+}
+
+// Dejar la clínica actual (recién preparada con la dotación guardada) en el
+// estado de la instantánea. Con 'continuar_flujo' el generador aleatorio
+// sigue exactamente donde estaba; si no, conserva la siembra del llamador
+// (otra semilla o el flujo de una réplica) y la jornada se bifurca
+void restaurar_instantanea(int continuar_flujo) {
+    LectorEstado lector = { datos_estado, 0 };
+    const CabeceraEstado* cabecera = leer_estado(&lector, sizeof(CabeceraEstado));
+    int total_medicos = total_medicos_clinica();
+    Cola* colas[NUM_COLAS_CLINICA];
+    colas_clinica(colas);
+    
+    const AdminGuardado* admins = leer_estado(&lector, cabecera->num_admin * sizeof(AdminGuardado));
+    const MedicoGuardado* medicos = leer_estado(&lector, total_medicos * sizeof(MedicoGuardado));
+    memcpy(clinica->especialidad_cubierta, leer_estado(&lector, sizeof(clinica->especialidad_cubierta)),
+           sizeof(clinica->especialidad_cubierta));
+    memcpy(clinica->pronostico, leer_estado(&lector, sizeof(clinica->pronostico)), sizeof(clinica->pronostico));
+    uint32_t llegada_bloqueada = *(const uint32_t*)leer_estado(&lector, sizeof(uint32_t));
+    memcpy(&clinica->llegadas, leer_estado(&lector, sizeof(CursorLlegadas)), sizeof(CursorLlegadas));
+    clinica->llegadas.liberado = 0;
+    if (clinica->llegadas.posicion > registro_llegadas.tamano) {
+        fprintf(stderr, "El estado '%s' se guardó con otro registro de llegadas\n", ruta_restaurar_estado);
+        exit(1);
+    }
+    const ColaGuardada* guardadas = leer_estado(&lector, NUM_COLAS_CLINICA * sizeof(ColaGuardada));
+    long total_entradas = 0;
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) total_entradas += guardadas[c].count;
+    const EntradaGuardada* entradas = leer_estado(&lector, total_entradas * sizeof(EntradaGuardada));
+    const PacienteGuardado* pacientes = leer_estado(&lector, cabecera->num_pacientes * sizeof(PacienteGuardado));
+    const Evento* eventos = leer_estado(&lector, cabecera->num_eventos * sizeof(Evento));
+    const TemporizadorGuardado* temporizadores =
+        leer_estado(&lector, cabecera->num_temporizadores * sizeof(TemporizadorGuardado));
+    const ContadoresPacientes* totales = leer_estado(&lector, sizeof(ContadoresPacientes));
+    const HistogramasPacientes* histogramas = leer_estado(&lector, sizeof(HistogramasPacientes));
+    
+    // Pacientes: slots nuevos de la arena con los datos guardados
+    HandlePaciente* handles = malloc(cabecera->num_pacientes * sizeof(HandlePaciente) + 1);
+    if (!handles) {
+        fprintf(stderr, "Sin memoria para restaurar el estado\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < cabecera->num_pacientes; i++) {
+        const PacienteGuardado* g = &pacientes[i];
+        handles[i] = reservar_paciente(&clinica->arena_pacientes);
+        if (handles[i] == HANDLE_NULO) {
+            fprintf(stderr, "Sin memoria para los pacientes del estado\n");
+            exit(1);
+        }
+        Paciente* p = paciente_de(&clinica->arena_pacientes, handles[i]);
+        p->id = g->id;
+        fijar_estado(&clinica->arena_pacientes, handles[i], g->estado);
+        p->tipo_atencion = g->tipo_atencion;
+        p->especialidad = g->especialidad;
+        p->tiempo_llegada = g->tiempo_llegada;
+        p->tiempo_clasificacion = g->tiempo_clasificacion;
+        p->tiempo_atencion = g->tiempo_atencion;
+        p->prioridad = g->prioridad;
+        p->atendido = g->atendido;
+        p->abandono = g->abandono;
+        p->clasificado = g->clasificado;
+        p->plazo_abandono = PLAZO_NINGUNO;
+    }
+    
+    // Plazos de abandono antes de reponer las colas: van a las columnas de los segmentos
+    for (uint32_t i = 0; i < cabecera->num_temporizadores; i++) {
+        HandlePaciente handle = handle_guardado(handles, cabecera->num_pacientes, temporizadores[i].paciente);
+        Paciente* p = (handle != HANDLE_NULO) ? paciente_de(&clinica->arena_pacientes, handle) : NULL;
+        if (p && p->id == temporizadores[i].id_paciente && temporizadores[i].vencimiento < PLAZO_NINGUNO) {
+            p->plazo_abandono = temporizadores[i].vencimiento;
+        }
+    }
+    
+    // Colas en su orden de extracción; después sus contadores históricos
+    const EntradaGuardada* entrada = entradas;
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) {
+        for (int k = 0; k < guardadas[c].count; k++, entrada++) {
+            int nivel = (entrada->nivel < NUM_PRIORIDADES) ? (int)entrada->nivel : NUM_PRIORIDADES - 1;
+            reponer_en_cola(colas[c], nivel, handle_guardado(handles, cabecera->num_pacientes, entrada->paciente));
+        }
+        colas[c]->max_count = guardadas[c].max_count;
+        colas[c]->rechazados = guardadas[c].rechazados;
+        colas[c]->bloqueos = guardadas[c].bloqueos;
+        colas[c]->desviados = guardadas[c].desviados;
+        colas[c]->insertados = guardadas[c].insertados;
+    }
+    
+    // Personal y lo que tenía entre manos
+    clinica->admin_activos = cabecera->admin_activos;
+    for (int i = 0; i < cabecera->num_admin; i++) {
+        PersonalAdmin* admin = &clinica->personal_admin[i];
+        admin->id = admins[i].id;
+        admin->ocupado = admins[i].ocupado;
+        admin->pacientes_clasificados = admins[i].pacientes_clasificados;
+        admin->activo = admins[i].activo;
+        clinica->admin_bloqueado[i] = admins[i].bloqueado;
+        clinica->paciente_en_clasificacion[i] = handle_guardado(handles, cabecera->num_pacientes, admins[i].paciente);
+    }
+    for (int i = 0; i < total_medicos; i++) {
+        Medico* medico = &clinica->medicos[i];
+        medico->id = medicos[i].id;
+        medico->tipo = medicos[i].tipo;
+        medico->especialidad = medicos[i].especialidad;
+        medico->ocupado = medicos[i].ocupado;
+        medico->pacientes_atendidos = medicos[i].pacientes_atendidos;
+        medico->pacientes_ajenos = medicos[i].pacientes_ajenos;
+        medico->activo = medicos[i].activo;
+        clinica->medico_en_pausa[i] = medicos[i].en_pausa;
+        clinica->paciente_en_atencion[i] = handle_guardado(handles, cabecera->num_pacientes, medicos[i].paciente);
+    }
+    clinica->llegada_bloqueada = handle_guardado(handles, cabecera->num_pacientes, llegada_bloqueada);
+    
+    // Temporizadores de abandono, desde el mismo segundo de la rueda
+    clinica->rueda_abandonos.ahora = cabecera->ahora_rueda;
+    for (uint32_t i = 0; i < cabecera->num_temporizadores; i++) {
+        const TemporizadorGuardado* g = &temporizadores[i];
+        programar_temporizador(&clinica->rueda_abandonos,
+                               (TemporizadorAbandono){ handle_guardado(handles, cabecera->num_pacientes, g->paciente),
+                                                       g->id_paciente, g->vencimiento });
+    }
+    
+    // Eventos futuros. El fin de jornada sigue a --duracion (un experimento
+    // puede alargar o acortar la jornada), así que el montículo se rearma
+    ListaEventos* lista = &clinica->lista_eventos;
+    lista->capacidad = cabecera->num_eventos + 64;
+    lista->eventos = malloc(lista->capacidad * sizeof(Evento));
+    if (!lista->eventos) {
+        fprintf(stderr, "Sin memoria para la lista de eventos\n");
+        exit(1);
+    }
+    memcpy(lista->eventos, eventos, cabecera->num_eventos * sizeof(Evento));
+    lista->count = cabecera->num_eventos;
+    lista->siguiente_secuencia = cabecera->siguiente_secuencia;
+    for (int i = 0; i < lista->count; i++) {
+        if (lista->eventos[i].tipo == EVENTO_FIN_JORNADA) lista->eventos[i].tiempo = duracion_jornada;
+    }
+    for (int i = lista->count / 2 - 1; i >= 0; i--) {
+        hundir_evento(lista, i, lista->eventos[i]);
+    }
+    
+    sumar_contadores(&clinica->estadisticas, totales);
+    sumar_histogramas(&clinica->estadisticas, histogramas);
+    clinica->siguiente_id_paciente = cabecera->siguiente_id_paciente;
+    clinica->eventos_procesados = cabecera->eventos_procesados;
+    clinica->reloj_virtual = cabecera->reloj;
+    clinica->jornada_activa = 1;
+    if (continuar_flujo) memcpy(estado_aleatorio, cabecera->estado_aleatorio, sizeof(estado_aleatorio));
+    
+    free(handles);
+}
+
+// Hora simulada de la instantánea cargada
+long reloj_instantanea(void) {
+    return cabecera_estado()->reloj;
+}
+
+// Semilla con la que se generó la instantánea cargada
+uint64_t semilla_instantanea(void) {
+    return cabecera_estado()->semilla;
+}
+
+// Función para generar reporte final
+// Una fila de percentiles del reporte (se omiten los desgloses sin muestras)
+static void escribir_latencia(FILE* archivo, const char* nombre, const HistogramaLatencia* histograma) {
+    long muestras = muestras_histograma(histograma);
+    if (muestras == 0) return;
+    fprintf(archivo, "  - %s: %.1f / %.1f / %.1f (%ld pacientes)\n", nombre,
+            percentil_latencia(histograma, 0.50) / 60.0, percentil_latencia(histograma, 0.95) / 60.0,
+            percentil_latencia(histograma, 0.99) / 60.0, muestras);
+}
+
+#if INSTRUMENTAR_MUTEX
+static void escribir_medicion_mutex(FILE* archivo, const char* nombre, const MedicionMutex* m) {
+    fprintf(archivo, "- %s: %ld adquisiciones, %ld contendidas (%.2f%%)\n", nombre, m->adquisiciones,
+            m->contendidas, m->adquisiciones > 0 ? 100.0 * m->contendidas / m->adquisiciones : 0.0);
+    if (m->contendidas > 0) {
+        fprintf(archivo, "    Espera: %ld / %ld / %ld ns (promedio %.0f ns)\n",
+                percentil_nanosegundos(&m->espera, 0.50), percentil_nanosegundos(&m->espera, 0.99),
+                m->espera_maxima,
+                (double)m->espera_total / m->contendidas);
+    }
+    long tramos = muestras_nanosegundos(&m->retencion);
+    if (tramos > 0) {
+        // Total estimado: un tramo por adquisición y otro por despertar
+        double promedio = (double)m->retencion_total / tramos;
+        fprintf(archivo, "    Retención: %ld / %ld / %ld ns (promedio %.0f ns, ~%.3f ms en total)\n",
+                percentil_nanosegundos(&m->retencion, 0.50), percentil_nanosegundos(&m->retencion, 0.99),
+                m->retencion_maxima,
+                promedio, promedio * (m->adquisiciones + m->despertares) / 1e6);
+    }
+    if (m->despertares > 0) {
+        fprintf(archivo, "    Despertares: %ld (%ld sin nada que hacer: espurios o robados)\n",
+                m->despertares, m->espurios);
+    }
+}
+
+// Aparte del reporte diario: con la misma semilla la jornada se repite, pero
+// los tiempos y hasta las adquisiciones (print_mutex, hilos) no
+static void generar_reporte_mutex(void) {
+    FILE* archivo = fopen("reporte_mutex.txt", "w");
+    if (!archivo) {
+        printf("Error al crear archivo de reporte\n");
+        return;
+    }
+    
+    const char* nombres_colas[] = { "Recepción", "Médico general", "Enfermería",
+                                    "Cardiología", "Neurología", "Pediatría", "Dermatología" };
+    Cola* colas[NUM_COLAS_CLINICA];
+    colas_clinica(colas);
+    time_t ahora = time(NULL);
+    
+    fprintf(archivo, "CONTENCIÓN DE MUTEX (espera y retención: p50 / p99 / máximo)\n");
+    fprintf(archivo, "Fecha: %s", ctime(&ahora));
+    fprintf(archivo, "Semilla: %llu\n", (unsigned long long)semilla_global);
+    fprintf(archivo, "================================\n\n");
+    for (int i = 0; i < NUM_COLAS_CLINICA; i++) {
+        escribir_medicion_mutex(archivo, nombres_colas[i], &colas[i]->medicion);
+    }
+    escribir_medicion_mutex(archivo, "print_mutex", &medicion_print);
+    escribir_medicion_mutex(archivo, "Estadísticas (shard compartido)", &clinica->estadisticas.medicion_compartido);
+    
+    fclose(archivo);
+    printf("📄 Contención de mutex en 'reporte_mutex.txt'\n");
+}
+#endif
+
+void generar_reporte() {
+    FILE* archivo = fopen("reporte_diario.txt", "w");
+    if (!archivo) {
+        printf("Error al crear archivo de reporte\n");
+        return;
+    }
+    
+    time_t ahora = time(NULL);
+    int duracion_real = ahora - tiempo_inicio_simulacion;
+    int duracion_simulacion = tiempo_simulado();
+    
+    fprintf(archivo, "REPORTE DIARIO DE ATENCIÓN MÉDICA\n");
+    fprintf(archivo, "Fecha: %s", ctime(&ahora));
+    if (modo_eventos_discretos) {
+        fprintf(archivo, "Modo: eventos discretos (reloj virtual)\n");
+    } else {
+        fprintf(archivo, "Factor de velocidad utilizado: x%d\n", SPEED_FACTOR);
+        if (modo_agentes_mn) {
+            fprintf(archivo, "Agentes M:N sobre %d hilos\n", hilos_replicas);
+        }
+    }
+    fprintf(archivo, "Semilla: %llu\n", (unsigned long long)semilla_global);
+    if (ruta_restaurar_estado) {
+        long reloj = reloj_instantanea();
+        fprintf(archivo, "Estado inicial: '%s' (%ld:%02ld:%02ld)\n", ruta_restaurar_estado,
+                reloj / 3600, reloj % 3600 / 60, reloj % 60);
+    }
+    fprintf(archivo, "Duración real: %d segundos (%d:%02d:%02d)\n", 
+            duracion_real, duracion_real/3600, (duracion_real%3600)/60, duracion_real%60);
+    fprintf(archivo, "Duración simulada: %d segundos (%d:%02d:%02d)\n",
+            duracion_simulacion, duracion_simulacion/3600, (duracion_simulacion%3600)/60, duracion_simulacion%60);
+    fprintf(archivo, "================================\n\n");
+    
+    fprintf(archivo, "RESUMEN GENERAL:\n");
+    ContadoresPacientes totales = leer_estadisticas(&clinica->estadisticas);
+    HistogramasPacientes histogramas;
+    leer_histogramas(&clinica->estadisticas, &histogramas);
+    fprintf(archivo, "- Pacientes generados: %ld\n", totales.generados);
+    fprintf(archivo, "- Pacientes clasificados: %ld\n", totales.clasificados);
+    fprintf(archivo, "- Pacientes atendidos: %ld\n", totales.atendidos);
+    fprintf(archivo, "- Pacientes que abandonaron: %ld\n", totales.abandonaron);
+    if (totales.inicios_clasificacion > 0) {
+        fprintf(archivo, "- Espera promedio en recepción: %.1f minutos\n",
+                totales.espera_recepcion / 60.0 / totales.inicios_clasificacion);
+    }
+    if (totales.inicios_atencion > 0) {
+        fprintf(archivo, "- Espera promedio por médico: %.1f minutos\n",
+                totales.espera_atencion / 60.0 / totales.inicios_atencion);
+        fprintf(archivo, "- Espera total (llegada a consulta) p50/p95: %.0f / %.0f minutos\n",
+                percentil_espera(&histogramas, 0.50), percentil_espera(&histogramas, 0.95));
+    }
+    
+    // Calcular no contabilizados (en recepción)
+    clinica->total_no_contabilizados = clinica->cola_recepcion.count;
+    fprintf(archivo, "- Pacientes no contabilizados (en recepción): %d\n", clinica->total_no_contabilizados);
+    
+    // Pacientes sin atención (clasificados pero no atendidos)
+    int sin_atencion = (clinica->cola_medico_general.count + clinica->cola_enfermeria.count);
+    for (int i = 0; i < 4; i++) {
+        sin_atencion += clinica->cola_especialista[i].count;
+    }
+    fprintf(archivo, "- Pacientes sin atención (clasificados, no atendidos): %d\n", sin_atencion);
+    
+    // Pacientes perdidos por colas llenas (modo acotado)
+    Cola* colas[] = { &clinica->cola_recepcion, &clinica->cola_medico_general, &clinica->cola_enfermeria,
+                      &clinica->cola_especialista[0], &clinica->cola_especialista[1],
+                      &clinica->cola_especialista[2], &clinica->cola_especialista[3] };
+    const char* nombres_colas[] = { "Recepción", "Médico general", "Enfermería",
+                                    "Cardiología", "Neurología", "Pediatría", "Dermatología" };
+    long total_rechazados = 0;
+    for (int i = 0; i < 7; i++) {
+        total_rechazados += colas[i]->rechazados;
+    }
+    fprintf(archivo, "- Pacientes rechazados por colas llenas: %ld\n\n", total_rechazados);
+    
+    // Eficiencia del sistema
+    if (totales.generados > 0) {
+        float eficiencia = ((float)totales.atendidos / totales.generados) * 100;
+        fprintf(archivo, "- Eficiencia del sistema: %.2f%%\n\n", eficiencia);
+    }
+    
+    fprintf(archivo, "PERSONAL ADMINISTRATIVO:\n");
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        fprintf(archivo, "- Admin %d: %d pacientes clasificados %s\n", 
+                clinica->personal_admin[i].id, clinica->personal_admin[i].pacientes_clasificados,
+                (i < clinica->admin_activos) ? "(activo)" : "(inactivo al final)");
+    }
+    
+    fprintf(archivo, "\nPERSONAL MÉDICO:\n");
+    for (int i = 0; i < clinica->personal.num_medicos_general; i++) {
+        fprintf(archivo, "- Médico General %d: %d pacientes atendidos (%d de otras colas)%s\n", 
+                clinica->medicos[i].id, clinica->medicos[i].pacientes_atendidos,
+                clinica->medicos[i].pacientes_ajenos,
+                clinica->medicos[i].activo ? "" : " (inactivo al final)");
+    }
+    
+    for (int i = 0; i < clinica->personal.num_enfermeras; i++) {
+        int idx = clinica->personal.num_medicos_general + i;
+        fprintf(archivo, "- Enfermera %d: %d pacientes atendidos (%d de otras colas)%s\n", 
+                clinica->medicos[idx].id, clinica->medicos[idx].pacientes_atendidos,
+                clinica->medicos[idx].pacientes_ajenos,
+                clinica->medicos[idx].activo ? "" : " (inactivo al final)");
+    }
+    
+    const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
+    for (int i = 0; i < clinica->personal.num_especialistas; i++) {
+        int idx = clinica->personal.num_medicos_general + clinica->personal.num_enfermeras + i;
+        fprintf(archivo, "- Especialista %s %d: %d pacientes atendidos (%d de otras colas)%s\n", 
+                especialidades[clinica->medicos[idx].especialidad], clinica->medicos[idx].id,
+                clinica->medicos[idx].pacientes_atendidos, clinica->medicos[idx].pacientes_ajenos,
+                clinica->medicos[idx].activo ? "" : " (inactivo al final)");
+    }
+    for (int i = 0; i < 4; i++) {
+        if (!clinica->especialidad_cubierta[i]) {
+            fprintf(archivo, "- Sin especialista de %s: pacientes derivados a medicina general\n",
+                    especialidades[i]);
+        }
+    }
+    
+    fprintf(archivo, "\nLATENCIAS POR TRAMO (minutos, p50 / p95 / p99):\n");
+    const char* tramos[] = { "Recepción (llegada a clasificación)",
+                             "Espera de médico (clasificación a consulta)",
+                             "Consulta" };
+    const char* tipos[] = { "General", "Enfermería", "Especialidad" };
+    for (int t = 0; t < NUM_TRAMOS; t++) {
+        fprintf(archivo, "%s:\n", tramos[t]);
+        HistogramaLatencia total = latencia_total(&histogramas, t);
+        escribir_latencia(archivo, "Total", &total);
+        for (int i = 0; i < 3; i++) {
+            escribir_latencia(archivo, tipos[i], &histogramas.latencia_tipo[t][i]);
+        }
+        for (int i = 0; i < 4; i++) {
+            escribir_latencia(archivo, especialidades[i], &histogramas.latencia_especialidad[t][i]);
+        }
+        for (int i = 0; i < 5; i++) {
+            char prioridad[16];
+            snprintf(prioridad, sizeof(prioridad), "Prioridad %d", i + 1);
+            escribir_latencia(archivo, prioridad, &histogramas.latencia_prioridad[t][i]);
+        }
+    }
+    
+    fprintf(archivo, "\nCONTROL DE DESBORDE DE COLAS:\n");
+    if (capacidad_colas > 0) {
+        const char* politicas[] = { "bloquear", "rechazar", "desviar" };
+        fprintf(archivo, "- Capacidad por cola: %d pacientes (política: %s)\n",
+                capacidad_colas, politicas[politica_desborde]);
+    } else {
+        fprintf(archivo, "- Colas sin límite de capacidad\n");
+    }
+    for (int i = 0; i < 7; i++) {
+        fprintf(archivo, "- %s: máximo %d en cola, %ld rechazados, %ld bloqueos, %ld desviados\n",
+                nombres_colas[i], colas[i]->max_count, colas[i]->rechazados,
+                colas[i]->bloqueos, colas[i]->desviados);
+    }
+    
+    fprintf(archivo, "\nCOLAS AL FINAL DE LA JORNADA:\n");
+    fprintf(archivo, "- En recepción: %d pacientes\n", clinica->cola_recepcion.count);
+    fprintf(archivo, "- Esperando médico general: %d pacientes\n", clinica->cola_medico_general.count);
+    fprintf(archivo, "- Esperando enfermería: %d pacientes\n", clinica->cola_enfermeria.count);
+    for (int i = 0; i < 4; i++) {
+        fprintf(archivo, "- Esperando %s: %d pacientes\n", especialidades[i], clinica->cola_especialista[i].count);
+    }
+    
+    fclose(archivo);
+    printf("\n📄 Reporte generado en 'reporte_diario.txt'\n");
+#if INSTRUMENTAR_MUTEX
+    generar_reporte_mutex();
+#endif
+}
+
+// Preparar una clínica vacía con la dotación indicada y la configuración global de colas
+void preparar_clinica(Clinica *c, const ConfiguracionPersonal *personal) {
+    // Todo en cero salvo los shards de estadísticas, que se limpian al reservarlos
+    memset(c, 0, offsetof(Clinica, estadisticas.shards));
+    memset(&c->estadisticas.num_shards, 0, sizeof(*c) - offsetof(Clinica, estadisticas.num_shards));
+    c->personal = *personal;
+    
+    // El personal se reserva con la dotación pedida: una clínica de miles de
+    // médicos no agranda las réplicas ni las sedes de dotación chica
+    int num_admin = personal->num_admin;
+    int num_medicos = personal->num_medicos_general + personal->num_enfermeras + personal->num_especialistas;
+    int mayor = (num_admin > num_medicos) ? num_admin : num_medicos;
+    if (posix_memalign((void**)&c->personal_admin, TAM_LINEA_CACHE, (num_admin + 1) * sizeof(PersonalAdmin)) != 0 ||
+        posix_memalign((void**)&c->medicos, TAM_LINEA_CACHE, (num_medicos + 1) * sizeof(Medico)) != 0 ||
+        !(c->paciente_en_clasificacion = calloc(num_admin + 1, sizeof(HandlePaciente))) ||
+        !(c->admin_bloqueado = calloc(num_admin + 1, sizeof(int))) ||
+        !(c->paciente_en_atencion = calloc(num_medicos + 1, sizeof(HandlePaciente))) ||
+        !(c->medico_en_pausa = calloc(num_medicos + 1, sizeof(int))) ||
+        !(c->libres_lote = malloc((mayor + 1) * sizeof(int))) ||
+        !(c->lote = malloc((mayor + 1) * sizeof(HandlePaciente)))) {
+        fprintf(stderr, "Sin memoria para el personal de la clínica\n");
+        exit(1);
+    }
+    memset(c->personal_admin, 0, num_admin * sizeof(PersonalAdmin));
+    memset(c->medicos, 0, num_medicos * sizeof(Medico));
+    
+    pthread_mutex_init(&c->pool_segmentos.mutex, NULL);
+    pthread_mutex_init(&c->estadisticas.mutex_compartido, NULL);
+    c->llegada_bloqueada = HANDLE_NULO;
+    
+    init_arena(&c->arena_pacientes, TAM_BLOQUE_ARENA);
+    init_cola(&c->cola_recepcion, &c->pool_segmentos, &c->arena_pacientes);
+    init_cola(&c->cola_medico_general, &c->pool_segmentos, &c->arena_pacientes);
+    init_cola(&c->cola_enfermeria, &c->pool_segmentos, &c->arena_pacientes);
+    for (int i = 0; i < 4; i++) {
+        init_cola(&c->cola_especialista[i], &c->pool_segmentos, &c->arena_pacientes);
+        c->cola_especialista[i].indice = 3 + i;
+    }
+    c->cola_medico_general.indice = 1;
+    c->cola_enfermeria.indice = 2;
+    
+    // Los médicos pueden tomar pacientes de cualquier cola compatible: toda
+    // inserción en una cola de atención los despierta
+    init_contador_eventos(&c->hay_trabajo);
+    init_contador_eventos(&c->hay_recepcion);
+    init_contador_eventos(&c->cambio_personal);
+    c->cola_recepcion.aviso = &c->hay_recepcion;
+    c->cola_medico_general.aviso = &c->hay_trabajo;
+    c->cola_enfermeria.aviso = &c->hay_trabajo;
+    for (int i = 0; i < 4; i++) {
+        c->cola_especialista[i].aviso = &c->hay_trabajo;
+    }
+    
+    // Los pacientes que pierden la paciencia se retiran de las colas de
+    // atención al vencer su temporizador, sin recorrerlas
+    init_rueda(&c->rueda_abandonos);
+    c->cola_medico_general.con_abandonos = 1;
+    c->cola_enfermeria.con_abandonos = 1;
+    for (int i = 0; i < 4; i++) {
+        c->cola_especialista[i].con_abandonos = 1;
+    }
+    
+    // Recepción es FIFO pura con varios productores y consumidores: anillo sin
+    // bloqueo, con lugar al menos para la capacidad configurada
+    if (recepcion_sin_bloqueo) {
+        uint64_t celdas = 1;
+        while (celdas < celdas_anillo_recepcion || celdas < (uint64_t)capacidad_colas) celdas <<= 1;
+        activar_anillo_cola(&c->cola_recepcion, celdas);
+    }
+    
+    // Modo acotado: enfermería y especialidades desvían hacia medicina general
+    if (capacidad_colas > 0) {
+        configurar_limite_cola(&c->cola_recepcion, capacidad_colas, politica_desborde, NULL);
+        configurar_limite_cola(&c->cola_medico_general, capacidad_colas, politica_desborde, NULL);
+        configurar_limite_cola(&c->cola_enfermeria, capacidad_colas, politica_desborde,
+                               &c->cola_medico_general);
+        for (int i = 0; i < 4; i++) {
+            configurar_limite_cola(&c->cola_especialista[i], capacidad_colas, politica_desborde,
+                                   &c->cola_medico_general);
+        }
+    }
+}
+
+// Liberar toda la memoria de una clínica (no debe quedar ningún hilo usándola)
+void liberar_clinica(Clinica *c) {
+    destruir_cola(&c->cola_recepcion);
+    destruir_cola(&c->cola_medico_general);
+    destruir_cola(&c->cola_enfermeria);
+    for (int i = 0; i < 4; i++) {
+        destruir_cola(&c->cola_especialista[i]);
+    }
+    destruir_pool_segmentos(&c->pool_segmentos);
+    destruir_arena(&c->arena_pacientes);
+    destruir_rueda(&c->rueda_abandonos);
+    free(c->lista_eventos.eventos);
+    free(c->personal_admin);
+    free(c->medicos);
+    free(c->paciente_en_clasificacion);
+    free(c->admin_bloqueado);
+    free(c->paciente_en_atencion);
+    free(c->medico_en_pausa);
+    free(c->libres_lote);
+    free(c->lote);
+    pthread_mutex_destroy(&c->estadisticas.mutex_compartido);
+}
+
+// Hacer que el hilo actual opere sobre la clínica indicada
+void usar_clinica(Clinica *c) {
+    clinica = c;
+    reiniciar_shard_hilo();
+}
+
+// Inicializar personal administrativo y médico de la clínica actual (sin crear hilos)
+void inicializar_personal(void) {
+    clinica->admin_activos = (admin_activos_inicial < clinica->personal.num_admin) ?
+                             admin_activos_inicial : clinica->personal.num_admin;
+    
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        clinica->personal_admin[i].id = i + 1;
+        clinica->personal_admin[i].ocupado = 0;
+        clinica->personal_admin[i].pacientes_clasificados = 0;
+        clinica->personal_admin[i].activo = (i < clinica->admin_activos);
+    }
+    
+    // Médicos generales
+    for (int i = 0; i < clinica->personal.num_medicos_general; i++) {
+        clinica->medicos[i].id = i + 1;
+        clinica->medicos[i].tipo = ATENCION_GENERAL;
+        clinica->medicos[i].ocupado = 0;
+        clinica->medicos[i].pacientes_atendidos = 0;
+        clinica->medicos[i].pacientes_ajenos = 0;
+        clinica->medicos[i].activo = 1;
+    }
+    
+    // Enfermeras
+    for (int i = 0; i < clinica->personal.num_enfermeras; i++) {
+        int idx = clinica->personal.num_medicos_general + i;
+        clinica->medicos[idx].id = i + 1;
+        clinica->medicos[idx].tipo = ATENCION_ENFERMERIA;
+        clinica->medicos[idx].ocupado = 0;
+        clinica->medicos[idx].pacientes_atendidos = 0;
+        clinica->medicos[idx].pacientes_ajenos = 0;
+        clinica->medicos[idx].activo = 1;
+    }
+    
+    // Especialistas con especialidades repetidas para mayor rapidez
+    for (int i = 0; i < clinica->personal.num_especialistas; i++) {
+        int idx = clinica->personal.num_medicos_general + clinica->personal.num_enfermeras + i;
+        clinica->medicos[idx].id = i + 1;
+        clinica->medicos[idx].tipo = ATENCION_ESPECIALIDAD;
+        // Permitir especialidades repetidas (enunciado: "mayor rapidez")
+        clinica->medicos[idx].especialidad = aleatorio() % 4; // Aleatorio, pueden repetirse
+        clinica->medicos[idx].ocupado = 0;
+        clinica->medicos[idx].pacientes_atendidos = 0;
+        clinica->medicos[idx].pacientes_ajenos = 0;
+        clinica->medicos[idx].activo = 1;
+        
+        const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
+        LOG(NIVEL_AVISO, "Especialista %d: %s\n", clinica->medicos[idx].id,
+            especialidades[clinica->medicos[idx].especialidad]);
+        clinica->especialidad_cubierta[clinica->medicos[idx].especialidad] = 1;
+    }
+    
+    // Especialidades sin nadie que las atienda: derivar sus pacientes a medicina general
+    const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
+    for (int i = 0; i < 4; i++) {
+        if (!clinica->especialidad_cubierta[i]) {
+            LOG(NIVEL_AVISO, "⚠️  Sin especialista de %s: sus pacientes se derivan a medicina general\n",
+                especialidades[i]);
+        }
+    }
+}
+
+// ============================================================
+// Planificador M:N de agentes (--mn)
+// ------------------------------------------------------------
+// En el modo con hilos cada admin y cada médico tiene un hilo propio
+// que pasa casi toda su vida dormido o bloqueado. Con --mn los agentes
+// son máquinas de estado reanudables que corren sobre un pool fijo de
+// hilos (uno por núcleo o --hilos M): cada paso hace su trabajo sin
+// bloquear y termina pidiendo un despertar al temporizador compartido
+// o estacionándose hasta que llegue trabajo a su cola. El costo por
+// agente es una estructura, no un hilo del sistema.
+// ============================================================
+
+typedef enum {
+    AGENTE_GENERADOR,
+    AGENTE_ADMIN,
+    AGENTE_MEDICO
+} TipoAgente;
+
+typedef enum {
+    FASE_INICIO,               // Primer paso del agente
+    FASE_BUSCAR,               // Generador: nueva llegada; admin/médico: tomar paciente
+    FASE_FIN_TAREA,            // Termina la clasificación o la consulta en curso
+    FASE_REINTENTAR_ENCOLADO   // La cola destino estaba llena: reintentar con el mismo paciente
+} FaseAgente;
+
+typedef struct Agente {
+    TipoAgente tipo;
+    int indice;                // En personal_admin o medicos
+    FaseAgente fase;
+    HandlePaciente paciente;   // Paciente en curso (clasificación, consulta o reintento)
+    uint64_t estado_aleatorio[4]; // Flujo propio: el agente cambia de hilo entre pasos
+    struct Agente* siguiente;  // Enlace en la lista de listos o de estacionados
+} Agente;
+
+// Los agentes sin trabajo se estacionan en la lista de su propia cola (los
+// admins en la de recepción, cada médico en la de cola_de_medico) y los que
+// el gestor desactivó en una aparte. Todos los de una lista pueden atender
+// las mismas colas, así que una inserción despierta a uno solo, y cada lista
+// tiene su propio candado: las inserciones en colas distintas no se cruzan
+#define LISTA_ACTIVACION NUM_COLAS_CLINICA
+#define NUM_LISTAS_ESPERA (NUM_COLAS_CLINICA + 1)
+
+typedef struct {
+    pthread_mutex_t mutex;     // Protege la lista; 'primero' se lee sin él para saltear las vacías
+    Agente* primero;
+    uint32_t epoca;            // Avanza con cada inserción que puede despertar a uno de la lista
+} __attribute__((aligned(TAM_LINEA_CACHE))) ListaEspera;
+
+typedef struct {
+    Agente* agentes;
+    int num_agentes;
+    
+    pthread_mutex_t mutex;     // Protege listos y temporizadores
+    pthread_cond_t hay_listos;
+    pthread_cond_t cambio_temporizadores;
+    Agente* listos_primero;
+    Agente* listos_ultimo;
+    ListaEspera esperas[NUM_LISTAS_ESPERA];
+    // Por cola, las listas que una inserción puede despertar: la de la cola
+    // misma primero y después las de quienes la atienden como cola ajena
+    int avisos[NUM_COLAS_CLINICA][NUM_COLAS_CLINICA];
+    int num_avisos[NUM_COLAS_CLINICA];
+    ListaEventos temporizadores; // Despertares pendientes (milisegundos de CLOCK_MONOTONIC)
+    
+    pthread_t* trabajadores;
+    int num_trabajadores;
+    pthread_t hilo_temporizador;
+} PlanificadorAgentes;
+
+static PlanificadorAgentes planificador;
+
+// Hilos del pool de réplicas o de agentes: --hilos M, o uno por núcleo
+static int hilos_configurados(void) {
+    if (hilos_replicas <= 0) {
+        long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+        hilos_replicas = (nucleos > 0) ? (int)nucleos : 1;
+    }
+    return hilos_replicas;
+}
+
+static long milisegundos_monotonos(void) {
+    struct timespec ahora;
+    clock_gettime(CLOCK_MONOTONIC, &ahora);
+    return ahora.tv_sec * 1000L + ahora.tv_nsec / 1000000;
+}
+
+// Requiere tener tomado planificador.mutex
+static void encolar_listo(Agente* agente) {
+    agente->siguiente = NULL;
+    if (planificador.listos_ultimo) {
+        planificador.listos_ultimo->siguiente = agente;
+    } else {
+        planificador.listos_primero = agente;
+    }
+    planificador.listos_ultimo = agente;
+    pthread_cond_signal(&planificador.hay_listos);
+}
+
+// Terminar el paso pidiendo un despertar dentro de 'segundos' de simulación
+static void agente_dormir(Agente* agente, int segundos) {
+    long vencimiento = milisegundos_monotonos() + segundos * 1000L / SPEED_FACTOR;
+    
+    pthread_mutex_lock(&planificador.mutex);
+    programar_evento(&planificador.temporizadores, vencimiento, EVENTO_DESPERTAR_AGENTE,
+                     agente - planificador.agentes);
+    // Si es el nuevo primero, el temporizador debe acortar su espera
+    if (planificador.temporizadores.eventos[0].agente == agente - planificador.agentes) {
+        pthread_cond_signal(&planificador.cambio_temporizadores);
+    }
+    pthread_mutex_unlock(&planificador.mutex);
+}
+
+static void despertar_agente(Agente* agente) {
+    pthread_mutex_lock(&planificador.mutex);
+    encolar_listo(agente);
+    pthread_mutex_unlock(&planificador.mutex);
+}
+
+// Terminar el paso estacionado hasta la próxima inserción relevante. 'epoca'
+// se leyó antes de buscar trabajo: si cambió, la búsqueda pudo perderse una
+// inserción y el agente vuelve directo a la lista de listos. El agente se
+// publica en la lista antes de releer la época (y el aviso avanza la época
+// antes de mirar la lista), así que una inserción o ve al agente o la ve él
+static void agente_estacionar(Agente* agente, int lista, uint32_t epoca) {
+    ListaEspera* espera = &planificador.esperas[lista];
+    
+    pthread_mutex_lock(&espera->mutex);
+    agente->siguiente = espera->primero;
+    __atomic_store_n(&espera->primero, agente, __ATOMIC_SEQ_CST);
+    int perdida = (__atomic_load_n(&espera->epoca, __ATOMIC_SEQ_CST) != epoca);
+    if (perdida) __atomic_store_n(&espera->primero, agente->siguiente, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&espera->mutex);
+    
+    if (perdida) despertar_agente(agente);
+}
+
+static int agente_activo(const Agente* agente) {
+    const int* activo = (agente->tipo == AGENTE_ADMIN) ? &clinica->personal_admin[agente->indice].activo
+                                                       : &clinica->medicos[agente->indice].activo;
+    return __atomic_load_n(activo, __ATOMIC_RELAXED);
+}
+
+// Sacar de la lista al primer agente activo; los desactivados mientras
+// esperaban no cuentan (despertarlos no tomaría al paciente) y quedan hasta
+// el aviso de cambio de personal
+static Agente* sacar_estacionado(ListaEspera* espera) {
+    if (!__atomic_load_n(&espera->primero, __ATOMIC_SEQ_CST)) return NULL;
+    
+    pthread_mutex_lock(&espera->mutex);
+    Agente** enlace = &espera->primero;
+    while (*enlace && !agente_activo(*enlace)) enlace = &(*enlace)->siguiente;
+    Agente* agente = *enlace;
+    if (agente) __atomic_store_n(enlace, agente->siguiente, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&espera->mutex);
+    return agente;
+}
+
+// Llamado tras insertar 'cuantos' pacientes en una cola: despierta a lo sumo
+// un agente por paciente, empezando por los que tienen la cola como propia
+static void mn_aviso_insercion(Cola* cola, int cuantos) {
+    const int* avisos = planificador.avisos[cola->indice];
+    int num_avisos = planificador.num_avisos[cola->indice];
+    
+    for (int i = 0; i < num_avisos; i++) {
+        __atomic_add_fetch(&planificador.esperas[avisos[i]].epoca, 1, __ATOMIC_SEQ_CST);
+    }
+    for (int i = 0; i < num_avisos && cuantos > 0; i++) {
+        Agente* agente;
+        while (cuantos > 0 && (agente = sacar_estacionado(&planificador.esperas[avisos[i]]))) {
+            despertar_agente(agente);
+            cuantos--;
+        }
+    }
+}
+
+// Llamado cuando el gestor cambia el personal activo: todos los estacionados
+// vuelven a listos y revisan su estado (los inactivos se estacionan otra vez)
+static void mn_aviso_cambio_personal(void) {
+    for (int lista = 0; lista < NUM_LISTAS_ESPERA; lista++) {
+        __atomic_add_fetch(&planificador.esperas[lista].epoca, 1, __ATOMIC_SEQ_CST);
+    }
+    for (int lista = 0; lista < NUM_LISTAS_ESPERA; lista++) {
+        ListaEspera* espera = &planificador.esperas[lista];
+        pthread_mutex_lock(&espera->mutex);
+        Agente* agentes = espera->primero;
+        __atomic_store_n(&espera->primero, NULL, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&espera->mutex);
+        
+        pthread_mutex_lock(&planificador.mutex);
+        while (agentes) {
+            Agente* agente = agentes;
+            agentes = agente->siguiente;
+            encolar_listo(agente);
+        }
+        pthread_mutex_unlock(&planificador.mutex);
+    }
+}
+
+static void paso_generador(Agente* agente) {
+    switch (agente->fase) {
+        case FASE_INICIO:
+            break;
+        case FASE_BUSCAR:
+            agente->paciente = crear_paciente();
+            if (agente->paciente == HANDLE_NULO) break;
+            /* fallthrough */
+        case FASE_REINTENTAR_ENCOLADO:
+            if (admitir_paciente(agente->paciente) == COLA_LLENA) {
+                // Recepción llena: las llegadas se detienen hasta que haya lugar
+                agente->fase = FASE_REINTENTAR_ENCOLADO;
+                agente_dormir(agente, 1);
+                return;
+            }
+            break;
+        case FASE_FIN_TAREA:
+            break;
+    }
+    // Sin reprogramarse el agente termina: el registro de llegadas se agotó
+    long llegada = tiempo_proxima_llegada(clinica->llegadas.reloj);
+    if (llegada < 0) return;
+    int espera = llegada - clinica->llegadas.reloj;
+    clinica->llegadas.reloj = llegada;
+    agente->fase = FASE_BUSCAR;
+    agente_dormir(agente, espera);
+}
+
+static void paso_admin(Agente* agente) {
+    PersonalAdmin* admin = &clinica->personal_admin[agente->indice];
+    
+    switch (agente->fase) {
+        case FASE_INICIO:
+        case FASE_BUSCAR: {
+            uint32_t epoca = __atomic_load_n(&planificador.esperas[LISTA_ACTIVACION].epoca, __ATOMIC_SEQ_CST);
+            if (!__atomic_load_n(&admin->activo, __ATOMIC_ACQUIRE)) {
+                agente->fase = FASE_BUSCAR;
+                agente_estacionar(agente, LISTA_ACTIVACION, epoca);
+                return;
+            }
+            int lista = clinica->cola_recepcion.indice;
+            epoca = __atomic_load_n(&planificador.esperas[lista].epoca, __ATOMIC_SEQ_CST);
+            agente->paciente = intentar_dequeue(&clinica->cola_recepcion);
+            if (agente->paciente == HANDLE_NULO) {
+                agente->fase = FASE_BUSCAR;
+                agente_estacionar(agente, lista, epoca);
+                return;
+            }
+            iniciar_clasificacion(admin, agente->paciente);
+            agente->fase = FASE_FIN_TAREA;
+            agente_dormir(agente, duracion_clasificacion());
+            return;
+        }
+        case FASE_FIN_TAREA:
+            if (completar_clasificacion(admin, agente->paciente) == COLA_LLENA) break;
+            agente->fase = FASE_BUSCAR;
+            paso_admin(agente);
+            return;
+        case FASE_REINTENTAR_ENCOLADO:
+            if (derivar_paciente(admin, agente->paciente) == COLA_LLENA) break;
+            agente->fase = FASE_BUSCAR;
+            paso_admin(agente);
+            return;
+    }
+    
+    // Cola destino llena: el admin sigue con el paciente y reintenta en un segundo
+    agente->fase = FASE_REINTENTAR_ENCOLADO;
+    agente_dormir(agente, 1);
+}
+
+static void paso_medico(Agente* agente) {
+    Medico* medico = &clinica->medicos[agente->indice];
+    
+    if (agente->fase == FASE_FIN_TAREA) {
+        completar_atencion(medico, agente->paciente);
+        // Pausa entre pacientes; al despertar vuelve a buscar
+        agente->fase = FASE_BUSCAR;
+        agente_dormir(agente, duracion_pausa());
+        return;
+    }
+    
+    uint32_t epoca = __atomic_load_n(&planificador.esperas[LISTA_ACTIVACION].epoca, __ATOMIC_SEQ_CST);
+    if (!__atomic_load_n(&medico->activo, __ATOMIC_ACQUIRE)) {
+        agente->fase = FASE_BUSCAR;
+        agente_estacionar(agente, LISTA_ACTIVACION, epoca);
+        return;
+    }
+    
+    // Su propia cola primero; si está vacía, trabajo de otra cola compatible.
+    // La época de su lista avanza con inserciones en cualquiera de ellas
+    int lista = cola_de_medico(medico)->indice;
+    epoca = __atomic_load_n(&planificador.esperas[lista].epoca, __ATOMIC_SEQ_CST);
+    agente->paciente = tomar_paciente_compatible(medico);
+    if (agente->paciente == HANDLE_NULO) {
+        agente->fase = FASE_BUSCAR;
+        agente_estacionar(agente, lista, epoca);
+        return;
+    }
+    iniciar_atencion(medico, agente->paciente);
+    agente->fase = FASE_FIN_TAREA;
+    agente_dormir(agente, duracion_atencion());
+}
+
+// Ejecutar un paso con el flujo aleatorio del agente cargado en el hilo
+static void ejecutar_paso(Agente* agente) {
+    memcpy(estado_aleatorio, agente->estado_aleatorio, sizeof(estado_aleatorio));
+    switch (agente->tipo) {
+        case AGENTE_GENERADOR: paso_generador(agente); break;
+        case AGENTE_ADMIN:     paso_admin(agente); break;
+        case AGENTE_MEDICO:    paso_medico(agente); break;
+    }
+    memcpy(agente->estado_aleatorio, estado_aleatorio, sizeof(estado_aleatorio));
+}
+
+static void* trabajador_agentes(void* arg) {
+    (void)arg;
+    
+    pthread_mutex_lock(&planificador.mutex);
+    while (1) {
+        while (!planificador.listos_primero && simulacion_activa) {
+            pthread_cond_wait(&planificador.hay_listos, &planificador.mutex);
+        }
+        if (!simulacion_activa) break;
+        
+        Agente* agente = planificador.listos_primero;
+        planificador.listos_primero = agente->siguiente;
+        if (!planificador.listos_primero) planificador.listos_ultimo = NULL;
+        pthread_mutex_unlock(&planificador.mutex);
+        
+        ejecutar_paso(agente);
+        
+        pthread_mutex_lock(&planificador.mutex);
+    }
+    pthread_mutex_unlock(&planificador.mutex);
+    return NULL;
+}
+
+// Temporizador compartido: pasa a listos a los agentes cuyo despertar venció
+static void* temporizador_agentes(void* arg) {
+    (void)arg;
+    
+    pthread_mutex_lock(&planificador.mutex);
+    while (simulacion_activa) {
+        ListaEventos* pendientes = &planificador.temporizadores;
+        if (pendientes->count == 0) {
+            pthread_cond_wait(&planificador.cambio_temporizadores, &planificador.mutex);
+            continue;
+        }
+        
+        long primero = pendientes->eventos[0].tiempo;
+        if (primero > milisegundos_monotonos()) {
+            struct timespec limite = { primero / 1000, (primero % 1000) * 1000000 };
+            pthread_cond_timedwait(&planificador.cambio_temporizadores, &planificador.mutex, &limite);
+            continue;
+        }
+        
+        Evento evento = extraer_evento(pendientes);
+        encolar_listo(&planificador.agentes[evento.agente]);
+    }
+    pthread_mutex_unlock(&planificador.mutex);
+    return NULL;
+}
+
+static void agregar_agente(TipoAgente tipo, int indice, uint64_t flujo) {
+    Agente* agente = &planificador.agentes[planificador.num_agentes++];
+    agente->tipo = tipo;
+    agente->indice = indice;
+    agente->fase = FASE_INICIO;
+    agente->paciente = HANDLE_NULO;
+    sembrar_aleatorio(flujo);
+    memcpy(agente->estado_aleatorio, estado_aleatorio, sizeof(estado_aleatorio));
+    encolar_listo(agente);
+}
+
+// Armar planificador.avisos a partir de la matriz de capacidades de los
+// médicos presentes: la lista de la cola de un médico se avisa por cada
+// cola que él puede atender
+static void preparar_avisos(void) {
+    Cola* colas[NUM_COLAS_CLINICA];
+    colas_clinica(colas);
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) {
+        planificador.avisos[c][0] = c;
+        planificador.num_avisos[c] = 1;
+    }
+    
+    int total_medicos = total_medicos_clinica();
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) {
+        for (int i = 0; i < total_medicos; i++) {
+            const Medico* medico = &clinica->medicos[i];
+            int lista = cola_de_medico(medico)->indice;
+            if (lista == c || !puede_atender(medico, colas[c])) continue;
+            int ya_esta = 0;
+            for (int k = 0; k < planificador.num_avisos[c]; k++) ya_esta |= (planificador.avisos[c][k] == lista);
+            if (!ya_esta) planificador.avisos[c][planificador.num_avisos[c]++] = lista;
+        }
+    }
+}
+
+// Crear los agentes de la clínica principal y arrancar el pool y el temporizador
+void iniciar_planificador(int num_trabajadores) {
+    int total_medicos = total_medicos_clinica();
+    planificador.agentes = calloc(1 + clinica->personal.num_admin + total_medicos, sizeof(Agente));
+    planificador.trabajadores = malloc(num_trabajadores * sizeof(pthread_t));
+    if (!planificador.agentes || !planificador.trabajadores) {
+        fprintf(stderr, "Sin memoria para el planificador de agentes\n");
+        exit(1);
+    }
+    
+    pthread_mutex_init(&planificador.mutex, NULL);
+    pthread_cond_init(&planificador.hay_listos, NULL);
+    pthread_condattr_t atributos;
+    pthread_condattr_init(&atributos);
+    pthread_condattr_setclock(&atributos, CLOCK_MONOTONIC);
+    pthread_cond_init(&planificador.cambio_temporizadores, &atributos);
+    pthread_condattr_destroy(&atributos);
+    for (int lista = 0; lista < NUM_LISTAS_ESPERA; lista++) {
+        pthread_mutex_init(&planificador.esperas[lista].mutex, NULL);
+    }
+    preparar_avisos();
+    
+    agregar_agente(AGENTE_GENERADOR, 0, FLUJO_GENERADOR);
+    for (int i = 0; i < clinica->personal.num_admin; i++) {
+        agregar_agente(AGENTE_ADMIN, i, FLUJO_ADMIN(i));
+    }
+    for (int i = 0; i < total_medicos; i++) {
+        agregar_agente(AGENTE_MEDICO, i, FLUJO_MEDICO(i));
+    }
+    
+    planificador.num_trabajadores = num_trabajadores;
+    for (int i = 0; i < num_trabajadores; i++) {
+        pthread_create(&planificador.trabajadores[i], NULL, trabajador_agentes, NULL);
+    }
+    pthread_create(&planificador.hilo_temporizador, NULL, temporizador_agentes, NULL);
+}
+
+// Llamar con simulacion_activa ya en 0: ningún paso bloquea, así que los
+// hilos terminan apenas completan el que tienen en curso
+void detener_planificador(void) {
+    pthread_mutex_lock(&planificador.mutex);
+    pthread_cond_broadcast(&planificador.hay_listos);
+    pthread_cond_broadcast(&planificador.cambio_temporizadores);
+    pthread_mutex_unlock(&planificador.mutex);
+    
+    for (int i = 0; i < planificador.num_trabajadores; i++) {
+        pthread_join(planificador.trabajadores[i], NULL);
+    }
+    pthread_join(planificador.hilo_temporizador, NULL);
+    
+    free(planificador.trabajadores);
+    free(planificador.agentes);
+    free(planificador.temporizadores.eventos);
+}
+
+// ============================================================
+// Réplicas de Monte Carlo
+// ------------------------------------------------------------
+// Una jornada es una sola muestra ruidosa. Con --replicas N se simulan
+// N jornadas independientes en modo eventos discretos, repartidas entre
+// un hilo por núcleo: cada réplica tiene su propia clínica y su propia
+// semilla, así que no comparten ningún estado mutable. Al final se
+// informa la media y el intervalo de confianza del 95% de cada métrica.
+// ============================================================
+
+typedef enum {
+    METRICA_GENERADOS,
+    METRICA_ATENDIDOS_HORA,
+    METRICA_ESPERA_RECEPCION,
+    METRICA_ESPERA_ATENCION,
+    METRICA_ESPERA_P95,
+    METRICA_TASA_ABANDONO,
+    METRICA_EFICIENCIA,
+    METRICA_RECHAZADOS,
+    NUM_METRICAS
+} MetricaReplica;
+
+static const char* nombres_metricas[NUM_METRICAS] = {
+    "Pacientes generados",
+    "Pacientes atendidos por hora",
+    "Espera en recepción (min)",
+    "Espera por médico (min)",
+    "Espera total p95 (min)",
+    "Abandono o sin atender (%)",
+    "Eficiencia del sistema (%)",
+    "Rechazados por colas llenas"
+};
+
+typedef struct {
+    double valores[NUM_METRICAS];
+    int completa;              // 0 si la interrumpió Ctrl+C
+} ResultadoReplica;
+
+static ResultadoReplica* resultados_replicas = NULL;
+
+// Pacientes que siguen en recepción, en clasificación o esperando médico al
+// cierre: se cuentan y su espera entra al histograma censurada en la hora
+// de cierre. Sin esto una dotación que deja crecer las colas parecería tener
+// poco abandono y una espera corta
+static long censurar_pendientes(HistogramasPacientes* histogramas) {
+    ArenaPacientes* arena = &clinica->arena_pacientes;
+    time_t cierre = tiempo_simulado();
+    long pendientes = 0;
+    for (HandlePaciente handle = 0; handle < arena->num_bloques * TAM_BLOQUE_ARENA; handle++) {
+        uint8_t estado = estado_paciente(arena, handle);
+        if (estado != PACIENTE_EN_RECEPCION && estado != PACIENTE_EN_CLASIFICACION &&
+            estado != PACIENTE_EN_ESPERA) continue;
+        long minutos = (cierre - paciente_de(arena, handle)->tiempo_llegada) / 60;
+        if (minutos >= NUM_CUBETAS_ESPERA) minutos = NUM_CUBETAS_ESPERA - 1;
+        histogramas->espera_total[minutos]++;
+        pendientes++;
+    }
+    return pendientes;
+}
+
+// Resumir la jornada de la clínica actual
+static void medir_replica(ResultadoReplica* resultado) {
+    ContadoresPacientes totales = leer_estadisticas(&clinica->estadisticas);
+    HistogramasPacientes histogramas;
+    leer_histogramas(&clinica->estadisticas, &histogramas);
+    long pendientes = censurar_pendientes(&histogramas);
+    double* v = resultado->valores;
+    
+    v[METRICA_GENERADOS] = totales.generados;
+    v[METRICA_ATENDIDOS_HORA] = totales.atendidos * 3600.0 / duracion_jornada;
+    v[METRICA_ESPERA_RECEPCION] = totales.inicios_clasificacion > 0 ?
+        totales.espera_recepcion / 60.0 / totales.inicios_clasificacion : 0;
+    v[METRICA_ESPERA_ATENCION] = totales.inicios_atencion > 0 ?
+        totales.espera_atencion / 60.0 / totales.inicios_atencion : 0;
+    v[METRICA_ESPERA_P95] = percentil_espera(&histogramas, 0.95);
+    v[METRICA_TASA_ABANDONO] = totales.generados > 0 ?
+        100.0 * (totales.abandonaron + pendientes) / totales.generados : 0;
+    v[METRICA_EFICIENCIA] = totales.generados > 0 ?
+        100.0 * totales.atendidos / totales.generados : 0;
+    
+    long rechazados = clinica->cola_recepcion.rechazados + clinica->cola_medico_general.rechazados +
+                      clinica->cola_enfermeria.rechazados;
+    for (int i = 0; i < 4; i++) {
+        rechazados += clinica->cola_especialista[i].rechazados;
+    }
+    v[METRICA_RECHAZADOS] = rechazados;
+}
+
+// Simular una jornada completa con la dotación dada sobre la clínica del hilo
+static void simular_jornada(Clinica* propia, const ConfiguracionPersonal* personal,
+                            int replica, ResultadoReplica* resultado) {
+    preparar_clinica(propia, personal);
+    usar_clinica(propia);
+    // La réplica k usa el mismo flujo para todas las dotaciones que se comparan
+    // (números aleatorios comunes), así las diferencias no son solo ruido
+    sembrar_aleatorio(FLUJO_REPLICA(replica));
+    
+    // Desde una instantánea cada réplica bifurca el mismo estado con su propio flujo
+    if (ruta_restaurar_estado) {
+        restaurar_instantanea(0);
+        continuar_eventos_discretos();
+    } else {
+        inicializar_personal();
+        ejecutar_eventos_discretos();
+    }
+    if (simulacion_activa) {
+        medir_replica(resultado);
+        resultado->completa = 1;
+    }
+    
+    liberar_clinica(propia);
+}
+
+// Reparto de tareas entre hilos: cada trabajador reserva una clínica y toma
+// índices de tarea pendientes hasta agotarlos
+typedef void (*TareaJornada)(Clinica* propia, int tarea);
+
+static TareaJornada tarea_en_curso;
+static int num_tareas_en_curso;
+static int siguiente_tarea;
+
+static void* trabajador_jornadas(void* arg) {
+    (void)arg;
+    Clinica* propia = malloc(sizeof(Clinica));
+    if (!propia) {
+        fprintf(stderr, "Sin memoria para la clínica de una réplica\n");
+        exit(1);
+    }
+    
+    while (1) {
+        int tarea = __atomic_fetch_add(&siguiente_tarea, 1, __ATOMIC_RELAXED);
+        if (tarea >= num_tareas_en_curso || !simulacion_activa) break;
+        tarea_en_curso(propia, tarea);
+    }
+    
+    free(propia);
+    return NULL;
+}
+
+static void ejecutar_en_paralelo(TareaJornada tarea, int num_tareas) {
+    int hilos = (hilos_configurados() < num_tareas) ? hilos_replicas : num_tareas;
+    pthread_t* ids = malloc(hilos * sizeof(pthread_t));
+    if (!ids) {
+        fprintf(stderr, "Sin memoria para los hilos de réplicas\n");
+        exit(1);
+    }
+    
+    tarea_en_curso = tarea;
+    num_tareas_en_curso = num_tareas;
+    siguiente_tarea = 0;
+    for (int i = 0; i < hilos; i++) {
+        pthread_create(&ids[i], NULL, trabajador_jornadas, NULL);
+    }
+    for (int i = 0; i < hilos; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    free(ids);
+}
+
+static void tarea_replica(Clinica* propia, int replica) {
+    simular_jornada(propia, &personal_configurado, replica,
+                    &resultados_replicas[replica]);
+}
+
+// Cuantil 0.975 de la t de Student con 'gl' grados de libertad
+static double t_student_975(int gl) {
+    static const double tabla[30] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (gl < 1) return 0;
+    if (gl <= 30) return tabla[gl - 1];
+    if (gl <= 60) return 2.000;
+    if (gl <= 120) return 1.980;
+    return 1.960;
+}
+
+// Media y semiamplitud del IC 95% de una métrica sobre 'n' réplicas
+typedef struct {
+    double media;
+    double semiamplitud;
+    double minimo;
+    double maximo;
+} ResumenMetrica;
+
+static ResumenMetrica resumir_metrica(const ResultadoReplica* resultados, int n, MetricaReplica m) {
+    ResumenMetrica r = { 0, 0, 0, 0 };
+    if (n < 1) return r;
+    
+    double suma = 0;
+    for (int i = 0; i < n; i++) {
+        double x = resultados[i].valores[m];
+        suma += x;
+        if (i == 0 || x < r.minimo) r.minimo = x;
+        if (i == 0 || x > r.maximo) r.maximo = x;
+    }
+    r.media = suma / n;
+    
+    if (n > 1) {
+        double suma_cuadrados = 0;
+        for (int i = 0; i < n; i++) {
+            double d = resultados[i].valores[m] - r.media;
+            suma_cuadrados += d * d;
+        }
+        double desvio = sqrt(suma_cuadrados / (n - 1));
+        r.semiamplitud = t_student_975(n - 1) * desvio / sqrt(n);
+    }
+    return r;
+}
+
+static void escribir_encabezado_replicas(FILE* salida, const char* titulo, double ms) {
+    const char* politicas[] = { "bloquear", "rechazar", "desviar" };
+    time_t ahora = time(NULL);
+    
+    fprintf(salida, "%s\n", titulo);
+    fprintf(salida, "Fecha: %s", ctime(&ahora));
+    fprintf(salida, "Hilos: %d | Jornada: %d:%02d h | Semilla: %llu\n",
+            hilos_replicas, duracion_jornada / 3600, (duracion_jornada % 3600) / 60,
+            (unsigned long long)semilla_global);
+    if (capacidad_colas > 0) {
+        fprintf(salida, "Capacidad por cola: %d pacientes (política: %s)\n",
+                capacidad_colas, politicas[politica_desborde]);
+    }
+    fprintf(salida, "Duración real: %.2f ms\n", ms);
+    fprintf(salida, "================================\n\n");
+}
+
+static void escribir_resumen_replicas(FILE* salida, int completadas) {
+    const ConfiguracionPersonal* p = &personal_configurado;
+    fprintf(salida, "Réplicas completadas: %d\n", completadas);
+    fprintf(salida, "Personal: %d admins (activos al inicio: %d), %d médicos generales, "
+            "%d enfermeras, %d especialistas\n\n",
+            p->num_admin, (admin_activos_inicial < p->num_admin) ? admin_activos_inicial : p->num_admin,
+            p->num_medicos_general, p->num_enfermeras,
+            p->num_especialistas);
+    
+    fprintf(salida, "MÉTRICAS (media ± semiamplitud del IC 95%%, [mínimo, máximo]):\n");
+    for (int m = 0; m < NUM_METRICAS; m++) {
+        ResumenMetrica r = resumir_metrica(resultados_replicas, completadas, m);
+        fprintf(salida, "- %-30s %10.2f ± %-8.2f [%.2f, %.2f]\n",
+                nombres_metricas[m], r.media, r.semiamplitud, r.minimo, r.maximo);
+    }
+}
+
+// Dejar al principio del arreglo las réplicas que llegaron al fin de la
+// jornada (con Ctrl+C las demás quedan incompletas); devuelve cuántas son
+static int compactar_completas(ResultadoReplica* resultados, int n) {
+    int completas = 0;
+    for (int i = 0; i < n; i++) {
+        if (resultados[i].completa) resultados[completas++] = resultados[i];
+    }
+    return completas;
+}
+
+static double milisegundos_desde(const struct timespec* inicio) {
+    struct timespec fin;
+    clock_gettime(CLOCK_MONOTONIC, &fin);
+    return (fin.tv_sec - inicio->tv_sec) * 1000.0 + (fin.tv_nsec - inicio->tv_nsec) / 1e6;
+}
+
+// Ejecutar todas las réplicas y generar el reporte agregado
+void ejecutar_replicas(void) {
+    resultados_replicas = calloc(num_replicas, sizeof(ResultadoReplica));
+    if (!resultados_replicas) {
+        fprintf(stderr, "Sin memoria para las réplicas\n");
+        exit(1);
+    }
+    
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    ejecutar_en_paralelo(tarea_replica, num_replicas);
+    double ms = milisegundos_desde(&inicio);
+    
+    int completadas = compactar_completas(resultados_replicas, num_replicas);
+    if (completadas < 1) {
+        printf("No se completó ninguna réplica\n");
+        return;
+    }
+    
+    printf("\n");
+    escribir_resumen_replicas(stdout, completadas);
+    
+    FILE* archivo = fopen("reporte_replicas.txt", "w");
+    if (!archivo) {
+        printf("Error al crear archivo de reporte\n");
+        return;
+    }
+    escribir_encabezado_replicas(archivo, "REPORTE DE RÉPLICAS (MONTE CARLO)", ms);
+    escribir_resumen_replicas(archivo, completadas);
+    fclose(archivo);
+    printf("\n📄 Reporte generado en 'reporte_replicas.txt'\n");
+}
+
+// ============================================================
+// Red de clínicas
+// ------------------------------------------------------------
+// Con --red N se simulan N sedes en modo eventos discretos, cada una en un
+// hilo fijado a su propio núcleo. Cada sede reserva y prepara su clínica
+// desde ese hilo, así sus páginas quedan en el nodo NUMA del núcleo (primer
+// toque). Las sedes no comparten colas ni pacientes: cuando la especialidad
+// no tiene especialista local o la cola de destino no tiene lugar, el admin
+// deriva al paciente a otra sede por un canal acotado de un productor y un
+// consumidor (uno por par de sedes).
+//
+// El traslado demora TRASLADO_DERIVACION segundos, y ese retardo es el margen
+// que deja avanzar a todas las sedes en paralelo por ventanas de ese largo:
+// nada de lo que se envía en una ventana llega antes de que termine. Entre
+// ventanas las sedes se esperan en una barrera y cada una vacía sus canales
+// de entrada en orden de sede, así la misma semilla reproduce la misma red.
+// ============================================================
+
+#define MAX_SEDES 64
+#define TRASLADO_DERIVACION 1800   // Segundos de traslado entre sedes (y largo de cada ventana)
+#define TAM_CANAL_DERIVACION 256   // Derivaciones en vuelo por par de sedes (potencia de 2)
+
+// Paciente en traslado: solo viajan sus datos, cada sede tiene su propia arena
+typedef struct {
+    long tiempo_llegada;       // Llegada a la sede de origen (cuenta para la espera total)
+    long llegada_destino;      // Fin del traslado
+    uint8_t tipo_atencion;
+    uint8_t especialidad;
+    uint8_t prioridad;
+} MensajeDerivacion;
+
+// Canal de un solo productor (la sede de origen) y un solo consumidor (la de
+// destino); los contadores crecen sin volver a cero y cada uno tiene su línea
+typedef struct {
+    MensajeDerivacion* mensajes;
+    unsigned long escritos __attribute__((aligned(TAM_LINEA_CACHE)));
+    unsigned long leidos __attribute__((aligned(TAM_LINEA_CACHE)));
+} CanalDerivacion;
+
+typedef struct {
+    int nucleo;                    // -1 si no se pudo fijar el hilo
+    int cubiertas[4];              // Especialidades con especialista (fijas desde la primera ventana)
+    CanalDerivacion* entrada;      // Un canal por sede de origen, en memoria de esta sede
+    long enviados_especialidad;    // Sin especialista local para la especialidad
+    long enviados_desborde;        // Sin lugar en la cola de destino
+    long recibidos;
+    long canal_lleno;              // Derivaciones que se quedaron en la sede por canal lleno
+    long eventos;
+    ContadoresPacientes totales;
+    HistogramasPacientes histogramas;
+    int completa;
+} __attribute__((aligned(TAM_LINEA_CACHE))) SedeRed;
+
+int num_sedes = 0;                 // --red N: 0 = una sola clínica
+static SedeRed* sedes = NULL;
+static pthread_barrier_t barrera_red;
+static __thread int sede_actual = -1;  // Sede del hilo (-1 fuera de la red)
+
+static int canal_enviar(CanalDerivacion* canal, const MensajeDerivacion* mensaje) {
+    unsigned long escritos = __atomic_load_n(&canal->escritos, __ATOMIC_RELAXED);
+    if (escritos - __atomic_load_n(&canal->leidos, __ATOMIC_ACQUIRE) >= TAM_CANAL_DERIVACION) return 0;
+    canal->mensajes[escritos & (TAM_CANAL_DERIVACION - 1)] = *mensaje;
+    __atomic_store_n(&canal->escritos, escritos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+static int canal_recibir(CanalDerivacion* canal, MensajeDerivacion* mensaje) {
+    unsigned long leidos = __atomic_load_n(&canal->leidos, __ATOMIC_RELAXED);
+    if (leidos == __atomic_load_n(&canal->escritos, __ATOMIC_ACQUIRE)) return 0;
+    *mensaje = canal->mensajes[leidos & (TAM_CANAL_DERIVACION - 1)];
+    __atomic_store_n(&canal->leidos, leidos + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// La cola rechazaría o bloquearía al paciente (un desvío local tiene prioridad)
+static int cola_sin_lugar(const Cola* cola) {
+    if (cola->capacidad == 0 || cola->count < cola->capacidad) return 0;
+    if (cola->politica != POLITICA_DESVIAR || !cola->desvio || cola->desvio == cola) return 1;
+    return cola->desvio->capacidad > 0 && cola->desvio->count >= cola->desvio->capacidad;
+}
+
+// Siguiente sede de la red que puede atender al paciente (-1 si ninguna)
+static int sede_para(const Paciente* paciente) {
+    for (int k = 1; k < num_sedes; k++) {
+        int otra = (sede_actual + k) % num_sedes;
+        if (paciente->tipo_atencion != ATENCION_ESPECIALIDAD ||
+            sedes[otra].cubiertas[paciente->especialidad]) {
+            return otra;
+        }
+    }
+    return -1;
+}
+
+// Derivar a otra sede al paciente que el admin acaba de clasificar, si su
+// especialidad no está cubierta aquí o su cola no tiene lugar. Devuelve 1 si
+// el paciente salió de la clínica (el admin queda libre)
+static int red_enviar_paciente(PersonalAdmin* admin, HandlePaciente handle) {
+    if (sede_actual < 0) return 0;
+    
+    // Un traslado que terminaría después del cierre no tiene sentido
+    long llegada = clinica->reloj_virtual + TRASLADO_DERIVACION;
+    if (llegada >= duracion_jornada) return 0;
+    
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    int por_especialidad = paciente->tipo_atencion == ATENCION_ESPECIALIDAD &&
+                           !clinica->especialidad_cubierta[paciente->especialidad];
+    if (!por_especialidad && !cola_sin_lugar(cola_destino(paciente))) return 0;
+    
+    int otra = sede_para(paciente);
+    if (otra < 0) return 0;
+    
+    SedeRed* sede = &sedes[sede_actual];
+    MensajeDerivacion mensaje = {
+        .tiempo_llegada = paciente->tiempo_llegada,
+        .llegada_destino = llegada,
+        .tipo_atencion = paciente->tipo_atencion,
+        .especialidad = paciente->especialidad,
+        .prioridad = paciente->prioridad
+    };
+    if (!canal_enviar(&sedes[otra].entrada[sede_actual], &mensaje)) {
+        sede->canal_lleno++;
+        return 0;
+    }
+    if (por_especialidad) sede->enviados_especialidad++;
+    else sede->enviados_desborde++;
+    
+    LOG(NIVEL_INFO, "🚑 Admin %d derivó paciente %d a la sede %d (%s)\n", admin->id, paciente->id,
+        otra + 1, por_especialidad ? "sin especialista" : "cola llena");
+    liberar_paciente(&clinica->arena_pacientes, handle);
+    admin->ocupado = 0;
+    return 1;
+}
+
+// Un paciente derivado termina su traslado: entra ya clasificado a su cola
+static void red_recibir_paciente(HandlePaciente handle) {
+    Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+    int id = paciente->id;
+    TipoAtencion tipo = paciente->tipo_atencion;
+    paciente->tiempo_clasificacion = clinica->reloj_virtual;
+    paciente->clasificado = 1;
+    sedes[sede_actual].recibidos++;
+    
+    // Sin productor que lo retenga, una cola llena que bloquearía también lo rechaza
+    Cola* destino = cola_destino(paciente);
+    ResultadoEncolado resultado = encolar_clasificado(handle);
+    if (resultado == COLA_LLENA) descartar_rechazado(handle, nombre_destino(tipo));
+    if (resultado == COLA_LLENA || resultado == RECHAZADO) return;
+    
+    LOG(NIVEL_INFO, "🚑 Paciente %d llegó derivado de otra sede hacia %s\n", id, nombre_destino(tipo));
+    des_despertar_medicos(destino);
+}
+
+// Pasar los mensajes de los canales de entrada a la arena y a la lista de
+// eventos de la sede, en orden de sede de origen
+static void red_vaciar_canales(void) {
+    SedeRed* sede = &sedes[sede_actual];
+    for (int origen = 0; origen < num_sedes; origen++) {
+        MensajeDerivacion mensaje;
+        while (canal_recibir(&sede->entrada[origen], &mensaje)) {
+            HandlePaciente handle = reservar_paciente(&clinica->arena_pacientes);
+            if (handle == HANDLE_NULO) continue;
+            
+            Paciente* paciente = paciente_de(&clinica->arena_pacientes, handle);
+            paciente->id = ++clinica->siguiente_id_paciente;
+            paciente->tiempo_llegada = mensaje.tiempo_llegada;
+            paciente->tipo_atencion = mensaje.tipo_atencion;
+            paciente->especialidad = mensaje.especialidad;
+            paciente->prioridad = mensaje.prioridad;
+            paciente->plazo_abandono = PLAZO_NINGUNO;
+            fijar_estado(&clinica->arena_pacientes, handle, PACIENTE_EN_ESPERA);
+            programar_llegada_derivada(&clinica->lista_eventos, mensaje.llegada_destino, handle);
+        }
+    }
+}
+
+// Fijar el hilo de la sede al núcleo permitido número 'sede' (rotando si
+// hay más sedes que núcleos); devuelve el núcleo o -1
+static int fijar_nucleo(int sede) {
+#ifdef __linux__
+    cpu_set_t permitidos;
+    if (sched_getaffinity(0, sizeof(permitidos), &permitidos) != 0) return -1;
+    int buscado = sede % CPU_COUNT(&permitidos);
+    for (int nucleo = 0; nucleo < CPU_SETSIZE; nucleo++) {
+        if (!CPU_ISSET(nucleo, &permitidos) || buscado-- > 0) continue;
+        cpu_set_t propio;
+        CPU_ZERO(&propio);
+        CPU_SET(nucleo, &propio);
+        return pthread_setaffinity_np(pthread_self(), sizeof(propio), &propio) == 0 ? nucleo : -1;
+    }
+#endif
+    (void)sede;
+    return -1;
+}
+
+static void* hilo_sede(void* arg) {
+    sede_actual = (int)(intptr_t)arg;
+    SedeRed* sede = &sedes[sede_actual];
+    
+    // Fijar el núcleo antes de tocar memoria: la clínica y los canales de
+    // entrada se reservan y se inicializan desde aquí
+    sede->nucleo = fijar_nucleo(sede_actual);
+    Clinica* propia = malloc(sizeof(Clinica));
+    MensajeDerivacion* buzon = malloc((size_t)num_sedes * TAM_CANAL_DERIVACION * sizeof(MensajeDerivacion));
+    if (!propia || !buzon ||
+        posix_memalign((void**)&sede->entrada, TAM_LINEA_CACHE, num_sedes * sizeof(CanalDerivacion)) != 0) {
+        fprintf(stderr, "Sin memoria para la sede %d\n", sede_actual + 1);
+        exit(1);
+    }
+    memset(buzon, 0, (size_t)num_sedes * TAM_CANAL_DERIVACION * sizeof(MensajeDerivacion));
+    memset(sede->entrada, 0, num_sedes * sizeof(CanalDerivacion));
+    for (int origen = 0; origen < num_sedes; origen++) {
+        sede->entrada[origen].mensajes = buzon + (size_t)origen * TAM_CANAL_DERIVACION;
+    }
+    
+    preparar_clinica(propia, &personal_configurado);
+    usar_clinica(propia);
+    sembrar_aleatorio(FLUJO_REPLICA(sede_actual));
+    inicializar_personal();
+    memcpy(sede->cubiertas, propia->especialidad_cubierta, sizeof(sede->cubiertas));
+    des_iniciar_jornada();
+    
+    // Todas las sedes publicaron sus especialidades y sus canales
+    pthread_barrier_wait(&barrera_red);
+    
+    // Todas las sedes recorren las mismas ventanas (con Ctrl+C, sin eventos)
+    for (long fin = TRASLADO_DERIVACION; ; fin += TRASLADO_DERIVACION) {
+        des_avanzar_hasta(fin);
+        pthread_barrier_wait(&barrera_red);
+        red_vaciar_canales();
+        pthread_barrier_wait(&barrera_red);
+        if (fin > duracion_jornada) break;
+    }
+    
+    sede->eventos = propia->eventos_procesados;
+    sede->totales = leer_estadisticas(&propia->estadisticas);
+    leer_histogramas(&propia->estadisticas, &sede->histogramas);
+    sede->completa = simulacion_activa;
+    des_liberar_eventos();
+    liberar_clinica(propia);
+    free(propia);
+    free(buzon);
+    free(sede->entrada);
+    sede->entrada = NULL;
+    return NULL;
+}
+
+static void escribir_resumen_red(FILE* salida, double ms) {
+    const char* iniciales = "CNPD";  // Cardiología, Neurología, Pediatría, Dermatología
+    ContadoresPacientes red = {0};
+    HistogramasPacientes histogramas_red;  // Solo se combina la espera total
+    memset(&histogramas_red, 0, sizeof(histogramas_red));
+    long eventos = 0, derivados = 0, canal_lleno = 0;
+    
+    fprintf(salida, "Sedes: %d | Traslado entre sedes: %d min | Canal: %d pacientes en vuelo por par\n\n",
+            num_sedes, TRASLADO_DERIVACION / 60, TAM_CANAL_DERIVACION);
+    fprintf(salida, "%-5s %-6s %-6s %10s %10s %9s %9s %10s %10s %9s %8s\n", "Sede", "Núcleo", "Espec.",
+            "Generados", "Atendidos", "Abandono", "Espera", "Env.espec", "Env.desb", "Recibidos", "Canal");
+    for (int s = 0; s < num_sedes; s++) {
+        const SedeRed* sede = &sedes[s];
+        const ContadoresPacientes* t = &sede->totales;
+        char cubiertas[5];
+        for (int e = 0; e < 4; e++) cubiertas[e] = sede->cubiertas[e] ? iniciales[e] : '-';
+        cubiertas[4] = '\0';
+        
+        fprintf(salida, "%-5d %-6d %-6s %10ld %10ld %8.1f%% %8.1fm %10ld %10ld %9ld %8ld%s\n",
+                s + 1, sede->nucleo, cubiertas, t->generados, t->atendidos,
+                t->generados > 0 ? 100.0 * t->abandonaron / t->generados : 0,
+                t->inicios_atencion > 0 ? t->espera_atencion / 60.0 / t->inicios_atencion : 0,
+                sede->enviados_especialidad, sede->enviados_desborde, sede->recibidos,
+                sede->canal_lleno, sede->completa ? "" : " (incompleta)");
+        
+        for (size_t c = 0; c < NUM_CONTADORES; c++) {
+            ((long*)&red)[c] += ((const long*)t)[c];
+        }
+        for (int i = 0; i < NUM_CUBETAS_ESPERA; i++) {
+            histogramas_red.espera_total[i] += sede->histogramas.espera_total[i];
+        }
+        eventos += sede->eventos;
+        derivados += sede->enviados_especialidad + sede->enviados_desborde;
+        canal_lleno += sede->canal_lleno;
+    }
+    
+    // Los derivados se cuentan como generados en su sede de origen
+    fprintf(salida, "\nRED COMPLETA:\n");
+    fprintf(salida, "- Pacientes generados: %ld\n", red.generados);
+    fprintf(salida, "- Pacientes atendidos: %ld (%.1f%%)\n", red.atendidos,
+            red.generados > 0 ? 100.0 * red.atendidos / red.generados : 0);
+    fprintf(salida, "- Abandonaron: %ld (%.1f%%)\n", red.abandonaron,
+            red.generados > 0 ? 100.0 * red.abandonaron / red.generados : 0);
+    fprintf(salida, "- Espera por médico: %.1f min (p95 de la espera total: %.0f min)\n",
+            red.inicios_atencion > 0 ? red.espera_atencion / 60.0 / red.inicios_atencion : 0,
+            percentil_espera(&histogramas_red, 0.95));
+    fprintf(salida, "- Derivados entre sedes: %ld (%ld se quedaron en su sede por canal lleno)\n",
+            derivados, canal_lleno);
+    fprintf(salida, "- Eventos procesados: %ld (%.2f millones por segundo)\n", eventos,
+            ms > 0 ? eventos / ms / 1000.0 : 0);
+}
+
+// Simular la red completa y generar su reporte
+void ejecutar_red(void) {
+    sedes = calloc(num_sedes, sizeof(SedeRed));
+    pthread_t* ids = malloc(num_sedes * sizeof(pthread_t));
+    if (!sedes || !ids) {
+        fprintf(stderr, "Sin memoria para la red de clínicas\n");
+        exit(1);
+    }
+    pthread_barrier_init(&barrera_red, NULL, num_sedes);
+    
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    for (int s = 0; s < num_sedes; s++) {
+        pthread_create(&ids[s], NULL, hilo_sede, (void*)(intptr_t)s);
+    }
+    for (int s = 0; s < num_sedes; s++) {
+        pthread_join(ids[s], NULL);
+    }
+    double ms = milisegundos_desde(&inicio);
+    pthread_barrier_destroy(&barrera_red);
+    free(ids);
+    
+    printf("\n");
+    escribir_resumen_red(stdout, ms);
+    
+    FILE* archivo = fopen("reporte_red.txt", "w");
+    if (archivo) {
+        escribir_encabezado_replicas(archivo, "REPORTE DE LA RED DE CLÍNICAS", ms);
+        escribir_resumen_red(archivo, ms);
+        fclose(archivo);
+        printf("\n📄 Reporte generado en 'reporte_red.txt'\n");
+    } else {
+        printf("Error al crear archivo de reporte\n");
+    }
+    
+    free(sedes);
+    sedes = NULL;
+}
+
+// ============================================================
+// Optimizador de dotación
+// ------------------------------------------------------------
+// Recorre todas las dotaciones (admins, médicos generales, enfermeras,
+// especialistas) cuyo costo por hora entra en el presupuesto y las evalúa
+// por rondas: en cada ronda las candidatas vigentes suman réplicas (4, 8,
+// 16... hasta --replicas) y se descartan las que otra candidata igual o más
+// barata supera con confianza del 95% en abandono y en espera p95 (quienes
+// siguen esperando al cierre cuentan como abandonos, con la espera cortada
+// en el cierre). Las sobrevivientes no dominadas forman la frontera de
+// Pareto costo/abandono/p95.
+// ============================================================
+
+#define REPLICAS_PRIMERA_RONDA 4
+#define MAX_ADMIN_OPTIMIZADOR 4         // Espacio de búsqueda: la enumeración es exhaustiva
+#define MAX_MEDICOS_OPTIMIZADOR 10
+#define MAX_ESPECIALISTAS_OPTIMIZADOR 4
+
+// Costo por hora de cada rol (unidades monetarias arbitrarias)
+int costo_admin = 20;
+int costo_medico_general = 60;
+int costo_enfermera = 35;
+int costo_especialista = 90;
+int presupuesto_hora = 0;               // 0 = sin límite
+
+int modo_optimizar = 0;
+
+typedef struct {
+    ConfiguracionPersonal personal;
+    int costo;
+    ResultadoReplica* resultados;   // Una por réplica (hasta el máximo)
+    int replicas;                   // Réplicas ya evaluadas
+    int descartada;                 // Ronda en la que se podó (0 = vigente)
+    ResumenMetrica abandono;
+    ResumenMetrica espera_p95;
+} CandidataPersonal;
+
+static CandidataPersonal* candidatas = NULL;
+static int num_candidatas = 0;
+
+// Tareas de la ronda actual: (candidata, réplica) aplanadas en un índice
+static int* tareas_candidata = NULL;
+static int* tareas_replica = NULL;
+
+static int costo_personal(const ConfiguracionPersonal* p) {
+    return p->num_admin * costo_admin + p->num_medicos_general * costo_medico_general +
+           p->num_enfermeras * costo_enfermera + p->num_especialistas * costo_especialista;
+}
+
+static void tarea_candidata(Clinica* propia, int tarea) {
+    CandidataPersonal* c = &candidatas[tareas_candidata[tarea]];
+    int replica = tareas_replica[tarea];
+    simular_jornada(propia, &c->personal, replica, &c->resultados[replica]);
+}
+
+// Enumerar las dotaciones posibles dentro del presupuesto en las que cada
+// cola tiene quien la atienda según la matriz de capacidades (medicina
+// general: generales o especialistas; enfermería: enfermeras o generales)
+static void generar_candidatas(int max_replicas) {
+    int capacidad = MAX_ADMIN_OPTIMIZADOR * (MAX_MEDICOS_OPTIMIZADOR + 1) * (MAX_MEDICOS_OPTIMIZADOR + 1) *
+                    (MAX_ESPECIALISTAS_OPTIMIZADOR + 1);
+    candidatas = calloc(capacidad, sizeof(CandidataPersonal));
+    if (!candidatas) {
+        fprintf(stderr, "Sin memoria para el optimizador\n");
+        exit(1);
+    }
+    
+    for (int a = 1; a <= MAX_ADMIN_OPTIMIZADOR; a++) {
+        for (int g = 0; g <= MAX_MEDICOS_OPTIMIZADOR; g++) {
+            for (int e = 0; g + e <= MAX_MEDICOS_OPTIMIZADOR; e++) {
+                for (int s = 0; s <= MAX_ESPECIALISTAS_OPTIMIZADOR && g + e + s <= MAX_MEDICOS_OPTIMIZADOR; s++) {
+                    if (g + s == 0 || g + e == 0) continue;
+                    ConfiguracionPersonal p = { a, g, e, s };
+                    int costo = costo_personal(&p);
+                    if (presupuesto_hora > 0 && costo > presupuesto_hora) continue;
+                    
+                    CandidataPersonal* c = &candidatas[num_candidatas++];
+                    c->personal = p;
+                    c->costo = costo;
+                    c->resultados = calloc(max_replicas, sizeof(ResultadoReplica));
+                    if (!c->resultados) {
+                        fprintf(stderr, "Sin memoria para el optimizador\n");
+                        exit(1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// 'a' es mejor que 'b' con confianza: más barata o igual y con el intervalo
+// del 95% enteramente por debajo en abandono y en espera p95
+static int domina_con_confianza(const CandidataPersonal* a, const CandidataPersonal* b) {
+    return a->costo <= b->costo &&
+           a->abandono.media + a->abandono.semiamplitud < b->abandono.media - b->abandono.semiamplitud &&
+           a->espera_p95.media + a->espera_p95.semiamplitud < b->espera_p95.media - b->espera_p95.semiamplitud;
+}
+
+// 'a' domina a 'b' en medias (frontera de Pareto final)
+static int domina(const CandidataPersonal* a, const CandidataPersonal* b) {
+    int no_peor = a->costo <= b->costo && a->abandono.media <= b->abandono.media &&
+                  a->espera_p95.media <= b->espera_p95.media;
+    int mejor = a->costo < b->costo || a->abandono.media < b->abandono.media ||
+                a->espera_p95.media < b->espera_p95.media;
+    return no_peor && mejor;
+}
+
+static int comparar_por_costo(const void* x, const void* y) {
+    const CandidataPersonal* a = *(CandidataPersonal* const*)x;
+    const CandidataPersonal* b = *(CandidataPersonal* const*)y;
+    if (a->costo != b->costo) return a->costo - b->costo;
+    return (a->abandono.media > b->abandono.media) - (a->abandono.media < b->abandono.media);
+}
+
+static void escribir_frontera(FILE* salida, CandidataPersonal** frontera, int en_frontera,
+                              int rondas, long jornadas) {
+    int vigentes = 0;
+    for (int i = 0; i < num_candidatas; i++) {
+        if (!candidatas[i].descartada) vigentes++;
+    }
+    
+    fprintf(salida, "Costo por hora: admin %d, médico general %d, enfermera %d, especialista %d",
+            costo_admin, costo_medico_general, costo_enfermera, costo_especialista);
+    if (presupuesto_hora > 0) fprintf(salida, " | Presupuesto: %d/h", presupuesto_hora);
+    fprintf(salida, "\n");
+    fprintf(salida, "Dotaciones evaluadas: %d | Podadas: %d | Rondas: %d | Jornadas simuladas: %ld\n\n",
+            num_candidatas, num_candidatas - vigentes, rondas, jornadas);
+    
+    fprintf(salida, "FRONTERA DE PARETO (costo vs. abandono vs. espera p95):\n");
+    fprintf(salida, "  Costo/h  Admin  Generales  Enfermeras  Especialistas  Réplicas  "
+            "Abandono %%        Espera p95 (min)\n");
+    for (int i = 0; i < en_frontera; i++) {
+        const CandidataPersonal* c = frontera[i];
+        fprintf(salida, "  %7d  %5d  %9d  %10d  %13d  %8d  %5.2f ± %-6.2f  %6.1f ± %-6.1f\n",
+                c->costo, c->personal.num_admin, c->personal.num_medicos_general,
+                c->personal.num_enfermeras, c->personal.num_especialistas, c->replicas,
+                c->abandono.media, c->abandono.semiamplitud,
+                c->espera_p95.media, c->espera_p95.semiamplitud);
+    }
+}
+
+void ejecutar_optimizador(void) {
+    int max_replicas = (num_replicas > 0) ? num_replicas : 32;
+    if (max_replicas < REPLICAS_PRIMERA_RONDA) max_replicas = REPLICAS_PRIMERA_RONDA;
+    
+    generar_candidatas(max_replicas);
+    if (num_candidatas == 0) {
+        printf("Ninguna dotación entra en el presupuesto de %d por hora\n", presupuesto_hora);
+        return;
+    }
+    printf("🔎 Optimizando dotación: %d candidatas, hasta %d réplicas cada una\n",
+           num_candidatas, max_replicas);
+    
+    tareas_candidata = malloc(num_candidatas * max_replicas * sizeof(int));
+    tareas_replica = malloc(num_candidatas * max_replicas * sizeof(int));
+    if (!tareas_candidata || !tareas_replica) {
+        fprintf(stderr, "Sin memoria para el optimizador\n");
+        exit(1);
+    }
+    
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    
+    int rondas = 0;
+    long jornadas = 0;
+    int objetivo = REPLICAS_PRIMERA_RONDA;
+    int anterior = 0;
+    while (simulacion_activa) {
+        rondas++;
         
+        // Completar las réplicas de esta ronda para todas las vigentes
+        int num_tareas = 0;
+        for (int i = 0; i < num_candidatas; i++) {
+            if (candidatas[i].descartada) continue;
+            for (int r = anterior; r < objetivo; r++) {
+                tareas_candidata[num_tareas] = i;
+                tareas_replica[num_tareas] = r;
+                num_tareas++;
+            }
+        }
+        ejecutar_en_paralelo(tarea_candidata, num_tareas);
+        jornadas += num_tareas;
         if (!simulacion_activa) break;
         
-        time_t ahora = time(NULL);
-        if (ahora - ultimo_cambio_personal < 120 / SPEED_FACTOR) continue; // Mín 2 min reales entre cambios
-        
-        // Evaluar carga del sistema para cambiar personal administrativo
-        int carga_recepcion = cola_recepcion.count;
-        int nuevo_admin_activos = admin_activos;
+        int vigentes = 0;
+        for (int i = 0; i < num_candidatas; i++) {
+            CandidataPersonal* c = &candidatas[i];
+            if (c->descartada) continue;
+            c->replicas = objetivo;
+            c->abandono = resumir_metrica(c->resultados, c->replicas, METRICA_TASA_ABANDONO);
+            c->espera_p95 = resumir_metrica(c->resultados, c->replicas, METRICA_ESPERA_P95);
+            vigentes++;
+        }
         
-        if (carga_recepcion > 15 && admin_activos < 4) {
-            // Alta carga: activar más personal
-            nuevo_admin_activos = (admin_activos < 3) ? admin_activos + 1 : 4;
-            
-            pthread_mutex_lock(&print_mutex);
-            printf("🚨 ALTA DEMANDA: Activando Admin %d (Total activos: %d)\n", 
-                   nuevo_admin_activos, nuevo_admin_activos);
-            pthread_mutex_unlock(&print_mutex);
-            
-        } else if (carga_recepcion < 5 && admin_activos > 1) {
-            // Baja carga: reducir personal
-            nuevo_admin_activos = admin_activos - 1;
-            
-            pthread_mutex_lock(&print_mutex);
-            printf("📉 Baja demanda: Desactivando Admin %d (Total activos: %d)\n", 
-                   admin_activos, nuevo_admin_activos);
-            pthread_mutex_unlock(&print_mutex);
+        // Podar las dominadas con confianza por alguna vigente
+        for (int i = 0; i < num_candidatas; i++) {
+            if (candidatas[i].descartada) continue;
+            for (int j = 0; j < num_candidatas; j++) {
+                if (j == i || candidatas[j].descartada) continue;
+                if (domina_con_confianza(&candidatas[j], &candidatas[i])) {
+                    candidatas[i].descartada = rondas;
+                    vigentes--;
+                    break;
+                }
+            }
         }
+        printf("   Ronda %d: %d réplicas por candidata, %d vigentes (%.0f ms)\n",
+               rondas, objetivo, vigentes, milisegundos_desde(&inicio));
         
-        if (nuevo_admin_activos != admin_activos) {
-            admin_activos = nuevo_admin_activos;
-            ultimo_cambio_personal = ahora;
+        if (objetivo >= max_replicas) break;
+        anterior = objetivo;
+        objetivo = (objetivo * 2 < max_replicas) ? objetivo * 2 : max_replicas;
+    }
+    double ms = milisegundos_desde(&inicio);
+    
+    // Frontera de Pareto entre las vigentes, ordenada por costo
+    CandidataPersonal** frontera = malloc(num_candidatas * sizeof(CandidataPersonal*));
+    if (!frontera) {
+        fprintf(stderr, "Sin memoria para el optimizador\n");
+        exit(1);
+    }
+    int en_frontera = 0;
+    for (int i = 0; i < num_candidatas; i++) {
+        if (candidatas[i].descartada || candidatas[i].replicas == 0) continue;
+        int dominada = 0;
+        for (int j = 0; j < num_candidatas && !dominada; j++) {
+            if (j != i && !candidatas[j].descartada && candidatas[j].replicas > 0) {
+                dominada = domina(&candidatas[j], &candidatas[i]);
+            }
+        }
+        if (!dominada) frontera[en_frontera++] = &candidatas[i];
+    }
+    qsort(frontera, en_frontera, sizeof(CandidataPersonal*), comparar_por_costo);
+    
+    printf("\n");
+    escribir_frontera(stdout, frontera, en_frontera, rondas, jornadas);
+    
+    FILE* archivo = fopen("reporte_optimizacion.txt", "w");
+    if (!archivo) {
+        printf("Error al crear archivo de reporte\n");
+    } else {
+        escribir_encabezado_replicas(archivo, "REPORTE DE OPTIMIZACIÓN DE DOTACIÓN", ms);
+        escribir_frontera(archivo, frontera, en_frontera, rondas, jornadas);
+        fclose(archivo);
+        printf("\n📄 Reporte generado en 'reporte_optimizacion.txt'\n");
+    }
+    
+    free(frontera);
+    free(tareas_candidata);
+    free(tareas_replica);
+    for (int i = 0; i < num_candidatas; i++) {
+        free(candidatas[i].resultados);
+    }
+    free(candidatas);
+}
+
+// ============================================================
+// Banco de pruebas de rendimiento (--benchmark [--csv ARCHIVO])
+// ------------------------------------------------------------
+// Tres partes: micro-benchmarks de enqueue, enqueue_prioridad y dequeue
+// con 1..N productores y consumidores, distintas profundidades y mezclas
+// de prioridad (de a uno y por lotes de TAM_LOTE_COLA); el censo de esperas de una cola profunda; y jornadas
+// completas en modo eventos discretos (sin esperas) que miden eventos por
+// segundo y la latencia de cada evento.
+// Cada configuración es una fila del CSV, para comparar implementaciones
+// de cola y detectar regresiones entre versiones.
+// ============================================================
+
+#define OPERACIONES_BENCHMARK 200000    // Inserciones por configuración, repartidas entre productores
+#define MUESTREO_BENCHMARK 16           // Se cronometra una de cada 16 operaciones
+#define REPETICIONES_BENCHMARK 3        // Jornadas por escenario de punta a punta
+#define REPETICIONES_CENSO 200          // Censos de la cola completa
+
+typedef enum {
+    BANCO_FIFO_MUTEX,          // enqueue/dequeue sobre la cola segmentada con mutex
+    BANCO_FIFO_ANILLO,         // enqueue/dequeue sobre el anillo sin bloqueo (recepción)
+    BANCO_PRIORIDAD            // enqueue_prioridad/dequeue (colas de atención)
+} ColaBanco;
+
+typedef enum {
+    MEZCLA_FIJA,               // Todos con prioridad 3
+    MEZCLA_UNIFORME,           // Prioridades 1-5 por igual
+    MEZCLA_URGENTE             // 20% de urgencias (1) que adelantan al resto (5)
+} MezclaBanco;
+
+static const char* nombres_cola_banco[] = { "fifo_mutex", "fifo_anillo", "prioridad" };
+static const char* nombres_mezcla_banco[] = { "fija", "uniforme", "urgente" };
+
+typedef struct {
+    Cola* cola;
+    ColaBanco implementacion;
+    const HandlePaciente* handles;
+    int desde, hasta;          // Productor: porción de handles a insertar
+    int extracciones;          // Consumidor: cuántos extrae
+    int lote;                  // 1 = de a uno; más = operaciones por lotes
+    volatile int* largada;     // Todos arrancan juntos
+    HistogramaNanosegundos latencia;  // Nanosegundos por operación (muestreada)
+} HiloBanco;
+
+static void* productor_banco(void* arg) {
+    HiloBanco* hilo = arg;
+    while (!*hilo->largada) sched_yield();
+    
+    // Por lotes se cronometra el lote completo
+    ResultadoEncolado resultados[TAM_LOTE_COLA];
+    for (int i = hilo->desde; i < hilo->hasta; i += hilo->lote) {
+        int n = (hilo->hasta - i < hilo->lote) ? hilo->hasta - i : hilo->lote;
+        int medir = (i / hilo->lote % MUESTREO_BENCHMARK == 0);
+        long inicio = medir ? nanosegundos_monotonos() : 0;
+        if (hilo->lote > 1 && hilo->implementacion == BANCO_PRIORIDAD) {
+            enqueue_prioridad_varios(hilo->cola, &hilo->handles[i], n, resultados);
+        } else if (hilo->lote > 1) {
+            enqueue_varios(hilo->cola, &hilo->handles[i], n, resultados);
+        } else if (hilo->implementacion == BANCO_PRIORIDAD) {
+            enqueue_prioridad(hilo->cola, hilo->handles[i]);
+        } else {
+            enqueue(hilo->cola, hilo->handles[i]);
+        }
+        if (medir) anotar_nanosegundos(&hilo->latencia, nanosegundos_monotonos() - inicio);
+    }
+    return NULL;
+}
+
+static void* consumidor_banco(void* arg) {
+    HiloBanco* hilo = arg;
+    while (!*hilo->largada) sched_yield();
+    
+    HandlePaciente lote[TAM_LOTE_COLA];
+    for (int i = 0, vuelta = 0; i < hilo->extracciones; vuelta++) {
+        int medir = (vuelta % MUESTREO_BENCHMARK == 0);
+        long inicio = medir ? nanosegundos_monotonos() : 0;
+        if (hilo->lote > 1) {
+            int maximo = (hilo->extracciones - i < hilo->lote) ? hilo->extracciones - i : hilo->lote;
+            i += dequeue_varios(hilo->cola, lote, maximo);
+        } else {
+            dequeue(hilo->cola);
+            i++;
         }
-        
-        // Detectar colapso del sistema
-        int total_esperando = cola_recepcion.count + cola_medico_general.count + 
-                             cola_enfermeria.count;
-        for (int i = 0; i < 4; i++) {
-            total_esperando += cola_especialista[i].count;
+        if (medir) anotar_nanosegundos(&hilo->latencia, nanosegundos_monotonos() - inicio);
+    }
+    return NULL;
+}
+
+// Una fila del informe y del CSV ('latencia' NULL: sin percentiles, se escriben en 0)
+static void escribir_fila_banco(FILE* csv, const char* prueba, const char* implementacion,
+                                int productores, int consumidores, int profundidad, const char* mezcla,
+                                long operaciones, double segundos, const HistogramaNanosegundos* latencia) {
+    double por_segundo = operaciones / segundos;
+    double ns_por_operacion = segundos * 1e9 / operaciones;
+    long p50 = percentil_nanosegundos(latencia, 0.50);
+    long p99 = percentil_nanosegundos(latencia, 0.99);
+    
+    printf("  %-8s %-29s %2d/%-2d %6d %-8s %11.0f op/s %9.1f ns/op  p50 %6ld ns  p99 %6ld ns\n",
+           prueba, implementacion, productores, consumidores, profundidad, mezcla,
+           por_segundo, ns_por_operacion, p50, p99);
+    long desbordes = latencia->cubetas[NUM_CUBETAS_NANOSEGUNDOS - 1];
+    if (desbordes > 0) {
+        printf("  ⚠️  %ld muestras pasaron de %ld ns: los percentiles altos son una cota inferior\n",
+               desbordes, techo_cubeta_latencia(NUM_CUBETAS_NANOSEGUNDOS - 2));
+    }
+    fprintf(csv, "%s,%s,%d,%d,%d,%s,%ld,%.6f,%.1f,%.1f,%ld,%ld\n", prueba, implementacion,
+            productores, consumidores, profundidad, mezcla, operaciones, segundos,
+            por_segundo, ns_por_operacion, p50, p99);
+}
+
+// Una configuración del micro-benchmark sobre una cola recién creada. Los
+// consumidores extraen tantos como insertan los productores, así la cola
+// se mantiene cerca de la profundidad inicial. Con 'lote' > 1 se usan las
+// operaciones por lotes y los percentiles son por lote
+static void medir_cola(FILE* csv, ColaBanco implementacion, MezclaBanco mezcla, int productores,
+                       int consumidores, int profundidad, int lote, const HandlePaciente* handles) {
+    // Prioridades de la mezcla (las FIFO las ignoran)
+    int total_handles = profundidad + OPERACIONES_BENCHMARK;
+    for (int i = 0; i < total_handles; i++) {
+        Paciente* paciente = paciente_de(&clinica->arena_pacientes, handles[i]);
+        switch (mezcla) {
+            case MEZCLA_FIJA:     paciente->prioridad = 3; break;
+            case MEZCLA_UNIFORME: paciente->prioridad = aleatorio() % 5 + 1; break;
+            case MEZCLA_URGENTE:  paciente->prioridad = (aleatorio() % 100 < 20) ? 1 : 5; break;
         }
-        
-        if (total_esperando > 50) {
-            pthread_mutex_lock(&print_mutex);
-            printf("🆘 SISTEMA COLAPSADO: %d pacientes esperando en total!\n", total_esperando);
-            pthread_mutex_unlock(&print_mutex);
+    }
+    
+    Cola cola;
+    init_cola(&cola, &clinica->pool_segmentos, &clinica->arena_pacientes);
+    if (implementacion == BANCO_FIFO_ANILLO) {
+        uint64_t tamano = 1;
+        while (tamano < (uint64_t)total_handles) tamano <<= 1;
+        activar_anillo_cola(&cola, tamano);
+    }
+    for (int i = 0; i < profundidad; i++) {
+        if (implementacion == BANCO_PRIORIDAD) enqueue_prioridad(&cola, handles[i]);
+        else enqueue(&cola, handles[i]);
+    }
+    
+    volatile int largada = 0;
+    int num_hilos = productores + consumidores;
+    HiloBanco* hilos = calloc(num_hilos, sizeof(HiloBanco));
+    pthread_t* ids = malloc(num_hilos * sizeof(pthread_t));
+    if (!hilos || !ids) {
+        fprintf(stderr, "Sin memoria para el benchmark\n");
+        exit(1);
+    }
+    for (int i = 0; i < num_hilos; i++) {
+        HiloBanco* hilo = &hilos[i];
+        hilo->cola = &cola;
+        hilo->implementacion = implementacion;
+        hilo->handles = handles;
+        hilo->lote = lote;
+        hilo->largada = &largada;
+        if (i < productores) {
+            hilo->desde = profundidad + (long)OPERACIONES_BENCHMARK * i / productores;
+            hilo->hasta = profundidad + (long)OPERACIONES_BENCHMARK * (i + 1) / productores;
+            pthread_create(&ids[i], NULL, productor_banco, hilo);
+        } else {
+            int c = i - productores;
+            hilo->extracciones = (long)OPERACIONES_BENCHMARK * (c + 1) / consumidores -
+                                 (long)OPERACIONES_BENCHMARK * c / consumidores;
+            pthread_create(&ids[i], NULL, consumidor_banco, hilo);
         }
     }
     
-    return NULL;
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    largada = 1;
+    for (int i = 0; i < num_hilos; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    double segundos = milisegundos_desde(&inicio) / 1000.0;
+    
+    // Insertar y extraer se reportan por separado, con el mismo tiempo total
+    HistogramaNanosegundos insercion = {{0}}, extraccion = {{0}};
+    for (int i = 0; i < num_hilos; i++) {
+        combinar_nanosegundos((i < productores) ? &insercion : &extraccion, &hilos[i].latencia);
+    }
+    char implementacion_op[48];
+    const char* sufijo = (lote > 1) ? "_varios" : "";
+    snprintf(implementacion_op, sizeof(implementacion_op), "%s:%s%s", nombres_cola_banco[implementacion],
+             (implementacion == BANCO_PRIORIDAD) ? "enqueue_prioridad" : "enqueue", sufijo);
+    escribir_fila_banco(csv, "cola", implementacion_op, productores, consumidores, profundidad,
+                        nombres_mezcla_banco[mezcla], OPERACIONES_BENCHMARK, segundos, &insercion);
+    snprintf(implementacion_op, sizeof(implementacion_op), "%s:dequeue%s", nombres_cola_banco[implementacion],
+             sufijo);
+    escribir_fila_banco(csv, "cola", implementacion_op, productores, consumidores, profundidad,
+                        nombres_mezcla_banco[mezcla], OPERACIONES_BENCHMARK, segundos, &extraccion);
+    
+    destruir_cola(&cola);
+    free(hilos);
+    free(ids);
 }
-void* contador_tiempo(void* arg) {
-    (void)arg;
+
+// Censo de una cola de atención con 'profundidad' pacientes esperando (los
+// primeros de 'handles', que quedan consumidos) con prioridades, esperas y
+// plazos al azar y un 5% de lápidas. Cada censo se cronometra por separado
+static void medir_censo(FILE* csv, const HandlePaciente* handles, int profundidad) {
+    Cola cola;
+    init_cola(&cola, &clinica->pool_segmentos, &clinica->arena_pacientes);
+    cola.con_abandonos = 1;
+    for (int i = 0; i < profundidad; i++) {
+        Paciente* paciente = paciente_de(&clinica->arena_pacientes, handles[i]);
+        paciente->id = i + 1;
+        paciente->prioridad = aleatorio() % 5 + 1;
+        paciente->tiempo_llegada = aleatorio() % 3600;
+        paciente->plazo_abandono = (aleatorio() % 4) ? 3600 + aleatorio() % 7200 : PLAZO_NINGUNO;
+        enqueue_prioridad(&cola, handles[i]);
+    }
+    int lapidas = 0;
+    Paciente copia;
+    for (int i = 0; i < profundidad; i += 20, lapidas++) {
+        retirar_de_cola(&cola, handles[i], i + 1, &copia);
+    }
     
-    while (simulacion_activa) {
-        sleep(10); // Cada 10 segundos reales
-        
-        if (!simulacion_activa) break;
-        
-        time_t tiempo_actual = time(NULL);
-        int tiempo_real_transcurrido = tiempo_actual - tiempo_inicio_simulacion;
-        int tiempo_simulacion_transcurrido = tiempo_real_transcurrido * SPEED_FACTOR;
-        
-        // Convertir a formato legible
-        int horas_real = tiempo_real_transcurrido / 3600;
-        int minutos_real = (tiempo_real_transcurrido % 3600) / 60;
-        int segundos_real = tiempo_real_transcurrido % 60;
-        
-        int horas_sim = tiempo_simulacion_transcurrido / 3600;
-        int minutos_sim = (tiempo_simulacion_transcurrido % 3600) / 60;
-        int segundos_sim = tiempo_simulacion_transcurrido % 60;
-        
-        pthread_mutex_lock(&print_mutex);
-        printf("\n⏰ TIEMPO TRANSCURRIDO:\n");
-        printf("   Real: %02d:%02d:%02d | Simulación: %02d:%02d:%02d (x%d)\n", 
-               horas_real, minutos_real, segundos_real,
-               horas_sim, minutos_sim, segundos_sim, SPEED_FACTOR);
-        printf("   Pacientes: Gen=%d, Clas=%d, Atend=%d, Aband=%d\n\n", 
-               total_pacientes_generados, total_pacientes_clasificados,
-               total_pacientes_atendidos, total_pacientes_abandonaron);
-        pthread_mutex_unlock(&print_mutex);
+    CensoCola censo;
+    HistogramaNanosegundos latencia = {{0}};
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    for (int r = 0; r < REPETICIONES_CENSO; r++) {
+        long desde = nanosegundos_monotonos();
+        censar_cola(&cola, 3600, 3600 + HORIZONTE_CENSO, &censo);
+        anotar_nanosegundos(&latencia, nanosegundos_monotonos() - desde);
     }
+    double segundos = milisegundos_desde(&inicio) / 1000.0;
+    if (censo.total != profundidad - lapidas) {
+        fprintf(stderr, "El censo contó %ld pacientes en lugar de %d\n", censo.total, profundidad - lapidas);
+        exit(1);
+    }
+    escribir_fila_banco(csv, "censo", "columnas_segmento", 1, 0, profundidad, "uniforme",
+                        REPETICIONES_CENSO, segundos, &latencia);
     
-    return NULL;
+    // Vaciarla recicla las lápidas (esos handles no se vuelven a usar)
+    while (intentar_dequeue(&cola) != HANDLE_NULO) {
+    }
+    destruir_cola(&cola);
 }
-void* monitor_sistema(void* arg) {
-    (void)arg;
+
+// Jornadas completas en modo eventos discretos: eventos por segundo y
+// nanosegundos por evento (cola de eventos, rueda y lógica de la clínica).
+// En el CSV la columna profundidad lleva la capacidad de las colas (0 = sin límite)
+static void medir_jornadas(FILE* csv, const char* escenario, int duracion, int capacidad,
+                           PoliticaDesborde politica) {
+    int duracion_original = duracion_jornada, capacidad_original = capacidad_colas;
+    PoliticaDesborde politica_original = politica_desborde;
+    duracion_jornada = duracion;
+    capacidad_colas = capacidad;
+    politica_desborde = politica;
     
-    while (simulacion_activa) {
-        dormir_simulacion(300); // Cada 5 minutos de simulación
-        
-        if (!simulacion_activa) break;
+    Clinica* propia = malloc(sizeof(Clinica));
+    HistogramaNanosegundos* latencia = calloc(1, sizeof(HistogramaNanosegundos));
+    if (!propia || !latencia) {
+        fprintf(stderr, "Sin memoria para el benchmark\n");
+        exit(1);
+    }
+    
+    long eventos = 0;
+    double segundos = 0;
+    for (int r = 0; r < REPETICIONES_BENCHMARK; r++) {
+        preparar_clinica(propia, &personal_configurado);
+        usar_clinica(propia);
+        sembrar_aleatorio(FLUJO_REPLICA(r));
+        inicializar_personal();
+        propia->latencia_eventos = latencia;
         
-        pthread_mutex_lock(&print_mutex);
-        printf("\n=== ESTADO DEL SISTEMA ===\n");
-        printf("Pacientes en recepción: %d\n", cola_recepcion.count);
-        printf("Pacientes esperando médico general: %d\n", cola_medico_general.count);
-        printf("Pacientes esperando enfermería: %d\n", cola_enfermeria.count);
+        struct timespec inicio;
+        clock_gettime(CLOCK_MONOTONIC, &inicio);
+        ejecutar_eventos_discretos();
+        segundos += milisegundos_desde(&inicio) / 1000.0;
+        eventos += propia->eventos_procesados;
         
-        for (int i = 0; i < 4; i++) {
-            const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
-            printf("Pacientes esperando %s: %d\n", especialidades[i], cola_especialista[i].count);
+        liberar_clinica(propia);
+    }
+    usar_clinica(&clinica_principal);
+    
+    escribir_fila_banco(csv, "jornada", escenario, 1, 1, capacidad, "modelo", eventos, segundos, latencia);
+    
+    free(latencia);
+    free(propia);
+    duracion_jornada = duracion_original;
+    capacidad_colas = capacidad_original;
+    politica_desborde = politica_original;
+}
+
+void ejecutar_benchmark(const char* ruta_csv) {
+    FILE* csv = fopen(ruta_csv, "w");
+    if (!csv) {
+        fprintf(stderr, "No se pudo crear '%s'\n", ruta_csv);
+        exit(1);
+    }
+    fprintf(csv, "prueba,implementacion,productores,consumidores,profundidad,mezcla,"
+                 "operaciones,segundos,ops_por_segundo,ns_por_op,p50_ns,p99_ns\n");
+    
+    // Pacientes de la clínica principal como carga: enqueue_prioridad lee su prioridad
+    static const int profundidades[] = { 0, 10000 };
+    const int max_profundidad = 10000;
+    preparar_clinica(&clinica_principal, &personal_configurado);
+    usar_clinica(&clinica_principal);
+    sembrar_aleatorio(FLUJO_PRINCIPAL);
+    int total_handles = max_profundidad + OPERACIONES_BENCHMARK;
+    HandlePaciente* handles = malloc(total_handles * sizeof(HandlePaciente));
+    if (!handles) {
+        fprintf(stderr, "Sin memoria para el benchmark\n");
+        exit(1);
+    }
+    for (int i = 0; i < total_handles; i++) {
+        handles[i] = reservar_paciente(&clinica->arena_pacientes);
+        if (handles[i] == HANDLE_NULO) {
+            fprintf(stderr, "Sin memoria para los pacientes del benchmark\n");
+            exit(1);
         }
-        
-        printf("Total generados: %d, Clasificados: %d, Atendidos: %d, Abandonaron: %d\n", 
-               total_pacientes_generados, total_pacientes_clasificados, 
-               total_pacientes_atendidos, total_pacientes_abandonaron);
-        
-        printf("Personal administrativo activos: %d/%d - ", admin_activos, num_admin);
-        for (int i = 0; i < num_admin; i++) {
-            if (i < admin_activos) {
-                printf("%s%d", (i > 0) ? ", " : "", personal_admin[i].ocupado);
-            } else {
-                printf("%s0", (i > 0) ? ", " : ""); // Inactivo
+    }
+    
+    // 1 y N hilos de cada lado (N = --hilos, o un hilo por núcleo; al menos 2)
+    int n = hilos_configurados() < 2 ? 2 : hilos_replicas;
+    const int combinaciones[][2] = { {1, 1}, {1, n}, {n, 1}, {n, n} };
+    
+    printf("\n⏱️  Colas: %d inserciones por configuración\n", OPERACIONES_BENCHMARK);
+    for (int impl = BANCO_FIFO_MUTEX; impl <= BANCO_PRIORIDAD; impl++) {
+        int mezclas = (impl == BANCO_PRIORIDAD) ? 3 : 1;
+        for (int m = 0; m < mezclas; m++) {
+            for (int c = 0; c < 4; c++) {
+                for (int d = 0; d < 2; d++) {
+                    medir_cola(csv, impl, m, combinaciones[c][0], combinaciones[c][1],
+                               profundidades[d], 1, handles);
+                }
             }
         }
-        printf("\n");
-        
-        printf("Médicos ocupados: ");
-        int total_medicos = num_medicos_general + num_enfermeras + num_especialistas;
-        for (int i = 0; i < total_medicos; i++) {
-            printf("%s%d", (i > 0) ? ", " : "", medicos[i].ocupado);
+    }
+    
+    printf("\n⏱️  Colas por lotes de %d: %d inserciones por configuración\n", TAM_LOTE_COLA,
+           OPERACIONES_BENCHMARK);
+    for (int impl = BANCO_FIFO_MUTEX; impl <= BANCO_PRIORIDAD; impl++) {
+        MezclaBanco mezcla = (impl == BANCO_PRIORIDAD) ? MEZCLA_UNIFORME : MEZCLA_FIJA;
+        for (int c = 0; c < 4; c++) {
+            medir_cola(csv, impl, mezcla, combinaciones[c][0], combinaciones[c][1], 0, TAM_LOTE_COLA,
+                       handles);
         }
-        printf("\n");
-        
-        printf("========================\n\n");
-        pthread_mutex_unlock(&print_mutex);
     }
     
-    return NULL;
+    printf("\n⏱️  Censo de esperas en una cola (%d recorridos)\n", REPETICIONES_CENSO);
+    medir_censo(csv, handles, max_profundidad);
+    medir_censo(csv, handles + max_profundidad, total_handles - max_profundidad);
+    free(handles);
+    liberar_clinica(&clinica_principal);
+    
+    printf("\n⏱️  Jornadas en eventos discretos (%d por escenario)\n", REPETICIONES_BENCHMARK);
+    medir_jornadas(csv, "8h", 8 * 3600, 0, POLITICA_RECHAZAR);
+    medir_jornadas(csv, "8h_acotada", 8 * 3600, 50, POLITICA_BLOQUEAR);
+    medir_jornadas(csv, "semana", 7 * 24 * 3600, 200, POLITICA_RECHAZAR);
+    
+    fclose(csv);
+    printf("\n📄 Resultados en '%s'\n", ruta_csv);
 }
 
-// Función para generar reporte final
-void generar_reporte() {
-    FILE* archivo = fopen("reporte_diario.txt", "w");
-    if (!archivo) {
-        printf("Error al crear archivo de reporte\n");
-        return;
+// ============================================================
+// Analizador de trazas (--analizar-traza ARCHIVO [--paciente ID])
+// ------------------------------------------------------------
+// Recorre la traza mapeada en memoria sin ordenarla: el largo de cada
+// cola se reconstruye sumando variaciones por minuto y la ocupación del
+// personal con sumas de inicios y fines, que no dependen del orden en
+// que los hilos dejaron sus bloques. Solo el recorrido de un paciente
+// se ordena, y son unos pocos registros.
+// ============================================================
+
+static const char* nombres_eventos_traza[NUM_EVENTOS_TRAZA] = {
+    "vacío", "llegada", "encolado", "desencolado", "rechazado",
+    "inicio clasificación", "fin clasificación", "inicio atención", "fin atención", "abandono"
+};
+
+typedef struct {
+    const CabeceraTraza* cabecera;
+    long eventos[NUM_EVENTOS_TRAZA];
+    int64_t tiempo_final;
+    long minutos;
+    long* largos;              // [minuto][cola]: pacientes al final de cada minuto
+    int max_largo[NUM_COLAS_CLINICA];
+    double largo_medio[NUM_COLAS_CLINICA];
+    double* ocupado_admin;     // Segundos ocupados, por admin
+    double* ocupado_medico;
+    long* tareas_admin;
+    long* tareas_medico;
+    RegistroTraza* recorrido;  // Eventos del paciente pedido, en orden
+    long num_recorrido;
+} AnalisisTraza;
+
+static int comparar_secuencia(const void* a, const void* b) {
+    uint64_t x = ((const RegistroTraza*)a)->secuencia;
+    uint64_t y = ((const RegistroTraza*)b)->secuencia;
+    return (x > y) - (x < y);
+}
+
+static void analizar_registros(AnalisisTraza* analisis, const RegistroTraza* registros, long n,
+                               long id_paciente) {
+    // Primera pasada: conteos, fin de la traza y variaciones de ocupación
+    int num_admin = analisis->cabecera->num_admin, num_medicos = analisis->cabecera->num_medicos;
+    long* inicios_admin = calloc(num_admin + 1, sizeof(long));
+    long* inicios_medico = calloc(num_medicos + 1, sizeof(long));
+    double* suma_admin = calloc(num_admin + 1, sizeof(double));
+    double* suma_medico = calloc(num_medicos + 1, sizeof(double));
+    if (!inicios_admin || !inicios_medico || !suma_admin || !suma_medico) {
+        fprintf(stderr, "Sin memoria para analizar la traza\n");
+        exit(1);
     }
     
-    time_t ahora = time(NULL);
-    int duracion_real = ahora - tiempo_inicio_simulacion;
-    int duracion_simulacion = duracion_real * SPEED_FACTOR;
+    for (long i = 0; i < n; i++) {
+        const RegistroTraza* r = &registros[i];
+        if (r->evento == TRAZA_VACIO || r->evento >= NUM_EVENTOS_TRAZA) continue;
+        analisis->eventos[r->evento]++;
+        if (r->tiempo > analisis->tiempo_final) analisis->tiempo_final = r->tiempo;
+        if (id_paciente > 0 && r->paciente == (uint32_t)id_paciente) analisis->num_recorrido++;
+        
+        int p = r->personal;
+        switch (r->evento) {
+            case TRAZA_INICIO_CLASIFICACION:
+                if (p >= 0 && p < num_admin) { inicios_admin[p]++; suma_admin[p] -= r->tiempo; }
+                break;
+            case TRAZA_FIN_CLASIFICACION:
+                if (p >= 0 && p < num_admin) { analisis->tareas_admin[p]++; suma_admin[p] += r->tiempo; }
+                break;
+            case TRAZA_INICIO_ATENCION:
+                if (p >= 0 && p < num_medicos) { inicios_medico[p]++; suma_medico[p] -= r->tiempo; }
+                break;
+            case TRAZA_FIN_ATENCION:
+                if (p >= 0 && p < num_medicos) { analisis->tareas_medico[p]++; suma_medico[p] += r->tiempo; }
+                break;
+        }
+    }
     
-    fprintf(archivo, "REPORTE DIARIO DE ATENCIÓN MÉDICA\n");
-    fprintf(archivo, "Fecha: %s", ctime(&ahora));
-    fprintf(archivo, "Factor de velocidad utilizado: x%d\n", SPEED_FACTOR);
-    fprintf(archivo, "Duración real: %d segundos (%d:%02d:%02d)\n", 
-            duracion_real, duracion_real/3600, (duracion_real%3600)/60, duracion_real%60);
-    fprintf(archivo, "Duración simulada: %d segundos (%d:%02d:%02d)\n",
-            duracion_simulacion, duracion_simulacion/3600, (duracion_simulacion%3600)/60, duracion_simulacion%60);
-    fprintf(archivo, "================================\n\n");
+    // Las tareas sin fin en la traza cuentan hasta el último evento registrado
+    for (int i = 0; i < num_admin; i++) {
+        analisis->ocupado_admin[i] = suma_admin[i] +
+            (double)(inicios_admin[i] - analisis->tareas_admin[i]) * analisis->tiempo_final;
+    }
+    for (int i = 0; i < num_medicos; i++) {
+        analisis->ocupado_medico[i] = suma_medico[i] +
+            (double)(inicios_medico[i] - analisis->tareas_medico[i]) * analisis->tiempo_final;
+    }
+    free(inicios_admin);
+    free(inicios_medico);
+    free(suma_admin);
+    free(suma_medico);
     
-    fprintf(archivo, "RESUMEN GENERAL:\n");
-    fprintf(archivo, "- Pacientes generados: %d\n", total_pacientes_generados);
-    fprintf(archivo, "- Pacientes clasificados: %d\n", total_pacientes_clasificados);
-    fprintf(archivo, "- Pacientes atendidos: %d\n", total_pacientes_atendidos);
-    fprintf(archivo, "- Pacientes que abandonaron: %d\n", total_pacientes_abandonaron);
+    // Segunda pasada: variaciones del largo de cada cola por minuto y recorrido
+    analisis->minutos = analisis->tiempo_final / 60 + 1;
+    analisis->largos = calloc(analisis->minutos * NUM_COLAS_CLINICA, sizeof(long));
+    analisis->recorrido = malloc((analisis->num_recorrido + 1) * sizeof(RegistroTraza));
+    if (!analisis->largos || !analisis->recorrido) {
+        fprintf(stderr, "Sin memoria para analizar la traza\n");
+        exit(1);
+    }
+    long en_recorrido = 0;
+    for (long i = 0; i < n; i++) {
+        const RegistroTraza* r = &registros[i];
+        if (r->evento == TRAZA_VACIO || r->evento >= NUM_EVENTOS_TRAZA) continue;
+        if (id_paciente > 0 && r->paciente == (uint32_t)id_paciente) {
+            analisis->recorrido[en_recorrido++] = *r;
+        }
+        if (r->cola < 0 || r->cola >= NUM_COLAS_CLINICA) continue;
+        
+        long* variacion = &analisis->largos[(r->tiempo / 60) * NUM_COLAS_CLINICA + r->cola];
+        if (r->evento == TRAZA_ENCOLADO) (*variacion)++;
+        else if (r->evento == TRAZA_DESENCOLADO || r->evento == TRAZA_ABANDONO) (*variacion)--;
+    }
+    qsort(analisis->recorrido, analisis->num_recorrido, sizeof(RegistroTraza), comparar_secuencia);
     
-    // Calcular no contabilizados (en recepción)
-    total_no_contabilizados = cola_recepcion.count;
-    fprintf(archivo, "- Pacientes no contabilizados (en recepción): %d\n", total_no_contabilizados);
+    // Acumular: de variaciones a largo al final de cada minuto
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) {
+        long largo = 0, suma = 0;
+        for (long m = 0; m < analisis->minutos; m++) {
+            largo += analisis->largos[m * NUM_COLAS_CLINICA + c];
+            analisis->largos[m * NUM_COLAS_CLINICA + c] = largo;
+            if (largo > analisis->max_largo[c]) analisis->max_largo[c] = largo;
+            suma += largo;
+        }
+        analisis->largo_medio[c] = (double)suma / analisis->minutos;
+    }
+}
+
+static void escribir_analisis_traza(FILE* salida, const AnalisisTraza* analisis, long registros) {
+    const CabeceraTraza* cabecera = analisis->cabecera;
+    const char* nombres_colas[] = { "Recepción", "Médico general", "Enfermería",
+                                    "Cardiología", "Neurología", "Pediatría", "Dermatología" };
+    const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
+    const char* tipos_medico[] = { "Médico General", "Enfermera", "Especialista" };
     
-    // Pacientes sin atención (clasificados pero no atendidos)
-    int sin_atencion = (cola_medico_general.count + cola_enfermeria.count);
-    for (int i = 0; i < 4; i++) {
-        sin_atencion += cola_especialista[i].count;
+    fprintf(salida, "Semilla: %llu | %s | %ld registros | %d:%02d:%02d simulados\n",
+            (unsigned long long)cabecera->semilla,
+            cabecera->factor_velocidad ? "modo con hilos" : "eventos discretos", registros,
+            (int)(analisis->tiempo_final / 3600), (int)(analisis->tiempo_final % 3600 / 60),
+            (int)(analisis->tiempo_final % 60));
+    
+    fprintf(salida, "\nEVENTOS:\n");
+    for (int e = 1; e < NUM_EVENTOS_TRAZA; e++) {
+        fprintf(salida, "- %s: %ld\n", nombres_eventos_traza[e], analisis->eventos[e]);
     }
-    fprintf(archivo, "- Pacientes sin atención (clasificados, no atendidos): %d\n\n", sin_atencion);
     
-    // Eficiencia del sistema
-    if (total_pacientes_generados > 0) {
-        float eficiencia = ((float)total_pacientes_atendidos / total_pacientes_generados) * 100;
-        fprintf(archivo, "- Eficiencia del sistema: %.2f%%\n\n", eficiencia);
+    fprintf(salida, "\nLARGO DE LAS COLAS (al final de cada minuto):\n");
+    for (int c = 0; c < NUM_COLAS_CLINICA; c++) {
+        fprintf(salida, "- %s: máximo %d, promedio %.1f\n",
+                nombres_colas[c], analisis->max_largo[c], analisis->largo_medio[c]);
     }
     
-    fprintf(archivo, "PERSONAL ADMINISTRATIVO:\n");
-    for (int i = 0; i < MAX_ADMIN; i++) {
-        fprintf(archivo, "- Admin %d: %d pacientes clasificados %s\n", 
-                personal_admin[i].id, personal_admin[i].pacientes_clasificados,
-                (i < admin_activos) ? "(activo)" : "(inactivo al final)");
+    // Línea de tiempo: unas 16 filas sin importar la duración
+    long paso = (analisis->minutos + 15) / 16;
+    if (paso < 1) paso = 1;
+    fprintf(salida, "\n  Hora    Recep  Gral  Enf  Card  Neur  Ped  Derm\n");
+    for (long m = paso - 1; m < analisis->minutos; m += paso) {
+        const long* fila = &analisis->largos[m * NUM_COLAS_CLINICA];
+        fprintf(salida, "  %2ld:%02ld  %5ld %5ld %4ld %5ld %5ld %4ld %5ld\n", (m + 1) / 60, (m + 1) % 60,
+                fila[0], fila[1], fila[2], fila[3], fila[4], fila[5], fila[6]);
     }
     
-    fprintf(archivo, "\nPERSONAL MÉDICO:\n");
-    for (int i = 0; i < num_medicos_general; i++) {
-        fprintf(archivo, "- Médico General %d: %d pacientes atendidos\n", 
-                medicos[i].id, medicos[i].pacientes_atendidos);
+    double jornada = analisis->tiempo_final > 0 ? analisis->tiempo_final : 1;
+    fprintf(salida, "\nUTILIZACIÓN DEL PERSONAL:\n");
+    for (int i = 0; i < cabecera->num_admin; i++) {
+        fprintf(salida, "- Admin %d: %.1f%% (%ld clasificaciones)\n",
+                i + 1, 100.0 * analisis->ocupado_admin[i] / jornada, analisis->tareas_admin[i]);
+    }
+    for (int i = 0; i < cabecera->num_medicos; i++) {
+        int tipo = cabecera->medicos[i].tipo < 3 ? cabecera->medicos[i].tipo : 0;
+        fprintf(salida, "- %s%s%s %d: %.1f%% (%ld consultas)\n", tipos_medico[tipo],
+                (tipo == ATENCION_ESPECIALIDAD) ? " " : "",
+                (tipo == ATENCION_ESPECIALIDAD) ? especialidades[cabecera->medicos[i].especialidad % 4] : "",
+                i + 1, 100.0 * analisis->ocupado_medico[i] / jornada, analisis->tareas_medico[i]);
     }
     
-    for (int i = 0; i < num_enfermeras; i++) {
-        int idx = num_medicos_general + i;
-        fprintf(archivo, "- Enfermera %d: %d pacientes atendidos\n", 
-                medicos[idx].id, medicos[idx].pacientes_atendidos);
+    if (analisis->num_recorrido > 0) {
+        fprintf(salida, "\nRECORRIDO DEL PACIENTE %u (prioridad %d):\n",
+                analisis->recorrido[0].paciente, analisis->recorrido[0].prioridad);
+        for (long i = 0; i < analisis->num_recorrido; i++) {
+            const RegistroTraza* r = &analisis->recorrido[i];
+            fprintf(salida, "  %2d:%02d:%02d  %s", (int)(r->tiempo / 3600), (int)(r->tiempo % 3600 / 60),
+                    (int)(r->tiempo % 60), nombres_eventos_traza[r->evento]);
+            if (r->cola >= 0 && r->cola < NUM_COLAS_CLINICA) fprintf(salida, " (%s)", nombres_colas[r->cola]);
+            if (r->personal >= 0) {
+                int es_admin = (r->evento == TRAZA_INICIO_CLASIFICACION || r->evento == TRAZA_FIN_CLASIFICACION);
+                fprintf(salida, " [%s %d]", es_admin ? "admin" : "médico", r->personal + 1);
+            }
+            fprintf(salida, "\n");
+        }
+    }
+}
+
+void analizar_traza(const char* ruta, long id_paciente) {
+    int fd = open(ruta, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size < (off_t)sizeof(CabeceraTraza)) {
+        fprintf(stderr, "No se pudo leer la traza '%s'\n", ruta);
+        exit(1);
     }
     
-    const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
-    for (int i = 0; i < num_especialistas; i++) {
-        int idx = num_medicos_general + num_enfermeras + i;
-        fprintf(archivo, "- Especialista %s %d: %d pacientes atendidos\n", 
-                especialidades[medicos[idx].especialidad], medicos[idx].id, medicos[idx].pacientes_atendidos);
+    const char* datos = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (datos == MAP_FAILED) {
+        fprintf(stderr, "No se pudo mapear la traza '%s'\n", ruta);
+        exit(1);
     }
+    madvise((void*)datos, info.st_size, MADV_SEQUENTIAL);
     
-    fprintf(archivo, "\nCOLAS AL FINAL DE LA JORNADA:\n");
-    fprintf(archivo, "- En recepción: %d pacientes\n", cola_recepcion.count);
-    fprintf(archivo, "- Esperando médico general: %d pacientes\n", cola_medico_general.count);
-    fprintf(archivo, "- Esperando enfermería: %d pacientes\n", cola_enfermeria.count);
-    for (int i = 0; i < 4; i++) {
-        fprintf(archivo, "- Esperando %s: %d pacientes\n", especialidades[i], cola_especialista[i].count);
+    const CabeceraTraza* cabecera = (const CabeceraTraza*)datos;
+    if (memcmp(cabecera->magia, MAGIA_TRAZA, 8) != 0 || cabecera->version != VERSION_TRAZA ||
+        cabecera->tam_registro != sizeof(RegistroTraza) ||
+        cabecera->num_admin < 0 || cabecera->num_admin > MAX_ADMIN ||
+        cabecera->num_medicos < 0 || cabecera->num_medicos > MAX_MEDICOS ||
+        cabecera->tam_cabecera != tam_cabecera_traza(cabecera->num_medicos) ||
+        (off_t)cabecera->tam_cabecera > info.st_size) {
+        fprintf(stderr, "'%s' no es una traza válida de esta versión\n", ruta);
+        exit(1);
     }
     
-    fclose(archivo);
-    printf("\n📄 Reporte generado en 'reporte_diario.txt'\n");
+    const RegistroTraza* registros = (const RegistroTraza*)(datos + cabecera->tam_cabecera);
+    long n = (info.st_size - cabecera->tam_cabecera) / sizeof(RegistroTraza);
+    
+    struct timespec inicio;
+    clock_gettime(CLOCK_MONOTONIC, &inicio);
+    AnalisisTraza analisis = { .cabecera = cabecera,
+                               .ocupado_admin = calloc(cabecera->num_admin + 1, sizeof(double)),
+                               .ocupado_medico = calloc(cabecera->num_medicos + 1, sizeof(double)),
+                               .tareas_admin = calloc(cabecera->num_admin + 1, sizeof(long)),
+                               .tareas_medico = calloc(cabecera->num_medicos + 1, sizeof(long)) };
+    if (!analisis.ocupado_admin || !analisis.ocupado_medico || !analisis.tareas_admin || !analisis.tareas_medico) {
+        fprintf(stderr, "Sin memoria para analizar la traza\n");
+        exit(1);
+    }
+    analizar_registros(&analisis, registros, n, id_paciente);
+    long registros_validos = 0;
+    for (int e = 1; e < NUM_EVENTOS_TRAZA; e++) registros_validos += analisis.eventos[e];
+    printf("🔎 Traza '%s' analizada en %.2f ms\n", ruta, milisegundos_desde(&inicio));
+    
+    escribir_analisis_traza(stdout, &analisis, registros_validos);
+    FILE* archivo = fopen("reporte_traza.txt", "w");
+    if (!archivo) {
+        printf("Error al crear archivo de reporte\n");
+    } else {
+        fprintf(archivo, "ANÁLISIS DE TRAZA: %s\n", ruta);
+        escribir_analisis_traza(archivo, &analisis, registros_validos);
+        fclose(archivo);
+        printf("\n📄 Reporte generado en 'reporte_traza.txt'\n");
+    }
+    if (id_paciente > 0 && analisis.num_recorrido == 0) {
+        printf("⚠️  El paciente %ld no aparece en la traza\n", id_paciente);
+    }
+    
+    free(analisis.largos);
+    free(analisis.recorrido);
+    free(analisis.ocupado_admin);
+    free(analisis.ocupado_medico);
+    free(analisis.tareas_admin);
+    free(analisis.tareas_medico);
+    munmap((void*)datos, info.st_size);
+    close(fd);
 }
 
 // Función principal
 int main(int argc, char* argv[]) {
-    // Parsear factor de velocidad
-    if (argc > 1) {
-        if (strcmp(argv[1], "x2") == 0) SPEED_FACTOR = 2;
-        else if (strcmp(argv[1], "x4") == 0) SPEED_FACTOR = 4;
-        else if (strcmp(argv[1], "x10") == 0) SPEED_FACTOR = 10;
-        else if (strcmp(argv[1], "x1") == 0) SPEED_FACTOR = 1;
+    // Parsear factor de velocidad y modo de simulación
+    int log_indicado = 0;
+    int semilla_indicada = 0;
+    const char* ruta_traza = NULL;
+    const char* traza_a_analizar = NULL;
+    long paciente_buscado = 0;
+    const char* metricas_a_publicar = NULL;
+    const char* ruta_llegadas = NULL;
+    int modo_benchmark = 0;
+    const char* ruta_csv = "benchmark.csv";
+    const char* metricas_a_leer = NULL;
+    const char* ruta_serie = NULL;
+    const char* serie_a_leer = NULL;
+    int intervalo_lectura = 1000;
+    const char* estado_a_restaurar = NULL;
+    int personal_indicado = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "x2") == 0) SPEED_FACTOR = 2;
+        else if (strcmp(argv[i], "x4") == 0) SPEED_FACTOR = 4;
+        else if (strcmp(argv[i], "x10") == 0) SPEED_FACTOR = 10;
+        else if (strcmp(argv[i], "x1") == 0) SPEED_FACTOR = 1;
+        else if (strcmp(argv[i], "--des") == 0) modo_eventos_discretos = 1;
+        else if (strcmp(argv[i], "--mn") == 0) modo_agentes_mn = 1;
+        else if (strcmp(argv[i], "--duracion") == 0 && i + 1 < argc) {
+            char* fin;
+            long segundos = strtol(argv[++i], &fin, 10);
+            if (*fin != '\0' || segundos < 1 || segundos > 7 * 24 * 3600) {
+                fprintf(stderr, "Uso: --duracion SEGUNDOS (entre 1 y %d)\n", 7 * 24 * 3600);
+                exit(1);
+            }
+            duracion_jornada = (int)segundos;
+        }
+        else if (strcmp(argv[i], "--recepcion-mutex") == 0) recepcion_sin_bloqueo = 0;
+        else if (strcmp(argv[i], "--anillo") == 0 && i + 1 < argc) {
+            char* fin;
+            unsigned long long celdas = strtoull(argv[++i], &fin, 10);
+            if (*fin != '\0' || celdas < 2 || celdas > (1ull << 30)) {
+                fprintf(stderr, "Uso: --anillo CELDAS (entre 2 y %llu)\n", 1ull << 30);
+                exit(1);
+            }
+            celdas_anillo_recepcion = celdas;
+        }
+        else if (strcmp(argv[i], "--semilla") == 0 && i + 1 < argc) {
+            char* fin;
+            semilla_global = strtoull(argv[++i], &fin, 10);
+            if (*fin != '\0') {
+                fprintf(stderr, "Uso: --semilla N (entero sin signo)\n");
+                exit(1);
+            }
+            semilla_indicada = 1;
+        }
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            i++;
+            log_indicado = 1;
+            if (strcmp(argv[i], "silencio") == 0) nivel_log = NIVEL_SILENCIO;
+            else if (strcmp(argv[i], "error") == 0) nivel_log = NIVEL_ERROR;
+            else if (strcmp(argv[i], "aviso") == 0) nivel_log = NIVEL_AVISO;
+            else if (strcmp(argv[i], "info") == 0) nivel_log = NIVEL_INFO;
+            else if (strcmp(argv[i], "debug") == 0) nivel_log = NIVEL_DEBUG;
+            else {
+                fprintf(stderr, "Uso: --log silencio|error|aviso|info|debug\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--capacidad") == 0 && i + 1 < argc) {
+            char* fin;
+            long capacidad = strtol(argv[++i], &fin, 10);
+            if (fin == argv[i] || *fin != '\0' || capacidad < 0 || capacidad > (1l << 30)) {
+                fprintf(stderr, "Uso: --capacidad N (entre 0 y %ld; 0 = sin límite)\n", 1l << 30);
+                exit(1);
+            }
+            capacidad_colas = (int)capacidad;
+        }
+        else if (strcmp(argv[i], "--politica") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "bloquear") == 0) politica_desborde = POLITICA_BLOQUEAR;
+            else if (strcmp(argv[i], "desviar") == 0) politica_desborde = POLITICA_DESVIAR;
+            else if (strcmp(argv[i], "rechazar") == 0) politica_desborde = POLITICA_RECHAZAR;
+            else {
+                fprintf(stderr, "Uso: --politica bloquear|rechazar|desviar\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--replicas") == 0 && i + 1 < argc) {
+            char* fin;
+            long replicas = strtol(argv[++i], &fin, 10);
+            if (*fin != '\0' || replicas < 1 || replicas > 1000000) {
+                fprintf(stderr, "Uso: --replicas N (entre 1 y %d)\n", 1000000);
+                exit(1);
+            }
+            num_replicas = (int)replicas;
+            modo_eventos_discretos = 1;
+        }
+        else if (strcmp(argv[i], "--red") == 0 && i + 1 < argc) {
+            num_sedes = atoi(argv[++i]);
+            if (num_sedes < 1 || num_sedes > MAX_SEDES) {
+                fprintf(stderr, "Uso: --red N (entre 1 y %d sedes)\n", MAX_SEDES);
+                exit(1);
+            }
+            modo_eventos_discretos = 1;
+        }
+        else if (strcmp(argv[i], "--hilos") == 0 && i + 1 < argc) {
+            char* fin;
+            long hilos = strtol(argv[++i], &fin, 10);
+            if (*fin != '\0' || hilos < 1 || hilos > 1024) {
+                fprintf(stderr, "Uso: --hilos N (entre 1 y %d)\n", 1024);
+                exit(1);
+            }
+            hilos_replicas = (int)hilos;
+        }
+        else if (strcmp(argv[i], "--personal") == 0 && i + 1 < argc) {
+            ConfiguracionPersonal* p = &personal_configurado;
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &p->num_admin, &p->num_medicos_general,
+                       &p->num_enfermeras, &p->num_especialistas) != 4) {
+                fprintf(stderr, "Uso: --personal ADMINS,GENERALES,ENFERMERAS,ESPECIALISTAS\n");
+                exit(1);
+            }
+            personal_indicado = 1;
+        }
+        else if (strcmp(argv[i], "--optimizar") == 0) {
+            modo_optimizar = 1;
+            modo_eventos_discretos = 1;
+        }
+        else if (strcmp(argv[i], "--traza") == 0 && i + 1 < argc) {
+            ruta_traza = argv[++i];
+        }
+        else if (strcmp(argv[i], "--analizar-traza") == 0 && i + 1 < argc) {
+            traza_a_analizar = argv[++i];
+        }
+        else if (strcmp(argv[i], "--paciente") == 0 && i + 1 < argc) {
+            paciente_buscado = atol(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0) {
+            modo_benchmark = 1;
+            modo_eventos_discretos = 1;  // Sin esperas: las colas no bloquean y las jornadas no duermen
+        }
+        else if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            ruta_csv = argv[++i];
+        }
+        else if (strcmp(argv[i], "--llegadas") == 0 && i + 1 < argc) {
+            ruta_llegadas = argv[++i];
+        }
+        else if (strcmp(argv[i], "--metricas") == 0 && i + 1 < argc) {
+            metricas_a_publicar = argv[++i];
+        }
+        else if (strcmp(argv[i], "--serie") == 0 && i + 1 < argc) {
+            ruta_serie = argv[++i];
+        }
+        else if (strcmp(argv[i], "--muestreo") == 0 && i + 1 < argc) {
+            intervalo_serie = atoi(argv[++i]);
+            if (intervalo_serie < 1) {
+                fprintf(stderr, "Uso: --muestreo SEGUNDOS (de simulación, al menos 1)\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--leer-serie") == 0 && i + 1 < argc) {
+            serie_a_leer = argv[++i];
+        }
+        else if (strcmp(argv[i], "--leer-metricas") == 0 && i + 1 < argc) {
+            metricas_a_leer = argv[++i];
+        }
+        else if (strcmp(argv[i], "--intervalo") == 0 && i + 1 < argc) {
+            intervalo_lectura = atoi(argv[++i]);
+            if (intervalo_lectura < 1) intervalo_lectura = 1;
+        }
+        else if (strcmp(argv[i], "--guardar-estado") == 0 && i + 1 < argc) {
+            ruta_guardar_estado = argv[++i];
+            modo_eventos_discretos = 1;  // Solo el reloj virtual tiene un estado estable entre eventos
+        }
+        else if (strcmp(argv[i], "--instante") == 0 && i + 1 < argc) {
+            i++;
+            instante_guardar_estado = interpretar_hora(argv[i], strlen(argv[i]));
+            if (instante_guardar_estado <= 0) {
+                fprintf(stderr, "Uso: --instante H:MM[:SS] o segundos desde el inicio de la jornada\n");
+                exit(1);
+            }
+        }
+        else if (strcmp(argv[i], "--restaurar-estado") == 0 && i + 1 < argc) {
+            estado_a_restaurar = argv[++i];
+            modo_eventos_discretos = 1;
+        }
+        else if (strcmp(argv[i], "--presupuesto") == 0 && i + 1 < argc) {
+            presupuesto_hora = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--costos") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &costo_admin, &costo_medico_general,
+                       &costo_enfermera, &costo_especialista) != 4) {
+                fprintf(stderr, "Uso: --costos ADMIN,GENERAL,ENFERMERA,ESPECIALISTA (por hora)\n");
+                exit(1);
+            }
+        }
     }
     
-    printf("🏥 Iniciando simulación de colas de atención médica (Velocidad: x%d)\n", SPEED_FACTOR);
+    // Analizar una traza existente no corre ninguna simulación
+    if (traza_a_analizar) {
+        analizar_traza(traza_a_analizar, paciente_buscado);
+        return 0;
+    }
+    
+    if (serie_a_leer) {
+        leer_serie(serie_a_leer);
+        return 0;
+    }
+    
+    // El lector de métricas tampoco: solo mira una simulación que ya corre
+    if (metricas_a_leer) {
+        signal(SIGINT, manejador_senal);
+        leer_metricas(metricas_a_leer, intervalo_lectura);
+        return 0;
+    }
+    
+    // Las instantáneas describen una sola clínica con su dotación
+    if ((modo_optimizar || modo_benchmark) && (estado_a_restaurar || ruta_guardar_estado)) {
+        fprintf(stderr, "⚠️  --guardar-estado y --restaurar-estado se ignoran con --optimizar y --benchmark\n");
+        estado_a_restaurar = NULL;
+        ruta_guardar_estado = NULL;
+    }
+    // La red simula una jornada por sede, sin réplicas ni búsqueda de dotación
+    if (num_sedes > 0 && (num_replicas > 0 || modo_optimizar || modo_benchmark)) {
+        fprintf(stderr, "⚠️  --red se ignora con --replicas, --optimizar y --benchmark\n");
+        num_sedes = 0;
+    }
+    if (num_sedes > 0 && (estado_a_restaurar || ruta_guardar_estado)) {
+        fprintf(stderr, "⚠️  --guardar-estado y --restaurar-estado se ignoran con --red\n");
+        estado_a_restaurar = NULL;
+        ruta_guardar_estado = NULL;
+    }
+    if (num_replicas > 0 && ruta_guardar_estado) {
+        fprintf(stderr, "⚠️  --guardar-estado se ignora con --replicas\n");
+        ruta_guardar_estado = NULL;
+    }
+    if (ruta_guardar_estado && instante_guardar_estado < 0) {
+        fprintf(stderr, "Uso: --guardar-estado ARCHIVO --instante H:MM\n");
+        exit(1);
+    }
+    
+    const ConfiguracionPersonal* p = &personal_configurado;
+    if (p->num_admin < 1 || p->num_admin > MAX_ADMIN || p->num_medicos_general < 0 ||
+        p->num_enfermeras < 0 || p->num_especialistas < 0 ||
+        p->num_medicos_general + p->num_enfermeras + p->num_especialistas > MAX_MEDICOS) {
+        fprintf(stderr, "Dotación inválida: 1-%d admins y hasta %d médicos en total\n",
+                MAX_ADMIN, MAX_MEDICOS);
+        exit(1);
+    }
+    
+    // El planificador M:N reemplaza a los hilos del modo con reloj real
+    if (modo_eventos_discretos && modo_agentes_mn) {
+        fprintf(stderr, "⚠️  --mn se ignora en modo eventos discretos\n");
+        modo_agentes_mn = 0;
+    }
+    
+    // Sin --semilla cada corrida es distinta, pero se informa para poder repetirla
+    if (!semilla_indicada) semilla_global = (uint64_t)time(NULL);
+    
+    // Cada clínica (también cada réplica) recorre el registro con su propio cursor
+    if (ruta_llegadas) abrir_llegadas(ruta_llegadas);
+    
+    // La dotación y, sin --semilla, la semilla salen de la instantánea; con
+    // otra semilla la jornada sigue desde el mismo estado con otros sorteos
+    int continuar_flujo = 0;
+    if (estado_a_restaurar) {
+        ConfiguracionPersonal pedido = personal_configurado;
+        cargar_instantanea(estado_a_restaurar);
+        if (personal_indicado && memcmp(&pedido, &personal_configurado, sizeof(pedido)) != 0) {
+            fprintf(stderr, "⚠️  --personal se ignora: se usa la dotación guardada en el estado\n");
+        }
+        if (!semilla_indicada) semilla_global = semilla_instantanea();
+        continuar_flujo = (semilla_global == semilla_instantanea());
+        if (reloj_instantanea() >= duracion_jornada) {
+            fprintf(stderr, "El estado es de las %ld:%02ld: la jornada (--duracion) ya habría terminado\n",
+                    reloj_instantanea() / 3600, reloj_instantanea() % 3600 / 60);
+            exit(1);
+        }
+    }
+    
+    // Con réplicas los eventos de cada paciente solo serían ruido
+    if ((num_replicas > 0 || num_sedes > 0 || modo_optimizar || modo_benchmark) && !log_indicado) {
+        nivel_log = NIVEL_ERROR;
+    }
+    
+    // Una traza describe una sola jornada
+    if ((num_replicas > 0 || num_sedes > 0 || modo_optimizar) && ruta_traza) {
+        fprintf(stderr, "⚠️  --traza se ignora con --replicas, --red y --optimizar\n");
+        ruta_traza = NULL;
+    }
+    if ((num_replicas > 0 || num_sedes > 0 || modo_optimizar) && metricas_a_publicar) {
+        fprintf(stderr, "⚠️  --metricas se ignora con --replicas, --red y --optimizar\n");
+        metricas_a_publicar = NULL;
+    }
+    if ((num_replicas > 0 || num_sedes > 0 || modo_optimizar || modo_benchmark) && ruta_serie) {
+        fprintf(stderr, "⚠️  --serie se ignora con --replicas, --red, --optimizar y --benchmark\n");
+        ruta_serie = NULL;
+    }
+    
+    if (modo_benchmark) {
+        printf("🏥 Banco de pruebas de rendimiento (colas y jornadas en eventos discretos)\n");
+    } else if (modo_optimizar) {
+        printf("🏥 Buscando la mejor dotación (Eventos discretos, jornada de %d:%02d h)\n",
+               duracion_jornada / 3600, (duracion_jornada % 3600) / 60);
+    } else if (num_sedes > 0) {
+        hilos_replicas = num_sedes;  // Un hilo por sede
+        printf("🏥 Iniciando una red de %d clínicas (Eventos discretos, jornada de %d:%02d h)\n",
+               num_sedes, duracion_jornada / 3600, (duracion_jornada % 3600) / 60);
+    } else if (num_replicas > 0) {
+        printf("🏥 Iniciando %d réplicas de la simulación (Eventos discretos, jornada de %d:%02d h)\n",
+               num_replicas, duracion_jornada / 3600, (duracion_jornada % 3600) / 60);
+    } else if (modo_eventos_discretos) {
+        printf("🏥 Iniciando simulación de colas de atención médica (Eventos discretos, jornada de %d:%02d h)\n",
+               duracion_jornada / 3600, (duracion_jornada % 3600) / 60);
+    } else if (modo_agentes_mn) {
+        printf("🏥 Iniciando simulación de colas de atención médica (Velocidad: x%d, agentes M:N sobre %d hilos)\n",
+               SPEED_FACTOR, hilos_configurados());
+    } else {
+        printf("🏥 Iniciando simulación de colas de atención médica (Velocidad: x%d)\n", SPEED_FACTOR);
+    }
     printf("Configuración: %d admins (activos: %d), %d médicos generales, %d enfermeras, %d especialistas\n", 
-           num_admin, admin_activos, num_medicos_general, num_enfermeras, num_especialistas);
-    printf("Presiona Ctrl+C para terminar la simulación\n\n");
+           p->num_admin, (admin_activos_inicial < p->num_admin) ? admin_activos_inicial : p->num_admin,
+           p->num_medicos_general, p->num_enfermeras, p->num_especialistas);
+    printf("Semilla: %llu\n", (unsigned long long)semilla_global);
+    if (ruta_llegadas) {
+        printf("Llegadas: registro '%s' (la primera llegada marca el inicio de la jornada)\n", ruta_llegadas);
+    }
+    if (estado_a_restaurar) {
+        printf("Estado inicial: '%s' (%ld:%02ld:%02ld de la jornada%s)\n", estado_a_restaurar,
+               reloj_instantanea() / 3600, reloj_instantanea() % 3600 / 60, reloj_instantanea() % 60,
+               continuar_flujo ? "" : ", con otros sorteos");
+    }
+    if (ruta_guardar_estado) {
+        printf("Guardando el estado en '%s' a las %ld:%02ld:%02ld\n", ruta_guardar_estado,
+               instante_guardar_estado / 3600, instante_guardar_estado % 3600 / 60, instante_guardar_estado % 60);
+    }
+    if (!modo_eventos_discretos) {
+        printf("Presiona Ctrl+C para terminar la simulación\n\n");
+    }
     
     // Configurar manejador de señal
     signal(SIGINT, manejador_senal);
     
     // Guardar tiempo de inicio
     tiempo_inicio_simulacion = time(NULL);
-    ultimo_cambio_personal = tiempo_inicio_simulacion;
     
-    // Inicializar colas
-    init_cola(&cola_recepcion);
-    init_cola(&cola_medico_general);
-    init_cola(&cola_enfermeria);
-    for (int i = 0; i < 4; i++) {
-        init_cola(&cola_especialista[i]);
-    }
-    
-    // Inicializar personal administrativo (crear los 4 hilos)
-    for (int i = 0; i < MAX_ADMIN; i++) {
-        personal_admin[i].id = i + 1;
-        personal_admin[i].ocupado = 0;
-        personal_admin[i].pacientes_clasificados = 0;
-        personal_admin[i].activo = 1;
-        pthread_create(&personal_admin[i].thread, NULL, personal_administrativo, &personal_admin[i]);
-    }
-    
-    // Inicializar médicos generales
-    for (int i = 0; i < num_medicos_general; i++) {
-        medicos[i].id = i + 1;
-        medicos[i].tipo = ATENCION_GENERAL;
-        medicos[i].ocupado = 0;
-        medicos[i].pacientes_atendidos = 0;
-        medicos[i].activo = 1;
-        pthread_create(&medicos[i].thread, NULL, medico_atencion, &medicos[i]);
-    }
-    
-    // Inicializar enfermeras
-    for (int i = 0; i < num_enfermeras; i++) {
-        int idx = num_medicos_general + i;
-        medicos[idx].id = i + 1;
-        medicos[idx].tipo = ATENCION_ENFERMERIA;
-        medicos[idx].ocupado = 0;
-        medicos[idx].pacientes_atendidos = 0;
-        medicos[idx].activo = 1;
-        pthread_create(&medicos[idx].thread, NULL, medico_atencion, &medicos[idx]);
-    }
-    
-    // Inicializar especialistas con especialidades repetidas para mayor rapidez
-    srand(time(NULL));
-    for (int i = 0; i < num_especialistas; i++) {
-        int idx = num_medicos_general + num_enfermeras + i;
-        medicos[idx].id = i + 1;
-        medicos[idx].tipo = ATENCION_ESPECIALIDAD;
-        // Permitir especialidades repetidas (enunciado: "mayor rapidez")
-        medicos[idx].especialidad = rand() % 4; // Aleatorio, pueden repetirse
-        medicos[idx].ocupado = 0;
-        medicos[idx].pacientes_atendidos = 0;
-        medicos[idx].activo = 1;
-        pthread_create(&medicos[idx].thread, NULL, medico_atencion, &medicos[idx]);
+    if (modo_benchmark) {
+        iniciar_log();
+        ejecutar_benchmark(ruta_csv);
+        finalizar_log();
+        printf("✅ Benchmark terminado\n");
+        return 0;
+    }
+    
+    if (modo_optimizar) {
+        iniciar_log();
+        ejecutar_optimizador();
+        finalizar_log();
+        printf("✅ Optimización terminada\n");
+        return 0;
+    }
+    
+    if (num_sedes > 0) {
+        iniciar_log();
+        ejecutar_red();
+        finalizar_log();
+        printf("✅ Simulación terminada exitosamente\n");
+        return 0;
+    }
+    
+    if (num_replicas > 0) {
+        iniciar_log();
+        ejecutar_replicas();
+        finalizar_log();
+        printf("✅ Simulación terminada exitosamente\n");
+        return 0;
+    }
+    
+    // Inicializar la clínica (arena de pacientes, colas) y su personal
+    preparar_clinica(&clinica_principal, &personal_configurado);
+    usar_clinica(&clinica_principal);
+    sembrar_aleatorio(FLUJO_PRINCIPAL);
+    if (estado_a_restaurar) {
+        restaurar_instantanea(continuar_flujo);
+    } else {
+        inicializar_personal();
+    }
+    iniciar_log();
+    
+    if (ruta_traza) {
+        size_t tam_cabecera = tam_cabecera_traza(total_medicos_clinica());
+        CabeceraTraza* cabecera = calloc(1, tam_cabecera);
+        if (!cabecera) {
+            fprintf(stderr, "Sin memoria para la cabecera de la traza\n");
+            exit(1);
+        }
+        *cabecera = (CabeceraTraza){ .version = VERSION_TRAZA, .tam_registro = sizeof(RegistroTraza),
+                                     .semilla = semilla_global,
+                                     .factor_velocidad = modo_eventos_discretos ? 0 : SPEED_FACTOR,
+                                     .num_admin = clinica->personal.num_admin,
+                                     .num_medicos = total_medicos_clinica(), .tam_cabecera = tam_cabecera };
+        memcpy(cabecera->magia, MAGIA_TRAZA, sizeof(cabecera->magia));
+        for (int i = 0; i < cabecera->num_medicos; i++) {
+            cabecera->medicos[i].tipo = clinica->medicos[i].tipo;
+            cabecera->medicos[i].especialidad = clinica->medicos[i].especialidad;
+        }
+        abrir_traza(ruta_traza, cabecera);
+        free(cabecera);
+    }
+    if (metricas_a_publicar) {
+        abrir_metricas(metricas_a_publicar);
+        printf("📡 Métricas en memoria compartida '%s'\n", nombre_metricas);
+    }
+    if (ruta_serie) {
+        abrir_serie(ruta_serie);
+        printf("📈 Serie temporal en '%s' (una muestra cada %d s simulados)\n", ruta_serie, intervalo_serie);
+    }
+    
+    if (modo_eventos_discretos) {
+        struct timespec inicio_cpu, fin_cpu;
+        clock_gettime(CLOCK_MONOTONIC, &inicio_cpu);
         
-        const char* especialidades[] = {"Cardiología", "Neurología", "Pediatría", "Dermatología"};
-        printf("Especialista %d: %s\n", medicos[idx].id, especialidades[medicos[idx].especialidad]);
+        if (estado_a_restaurar) continuar_eventos_discretos();
+        else ejecutar_eventos_discretos();
+        finalizar_log();
+        cerrar_traza();
+        cerrar_metricas();
+        cerrar_serie();
+        
+        clock_gettime(CLOCK_MONOTONIC, &fin_cpu);
+        double ms = (fin_cpu.tv_sec - inicio_cpu.tv_sec) * 1000.0 +
+                    (fin_cpu.tv_nsec - inicio_cpu.tv_nsec) / 1e6;
+        
+        printf("\n📊 Duración total - Real: %.2f ms | Simulación: %ld segundos\n", ms, clinica->reloj_virtual);
+        generar_reporte();
+        printf("✅ Simulación terminada exitosamente\n");
+        return 0;
+    }
+    
+    if (modo_agentes_mn) {
+        // Generador, admins y médicos como agentes sobre el pool de hilos
+        iniciar_planificador(hilos_configurados());
+    } else {
+        // Crear los hilos del personal administrativo y médico
+        for (int i = 0; i < clinica->personal.num_admin; i++) {
+            pthread_create(&clinica->personal_admin[i].thread, NULL, personal_administrativo, &clinica->personal_admin[i]);
+        }
+        int total_medicos = total_medicos_clinica();
+        for (int i = 0; i < total_medicos; i++) {
+            pthread_create(&clinica->medicos[i].thread, NULL, medico_atencion, &clinica->medicos[i]);
+        }
+        pthread_t generador_thread;
+        pthread_create(&generador_thread, NULL, generador_pacientes, NULL);
     }
     
     // Crear hilos del sistema
-    pthread_t generador_thread, monitor_thread, contador_thread, gestor_thread;
-    pthread_create(&generador_thread, NULL, generador_pacientes, NULL);
+    pthread_t monitor_thread, contador_thread, gestor_thread, abandonos_thread;
     pthread_create(&monitor_thread, NULL, monitor_sistema, NULL);
     pthread_create(&contador_thread, NULL, contador_tiempo, NULL);
     pthread_create(&gestor_thread, NULL, gestor_personal, NULL);
+    pthread_create(&abandonos_thread, NULL, reloj_abandonos, NULL);
+    iniciar_publicador_metricas();
+    iniciar_muestreador_serie();
     
     // Esperar señal de terminación (Ctrl+C)
     pause();
     
+    // Vaciar los mensajes pendientes; lo que registren los hilos al cerrar sale directo
+    finalizar_log();
+    
     printf("\n🔄 Terminando simulación...\n");
     simulacion_activa = 0;
     
-    // Despertar todos los hilos esperando
-    pthread_cond_broadcast(&cola_recepcion.cond);
-    pthread_cond_broadcast(&cola_medico_general.cond);
-    pthread_cond_broadcast(&cola_enfermeria.cond);
+    // Despertar todos los hilos esperando (consumidores y productores detenidos)
+    ec_notificar_todos(&clinica->hay_trabajo);
+    ec_notificar_todos(&clinica->hay_recepcion);
+    ec_notificar_todos(&clinica->cambio_personal);
+    despertar_cola(&clinica->cola_recepcion);
+    despertar_cola(&clinica->cola_medico_general);
+    despertar_cola(&clinica->cola_enfermeria);
     for (int i = 0; i < 4; i++) {
-        pthread_cond_broadcast(&cola_especialista[i].cond);
+        despertar_cola(&clinica->cola_especialista[i]);
     }
+    if (modo_agentes_mn) detener_planificador();
     
     // Esperar que terminen todos los hilos (con timeout corto)
     printf("Esperando finalización de hilos...\n");
     
     // No esperar indefinidamente por los hilos
     sleep(2);
+    cerrar_traza();
+    cerrar_metricas();
+    cerrar_serie();
     
     // Generar reporte final
     time_t tiempo_final = time(NULL);
@@ -742,4 +7941,4 @@ int main(int argc, char* argv[]) {
     printf("✅ Simulación terminada exitosamente\n");
     
     return 0;
-}
\ No newline at end of file
+}